@@ -0,0 +1,718 @@
+/*===- Benchmark.cpp -=========================================================/
+*
+*                                  DEMON
+*
+* This file is distributed under the BSD Open Source License. See LICENSE.TXT
+* for details.
+*
+*===-----------------------------------------------------------------------===*/
+
+#include "Cloud.h"
+#include "ConfinementForce.h"
+#include "Runge_Kutta4.h"
+#include "ShieldedCoulombForce.h"
+#include "TreeCoulombForce.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace chrono;
+
+// Cloud statics normally set by the driver.
+double Cloud::interParticleSpacing = 1E-4;
+double Cloud::dustParticleMassDensity = 2200;
+double Cloud::justX = 0.0;
+double Cloud::justY = 0.0;
+double Cloud::velX = 0.0;
+double Cloud::velY = 0.0;
+
+/**
+* @brief Displays help to the console.
+**/
+void help() {
+	cout << endl
+	     << "Usage: Benchmark coulomb [numParticles] [repeats] [shielding]" << endl
+	     << "       Benchmark math [numValues] [repeats]" << endl
+	     << "       Benchmark precision [numParticles] [steps]" << endl
+	     << "       Benchmark reorder [numParticles] [repeats]" << endl
+	     << "       Benchmark stages [numParticles] [repeats]" << endl << endl
+	     << " coulomb  time the ShieldedCoulombForce pair searches and force" << endl
+	     << "          accumulation methods on a grid of numParticles (4096) with" << endl
+	     << "          1E-4 m spacing and a shielding constant of shielding (2E4)" << endl
+	     << "          m^-1, taking the best of repeats (5) runs, and the force" << endl
+	     << "          tables (-Y), single precision pair forces (-m) and Barnes-Hut" << endl
+	     << "          trees (-b) with their largest relative force error" << endl
+	     << " math     time the vectorized exp, log, sin, cos and sincos against libm" << endl
+	     << "          on numValues (65536) arguments, taking the best of repeats (5)" << endl
+	     << "          runs, and report their largest error in ULPs over 1E7 random" << endl
+	     << "          arguments" << endl
+	     << " precision integrate numParticles (1024) in a confined grid for steps" << endl
+	     << "          (2000) RK4 steps of 1E-4 s with double and single precision" << endl
+	     << "          pair forces and compare the trajectories and energy drift" << endl
+	     << " reorder  shuffle the particles of a grid of numParticles (16384) in" << endl
+	     << "          memory like a well mixed cloud and time the pair searches" << endl
+	     << "          and the tree before and after sorting them along a Hilbert" << endl
+	     << "          curve (-H), taking the best of repeats (5) runs" << endl
+	     << " stages   time the passes of RK2 and RK4 steps apart from the forces" << endl
+	     << "          on numParticles (262144) before and after they were fused," << endl
+	     << "          taking the best of repeats (5) runs, and report the arrays" << endl
+	     << "          read or written per step and the bandwidth derived from them" << endl << endl;
+}
+
+/**
+* @brief Creates a square grid cloud with every particle slightly displaced so
+*        no two pair distances are identical.
+*
+* @param[in] numParticles The number of particles
+*
+* @return The cloud
+**/
+Cloud * const benchmarkCloud(const cloud_index numParticles) {
+	Cloud * const cloud = Cloud::initializeGrid(numParticles, 0, 0, 1.45E-6, 0.0, 6000.0, 100.0, 1);
+	srand(1);
+	for (cloud_index i = 0; i < numParticles; i++) {
+		cloud->x[i] += 0.3*Cloud::interParticleSpacing*((double)rand()/RAND_MAX - 0.5);
+		cloud->y[i] += 0.3*Cloud::interParticleSpacing*((double)rand()/RAND_MAX - 0.5);
+	}
+	return cloud;
+}
+
+/**
+* @brief Times the first RK substep of a ShieldedCoulombForce.
+*
+* @param[in] cloud   The cloud
+* @param[in] force   The force to time
+* @param[in] repeats Number of runs, of which the fastest is returned
+*
+* @return Time of one force evaluation [s]
+**/
+double timeForce(Cloud * const cloud, Force * const force, const unsigned repeats) {
+	double best = 0.0;
+	for (unsigned r = 0; r < repeats; r++) {
+		for (cloud_index i = 0; i < cloud->n; i++)
+			cloud->forceX[i] = cloud->forceY[i] = 0.0;
+
+		const auto start = steady_clock::now();
+		force->force1(0.0);
+		const double seconds = duration<double>(steady_clock::now() - start).count();
+		if (!r || seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+/**
+* @brief Compares the pair searches, force accumulation methods and force
+*        tables of ShieldedCoulombForce and the TreeCoulombForce against the
+*        locked all pairs search.
+*
+* @param[in] numParticles The number of particles
+* @param[in] repeats      Number of runs per method
+* @param[in] shielding    The shielding constant [m^-1]
+**/
+void coulombBenchmark(const cloud_index numParticles, const unsigned repeats, const double shielding) {
+	const struct {
+		const char *search, *accumulation;
+		PairSearch searchMethod;
+		ForceAccumulation accumulationMethod;
+		unsigned table;
+		ForcePrecision precision;
+	} methods[] = {
+		{"all", "lock", AllPairsSearch, LockAccumulation, 0, DoublePrecision},
+		{"all", "private", AllPairsSearch, PrivateAccumulation, 0, DoublePrecision},
+		{"all", "gather", AllPairsSearch, GatherAccumulation, 0, DoublePrecision},
+		{"cell", "gather", CellListSearch, LockAccumulation, 0, DoublePrecision},
+		{"verlet", "gather", NeighborListSearch, LockAccumulation, 0, DoublePrecision},
+		{"tiled", "lock", TiledSearch, LockAccumulation, 0, DoublePrecision},
+		{"all", "lock", AllPairsSearch, LockAccumulation, 4, DoublePrecision},
+		{"all", "lock", AllPairsSearch, LockAccumulation, 6, DoublePrecision},
+		{"all", "lock", AllPairsSearch, LockAccumulation, 8, DoublePrecision},
+		{"verlet", "gather", NeighborListSearch, LockAccumulation, 6, DoublePrecision},
+		{"all", "lock", AllPairsSearch, LockAccumulation, 0, MixedPrecision},
+	};
+
+	Cloud * const cloud = benchmarkCloud(numParticles);
+	cout << "ShieldedCoulombForce, " << cloud->n << " particles, shielding " << shielding << " m^-1, "
+	     << NUM_THREADS << " threads:" << endl
+	     << "  search  accumulation  table  precision  time [ms]  speedup  max error" << endl;
+
+	double lockTime = 0.0;
+	double * const lockForceX = new double[cloud->n];
+	double * const lockForceY = new double[cloud->n];
+	for (const auto &method : methods) {
+		ShieldedCoulombForce force(cloud, shielding, method.searchMethod, 1E-4, method.accumulationMethod, method.table,
+		                           method.precision);
+		const double seconds = timeForce(cloud, &force, repeats);
+		if (!lockTime) {
+			lockTime = seconds;
+			copy(cloud->forceX, cloud->forceX + cloud->n, lockForceX);
+			copy(cloud->forceY, cloud->forceY + cloud->n, lockForceY);
+		}
+
+		// Largest force difference relative to the force on the particle.
+		double maxError = 0.0;
+		for (cloud_index i = 0; i < cloud->n; i++)
+			maxError = max(maxError, hypot(cloud->forceX[i] - lockForceX[i], cloud->forceY[i] - lockForceY[i])
+			                         /hypot(lockForceX[i], lockForceY[i]));
+
+		cout << "  " << left << setw(8) << method.search << setw(14) << method.accumulation
+		     << right << setw(5) << method.table << setw(11) << (method.precision == MixedPrecision ? "mixed" : "double") << fixed << setprecision(3) << setw(11) << 1E3*seconds
+		     << setprecision(2) << setw(9) << lockTime/seconds
+		     << scientific << setprecision(1) << setw(11) << maxError << endl;
+	}
+
+	for (const double theta : {0.3, 0.5, 0.7}) {
+		TreeCoulombForce force(cloud, shielding, theta);
+		const double seconds = timeForce(cloud, &force, repeats);
+
+		double maxError = 0.0;
+		for (cloud_index i = 0; i < cloud->n; i++)
+			maxError = max(maxError, hypot(cloud->forceX[i] - lockForceX[i], cloud->forceY[i] - lockForceY[i])
+			                         /hypot(lockForceX[i], lockForceY[i]));
+
+		cout << "  tree    theta " << fixed << setprecision(1) << theta << right << setw(30) << setprecision(3) << 1E3*seconds
+		     << setprecision(2) << setw(9) << lockTime/seconds
+		     << scientific << setprecision(1) << setw(11) << maxError << endl;
+	}
+	delete[] lockForceX;
+	delete[] lockForceY;
+	delete cloud;
+}
+
+/**
+* @brief Times the coulomb forces on a cloud whose particles are shuffled in
+*        memory, then sorts the particles along a Hilbert curve and times them
+*        again.
+*
+* @param[in] numParticles The number of particles
+* @param[in] repeats      Number of runs per force
+**/
+void reorderBenchmark(const cloud_index numParticles, const unsigned repeats) {
+	Cloud * const cloud = benchmarkCloud(numParticles);
+	vector<cloud_index> shuffled(cloud->n);
+	for (cloud_index i = 0; i < cloud->n; i++)
+		shuffled[i] = i;
+	shuffle(shuffled.begin(), shuffled.end(), mt19937(1));
+	for (double * const a : {cloud->x, cloud->y, cloud->charge, cloud->mass}) {
+		const vector<double> original(a, a + cloud->n);
+		for (cloud_index i = 0; i < cloud->n; i++)
+			a[i] = original[shuffled[i]];
+	}
+
+	const double shielding = 2E4;
+	const struct {
+		const char *name;
+		PairSearch searchMethod;
+	} searches[] = {
+		{"cell", CellListSearch},
+		{"verlet", NeighborListSearch},
+		{"tiled", TiledSearch},
+	};
+	const unsigned numForces = sizeof(searches)/sizeof(searches[0]) + 1;
+	double seconds[2][numForces];
+	vector<double> shuffledForceX(cloud->n), shuffledForceY(cloud->n);
+	double maxError = 0.0;
+	for (unsigned sorted = 0; sorted < 2; sorted++) {
+		if (sorted)
+			cloud->reorder();
+		for (unsigned f = 0; f < numForces; f++) {
+			Force * const force = f < numForces - 1
+				? (Force *)new ShieldedCoulombForce(cloud, shielding, searches[f].searchMethod, 1E-4, LockAccumulation, 0, DoublePrecision)
+				: (Force *)new TreeCoulombForce(cloud, shielding, 0.5);
+			seconds[sorted][f] = timeForce(cloud, force, repeats);
+			delete force;
+
+			// The cell list force must not depend on the particle order.
+			if (f)
+				continue;
+			for (cloud_index i = 0; i < cloud->n; i++)
+				if (!sorted) {
+					shuffledForceX[i] = cloud->forceX[i];
+					shuffledForceY[i] = cloud->forceY[i];
+				} else {
+					const cloud_index j = cloud->id[i];
+					maxError = max(maxError, hypot(cloud->forceX[i] - shuffledForceX[j], cloud->forceY[i] - shuffledForceY[j])
+					                         /hypot(shuffledForceX[j], shuffledForceY[j]));
+				}
+		}
+	}
+
+	cout << "Hilbert curve reordering, " << cloud->n << " particles, shielding " << shielding << " m^-1, "
+	     << NUM_THREADS << " threads:" << endl
+	     << "  force    shuffled [ms]  sorted [ms]  speedup" << endl;
+	for (unsigned f = 0; f < numForces; f++)
+		cout << "  " << left << setw(7) << (f < numForces - 1 ? searches[f].name : "tree") << right << fixed
+		     << setprecision(3) << setw(15) << 1E3*seconds[0][f] << setw(13) << 1E3*seconds[1][f]
+		     << setprecision(2) << setw(9) << seconds[0][f]/seconds[1][f] << endl;
+	cout << "  largest relative cell list force change: " << scientific << setprecision(1) << maxError << endl;
+	delete cloud;
+}
+
+/**
+* @brief Computes the total energy of a cloud held by a ConfinementForce and a
+*        ShieldedCoulombForce, including pairs within the 10*(ion debye length)
+*        cutoff.
+*
+* @param[in] cloud          The cloud
+* @param[in] confinement    The confinement constant [V/m^2]
+* @param[in] shielding      The shielding constant [m^-1]
+*
+* @return Kinetic plus potential energy [J]
+**/
+double cloudEnergy(const Cloud * const cloud, const double confinement, const double shielding) {
+	const double coulomb = 1.0/(4.0*M_PI*Cloud::epsilon0);
+	double energy = 0.0;
+	for (cloud_index i = 0; i < cloud->n; i++) {
+		// Confinement force c*q*r has the potential -c*q*r^2/2.
+		energy += 0.5*cloud->mass[i]*(cloud->Vx[i]*cloud->Vx[i] + cloud->Vy[i]*cloud->Vy[i])
+		          - 0.5*confinement*cloud->charge[i]*(cloud->x[i]*cloud->x[i] + cloud->y[i]*cloud->y[i]);
+		for (cloud_index j = i + 1; j < cloud->n; j++) {
+			const double r = hypot(cloud->x[i] - cloud->x[j], cloud->y[i] - cloud->y[j]);
+			if (shielding*r < 10.0)
+				energy += coulomb*cloud->charge[i]*cloud->charge[j]*exp(-shielding*r)/r;
+		}
+	}
+	return energy;
+}
+
+/**
+* @brief Integrates the same cloud with double and single precision pair forces
+*        and compares the trajectories and the energy drift.
+*
+* @details Only the confinement and pair forces act, so the energy should be 
+*          conserved up to the integration error, which is the same for both
+*          clouds. Any extra drift of the mixed precision cloud comes from the
+*          rounding of its pair forces.
+*
+* @param[in] numParticles The number of particles
+* @param[in] steps        Number of timesteps
+**/
+void precisionBenchmark(const cloud_index numParticles, const unsigned steps) {
+	const double timeStep = 1E-4, confinement = 100.0, shielding = 2E4;
+	const unsigned numReports = 10;
+
+	Cloud * const clouds[2] = {benchmarkCloud(numParticles), benchmarkCloud(numParticles)};
+	// Charges and masses are random, so the second cloud is a copy of the first.
+	copy(clouds[0]->charge, clouds[0]->charge + numParticles, clouds[1]->charge);
+	copy(clouds[0]->mass, clouds[0]->mass + numParticles, clouds[1]->mass);
+	copy(clouds[0]->x, clouds[0]->x + numParticles, clouds[1]->x);
+	copy(clouds[0]->y, clouds[0]->y + numParticles, clouds[1]->y);
+
+	ForceArray forces[2];
+	Integrator *integrators[2];
+	double startEnergy[2], seconds[2] = {0.0, 0.0};
+	for (int c = 0; c < 2; c++) {
+		forces[c].push_back(new ConfinementForce(clouds[c], confinement));
+		forces[c].push_back(new ShieldedCoulombForce(clouds[c], shielding, AllPairsSearch, 0.0, LockAccumulation, 0,
+		                                             c ? MixedPrecision : DoublePrecision));
+		integrators[c] = new Runge_Kutta4(clouds[c], forces[c], timeStep, 0.0);
+		startEnergy[c] = cloudEnergy(clouds[c], confinement, shielding);
+	}
+
+	cout << "Double vs single precision pair forces, " << numParticles << " particles, "
+	     << NUM_THREADS << " threads:" << endl
+	     << "   step  time [s]  max position difference [m]  energy drift: double      mixed" << endl;
+	for (unsigned report = 1; report <= numReports; report++) {
+		const double endTime = timeStep*(double)(steps*report/numReports);
+		for (int c = 0; c < 2; c++) {
+			const auto start = steady_clock::now();
+			integrators[c]->moveParticles(endTime);
+			seconds[c] += duration<double>(steady_clock::now() - start).count();
+		}
+
+		double maxDifference = 0.0;
+		for (cloud_index i = 0; i < numParticles; i++)
+			maxDifference = max(maxDifference, hypot(clouds[1]->x[i] - clouds[0]->x[i], clouds[1]->y[i] - clouds[0]->y[i]));
+
+		cout << right << setw(7) << steps*report/numReports << fixed << setprecision(4) << setw(10)
+		     << integrators[0]->currentTime << scientific << setprecision(2) << setw(29) << maxDifference;
+		for (int c = 0; c < 2; c++)
+			cout << setw(c ? 11 : 22) << (cloudEnergy(clouds[c], confinement, shielding) - startEnergy[c])/fabs(startEnergy[c]);
+		cout << endl;
+	}
+	cout << fixed << setprecision(3) << "Time per step: double " << 1E3*seconds[0]/steps << " ms, mixed "
+	     << 1E3*seconds[1]/steps << " ms, speedup " << setprecision(2) << seconds[0]/seconds[1] << endl;
+
+	for (int c = 0; c < 2; c++) {
+		delete integrators[c];
+		for (Force * const force : forces[c])
+			delete force;
+		delete clouds[c];
+	}
+}
+
+/**
+* @brief Times a loop over arrays of arguments.
+*
+* @param[in] loop    Computes the function of every argument
+* @param[in] repeats Number of runs, of which the fastest is returned
+*
+* @return Time of one run [s]
+**/
+template <typename Loop>
+double timeLoop(const Loop &loop, const unsigned repeats) {
+	double best = 0.0;
+	for (unsigned r = 0; r < repeats; r++) {
+		const auto start = steady_clock::now();
+		loop();
+		const double seconds = duration<double>(steady_clock::now() - start).count();
+		if (!r || seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+/**
+* @brief Returns the error of a result in units in the last place of the exact
+*        value.
+*
+* @param[in] result The computed value
+* @param[in] exact  The exact value, rounded to long double
+**/
+double ulpError(const double result, const long double exact) {
+	if ((long double)result == exact)
+		return 0.0;
+	const double rounded = (double)exact;
+	if (std::isinf(rounded)) // exact value overflows
+		return std::isinf(result) && result*rounded > 0.0 ? 0.0 : INFINITY;
+	const double ulp = rounded ? ldexp(1.0, max(ilogb(rounded), -1022) - 52) : ldexp(1.0, -1074);
+	return (double)(fabsl((long double)result - exact)/ulp);
+}
+
+/**
+* @brief Finds the largest error of a vectorized function over 1E7 random
+*        arguments uniform in [low, high).
+*
+* @param[in] vectorFunc The vectorized function
+* @param[in] exactFunc  The long double libm function
+* @param[in] low        Smallest argument
+* @param[in] high       Largest argument
+*
+* @return Largest error [ULP]
+**/
+double maxUlpError(const doubleV (*vectorFunc)(const doubleV), long double (*exactFunc)(long double),
+                   const double low, const double high) {
+	mt19937_64 engine(1);
+	uniform_real_distribution<double> argument(low, high);
+	alignas(doubleV) double a[DOUBLE_STRIDE], b[DOUBLE_STRIDE];
+	double maxError = 0.0;
+	for (unsigned i = 0; i < 10000000; i += DOUBLE_STRIDE) {
+		for (int j = 0; j < DOUBLE_STRIDE; j++)
+			a[j] = argument(engine);
+		store_pd(b, vectorFunc(load_pd(a)));
+		for (int j = 0; j < DOUBLE_STRIDE; j++)
+			maxError = max(maxError, ulpError(b[j], exactFunc(a[j])));
+	}
+	return maxError;
+}
+
+/**
+* @brief Compares the vectorized math functions of VectorCompatibility.h
+*        against libm.
+*
+* @param[in] numValues The number of arguments per run
+* @param[in] repeats   Number of runs per function
+**/
+void mathBenchmark(const cloud_index numValues, const unsigned repeats) {
+	double * const args = alignedNew<double>(numValues);
+	double * const results1 = alignedNew<double>(numValues);
+	double * const results2 = alignedNew<double>(numValues);
+	mt19937_64 engine(1);
+	uniform_real_distribution<double> argument(-20.0, 0.0);
+	for (cloud_index i = 0; i < numValues; i++)
+		args[i] = argument(engine);
+
+	cout << "Math functions, " << numValues << " values, vector width " << DOUBLE_STRIDE << ":" << endl
+	     << "  function  libm [ns]  vector [ns]  speedup  max error [ULP]" << endl;
+
+	const struct {
+		const char *name;
+		double libmTime, vectorTime, error;
+	} results[] = {
+		{"exp",
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i++) results1[i] = exp(args[i]); }, repeats),
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i += DOUBLE_STRIDE)
+		                    store_pd(results1 + i, exp_pd(load_pd(args + i))); }, repeats),
+		 max(maxUlpError(exp_pd, expl, -745.0, 709.0), maxUlpError(exp_pd, expl, -20.0, 20.0))},
+		{"log",
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i++) results1[i] = log(-args[i]); }, repeats),
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i += DOUBLE_STRIDE)
+		                    store_pd(results1 + i, log_pd(sub_pd(set0_pd(), load_pd(args + i)))); }, repeats),
+		 max(maxUlpError(log_pd, logl, 1E-6, 2.0), maxUlpError(log_pd, logl, 1.0, 1E300))},
+		{"sin",
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i++) results1[i] = sin(args[i]); }, repeats),
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i += DOUBLE_STRIDE)
+		                    store_pd(results1 + i, sin_pd(load_pd(args + i))); }, repeats),
+		 max(maxUlpError(sin_pd, sinl, -1E6, 1E6), maxUlpError(sin_pd, sinl, -10.0, 10.0))},
+		{"cos",
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i++) results1[i] = cos(args[i]); }, repeats),
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i += DOUBLE_STRIDE)
+		                    store_pd(results1 + i, cos_pd(load_pd(args + i))); }, repeats),
+		 max(maxUlpError(cos_pd, cosl, -1E6, 1E6), maxUlpError(cos_pd, cosl, -10.0, 10.0))},
+		{"sincos",
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i++) {
+		                    results1[i] = sin(args[i]);
+		                    results2[i] = cos(args[i]);
+		                } }, repeats),
+		 timeLoop([=] { for (cloud_index i = 0; i < numValues; i += DOUBLE_STRIDE) {
+		                    doubleV sinA, cosA;
+		                    sincos_pd(load_pd(args + i), sinA, cosA);
+		                    store_pd(results1 + i, sinA);
+		                    store_pd(results2 + i, cosA);
+		                } }, repeats),
+		 -1.0}, // same errors as sin and cos
+	};
+
+	for (const auto &result : results) {
+		cout << "  " << left << setw(8) << result.name << right << fixed << setprecision(2)
+		     << setw(11) << 1E9*result.libmTime/numValues << setw(13) << 1E9*result.vectorTime/numValues
+		     << setw(9) << result.libmTime/result.vectorTime;
+		if (result.error >= 0.0)
+			cout << setprecision(3) << setw(17) << result.error;
+		cout << endl;
+	}
+
+	alignedDelete(args);
+	alignedDelete(results1);
+	alignedDelete(results2);
+}
+
+/**
+* @brief Exposes the fused Runge-Kutta stage passes so they can be timed
+*        without forces.
+**/
+class FusedStages : public Runge_Kutta4 {
+public:
+	FusedStages(Cloud * const C) : Runge_Kutta4(C, ForceArray(), 1E-4, 0.0) {}
+
+	using Runge_Kutta2::halfStep;
+	using Runge_Kutta2::fullStep;
+	using Runge_Kutta4::stage1;
+	using Runge_Kutta4::stage2;
+	using Runge_Kutta4::stage3;
+	using Runge_Kutta4::stage4;
+};
+
+/**
+* @brief Stores the increments of one Runge-Kutta substep and resets the forces,
+*        as the integrators did before their passes were fused.
+*
+* @param[in]  cloud The cloud
+* @param[in]  dt    Timestep
+* @param[in]  Vx    x-velocities of the substep
+* @param[in]  Vy    y-velocities of the substep
+* @param[out] k     x-velocity increments
+* @param[out] l     x-position increments
+* @param[out] m     y-velocity increments
+* @param[out] n     y-position increments
+**/
+void unfusedIncrements(Cloud * const cloud, const double dt, const double * const Vx, const double * const Vy,
+                       double * const k, double * const l, double * const m, double * const n) {
+	const doubleV vdt = set1_pd(dt);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		store_pd(k + i, div_pd(mul_pd(vdt, load_pd(pFx)), vmass));
+		store_pd(l + i, mul_pd(vdt, load_pd(Vx + i)));
+		store_pd(m + i, div_pd(mul_pd(vdt, load_pd(pFy)), vmass));
+		store_pd(n + i, mul_pd(vdt, load_pd(Vy + i)));
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Caches the state plus a fraction of the increments of a substep, as
+*        the separate cache pass did before the passes were fused.
+*
+* @param[in] cloud    The cloud
+* @param[in] fraction Fraction of the increments
+* @param[in] k        x-velocity increments
+* @param[in] l        x-position increments
+* @param[in] m        y-velocity increments
+* @param[in] n        y-position increments
+**/
+void unfusedCache(Cloud * const cloud, const double fraction, const double * const k, const double * const l,
+                  const double * const m, const double * const n) {
+	const doubleV vfraction = set1_pd(fraction);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const cloud_index v = i/DOUBLE_STRIDE;
+		cloud->xCache[v] = fmadd_pd(vfraction, load_pd(l + i), load_pd(cloud->x + i));
+		cloud->yCache[v] = fmadd_pd(vfraction, load_pd(n + i), load_pd(cloud->y + i));
+		cloud->VxCache[v] = fmadd_pd(vfraction, load_pd(k + i), load_pd(cloud->Vx + i));
+		cloud->VyCache[v] = fmadd_pd(vfraction, load_pd(m + i), load_pd(cloud->Vy + i));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Takes one RK2 step without forces in the four passes used before they
+*        were fused.
+*
+* @param[in] cloud The cloud
+* @param[in] dt    Timestep
+* @param[in] k     x-velocity increments of the stages, followed by those of
+*                  the x-positions (l), y-velocities (m) and y-positions (n)
+**/
+void unfusedRK2(Cloud * const cloud, const double dt, double * const * const k) {
+	double * const * const l = k + 4, * const * const m = k + 8, * const * const n = k + 12;
+	unfusedIncrements(cloud, dt, cloud->Vx, cloud->Vy, k[0], l[0], m[0], n[0]);
+	unfusedCache(cloud, 0.5, k[0], l[0], m[0], n[0]);
+	unfusedIncrements(cloud, dt, (double *)cloud->VxCache, (double *)cloud->VyCache, k[1], l[1], m[1], n[1]);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		plusEqual_pd(cloud->Vx + i, load_pd(k[1] + i));
+		plusEqual_pd(cloud->x + i, load_pd(l[1] + i));
+		plusEqual_pd(cloud->Vy + i, load_pd(m[1] + i));
+		plusEqual_pd(cloud->y + i, load_pd(n[1] + i));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Returns (a1 + 2*(a2 + a3) + a4)/6 of stored increments.
+*
+* @param[in] a Increments of the four stages
+* @param[in] i Index of the particle
+**/
+inline const doubleV rk4Sum(const double * const * const a, const cloud_index i) {
+	return mul_pd(set1_pd(1.0/6.0), fmadd_pd(set1_pd(2.0), add_pd(load_pd(a[1] + i), load_pd(a[2] + i)),
+	                                         add_pd(load_pd(a[0] + i), load_pd(a[3] + i))));
+}
+
+/**
+* @brief Takes one RK4 step without forces in the eight passes used before they
+*        were fused.
+*
+* @param[in] cloud The cloud
+* @param[in] dt    Timestep
+* @param[in] k     x-velocity increments of the stages, followed by those of
+*                  the x-positions (l), y-velocities (m) and y-positions (n)
+**/
+void unfusedRK4(Cloud * const cloud, const double dt, double * const * const k) {
+	double * const * const l = k + 4, * const * const m = k + 8, * const * const n = k + 12;
+	double * const VxCache = (double *)cloud->VxCache, * const VyCache = (double *)cloud->VyCache;
+	unfusedIncrements(cloud, dt, cloud->Vx, cloud->Vy, k[0], l[0], m[0], n[0]);
+	unfusedCache(cloud, 0.5, k[0], l[0], m[0], n[0]);
+	unfusedIncrements(cloud, dt, VxCache, VyCache, k[1], l[1], m[1], n[1]);
+	unfusedCache(cloud, 0.5, k[1], l[1], m[1], n[1]);
+	unfusedIncrements(cloud, dt, VxCache, VyCache, k[2], l[2], m[2], n[2]);
+	unfusedCache(cloud, 1.0, k[2], l[2], m[2], n[2]);
+	unfusedIncrements(cloud, dt, VxCache, VyCache, k[3], l[3], m[3], n[3]);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		plusEqual_pd(cloud->Vx + i, rk4Sum(k, i));
+		plusEqual_pd(cloud->x + i, rk4Sum(l, i));
+		plusEqual_pd(cloud->Vy + i, rk4Sum(m, i));
+		plusEqual_pd(cloud->y + i, rk4Sum(n, i));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Times the passes over the particles of RK2 and RK4 steps, apart from
+*        the forces, before and after they were fused.
+*
+* @details The bandwidths are estimated from the double arrays each pass reads
+*          or writes, counted from its loop once per read and once per write.
+*          Fused, fewer arrays move, as the position increments follow from the
+*          velocities and the increment passes write the cache.
+*
+* @param[in] numParticles The number of particles
+* @param[in] repeats      Number of runs per method, of 10 steps each
+**/
+void stagesBenchmark(const cloud_index numParticles, const unsigned repeats) {
+	Cloud * const cloud = benchmarkCloud(numParticles);
+	for (cloud_index i = 0; i < cloud->n; i++)
+		cloud->forceX[i] = cloud->forceY[i] = 0.0;
+	FusedStages * const fused = new FusedStages(cloud);
+	const double dt = 1E-9;
+	const unsigned steps = 10;
+
+	// Double arrays each pass reads or writes, counted from its loop once per
+	// read and once per write.
+	const unsigned incrementArrays = 11; // unfusedIncrements: 5 in, 4 increments and 2 forces out
+	const unsigned cacheArrays = 12;     // unfusedCache: 8 in, 4 caches out
+	const unsigned rk2UpdateArrays = 12; // 8 in, 4 out
+	const unsigned rk4UpdateArrays = 24; // 20 in, 4 out
+	const unsigned halfStepArrays = 13, fullStepArrays = 15;
+	const unsigned stage1Arrays = 15, stage2Arrays = 17, stage3Arrays = 17, stage4Arrays = 19;
+
+	// The clouds no longer hold the increments of the unfused passes.
+	double * const buffer = alignedNew<double>(16*numParticles);
+	vector<double *> incrementPointers(16);
+	for (cloud_index a = 0; a < 16; a++)
+		incrementPointers[a] = buffer + a*numParticles;
+	double * const * const increments = incrementPointers.data();
+
+	const struct {
+		const char *name;
+		unsigned arrays[2];
+		double seconds[2];
+	} results[] = {
+		{"RK2", {2*incrementArrays + cacheArrays + rk2UpdateArrays, halfStepArrays + fullStepArrays},
+		 {timeLoop([=] { for (unsigned s = 0; s < steps; s++)
+		                     unfusedRK2(cloud, dt, increments); }, repeats)/steps,
+		  timeLoop([=] { for (unsigned s = 0; s < steps; s++) {
+		                     fused->halfStep(dt);
+		                     fused->fullStep(dt);
+		                 } }, repeats)/steps}},
+		{"RK4", {4*incrementArrays + 3*cacheArrays + rk4UpdateArrays,
+		         stage1Arrays + stage2Arrays + stage3Arrays + stage4Arrays},
+		 {timeLoop([=] { for (unsigned s = 0; s < steps; s++)
+		                     unfusedRK4(cloud, dt, increments); }, repeats)/steps,
+		  timeLoop([=] { for (unsigned s = 0; s < steps; s++) {
+		                     fused->stage1(dt);
+		                     fused->stage2(dt);
+		                     fused->stage3(dt);
+		                     fused->stage4(dt);
+		                 } }, repeats)/steps}},
+	};
+
+	const double bytes = (double)numParticles*sizeof(double);
+	cout << "Runge-Kutta passes without forces, " << numParticles << " particles, "
+	     << NUM_THREADS << " threads:" << endl
+	     << "  method    unfused [ms] arrays  [GB/s]    fused [ms] arrays  [GB/s]  speedup" << endl;
+	for (const auto &result : results) {
+		cout << "  " << left << setw(8) << result.name << right << fixed;
+		for (int f = 0; f < 2; f++)
+			cout << setprecision(3) << setw(14) << 1E3*result.seconds[f]
+			     << setw(7) << result.arrays[f]
+			     << setprecision(1) << setw(8) << 1E-9*bytes*result.arrays[f]/result.seconds[f];
+		cout << setprecision(2) << setw(9) << result.seconds[0]/result.seconds[1] << endl;
+	}
+	cout << "  arrays: double arrays read or written per step, counted from the loops;" << endl
+	     << "  GB/s is derived from them, not measured." << endl;
+	alignedDelete(buffer);
+	delete fused;
+	delete cloud;
+}
+
+int main(int argc, char *argv[]) {
+	const bool coulomb = argc > 1 && !strcmp(argv[1], "coulomb");
+	const bool precision = argc > 1 && !strcmp(argv[1], "precision");
+	const bool reorder = argc > 1 && !strcmp(argv[1], "reorder");
+	const bool stages = argc > 1 && !strcmp(argv[1], "stages");
+	if (!coulomb && !precision && !reorder && !stages && (argc < 2 || strcmp(argv[1], "math"))) {
+		help();
+		return 1;
+	}
+
+	cloud_index numValues = argc > 2 ? (cloud_index)atoi(argv[2]) : (coulomb ? 4096 : (precision ? 1024 : (reorder ? 16384 : (stages ? 262144 : 65536))));
+	while (numValues%FLOAT_STRIDE) // required for SIMD
+		++numValues;
+	const unsigned repeats = argc > 3 ? (unsigned)atoi(argv[3]) : (precision ? 2000 : 5);
+	if (coulomb)
+		coulombBenchmark(numValues, repeats, argc > 4 ? atof(argv[4]) : 2E4);
+	else if (precision)
+		precisionBenchmark(numValues, repeats);
+	else if (reorder)
+		reorderBenchmark(numValues, repeats);
+	else if (stages)
+		stagesBenchmark(numValues, repeats);
+	else
+		mathBenchmark(numValues, repeats);
+	return 0;
+}
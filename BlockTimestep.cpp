@@ -0,0 +1,267 @@
+/**
+* @file  BlockTimestep.cpp
+* @class BlockTimestep BlockTimestep.h
+*
+* @brief Implementation of velocity Verlet with hierarchical block timesteps,
+*        which gives each particle its own power of two fraction of the
+*        timestep and only moves and evaluates the particles whose step ends
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "BlockTimestep.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const double BlockTimestep::closeDistance = 1.0e-4;
+
+/**
+* @brief Constructor for the BlockTimestep class
+*
+* @details Forces are sorted by whether they can compute a subset of the
+*          particles, by asking them for an empty one.
+*
+* @param[in] C                 Cloud object
+* @param[in] FA                Array of forces
+* @param[in] timeStep          Longest timestep, used by level 0
+* @param[in] startTime         Simulation start time
+* @param[in] accuracyParameter Fraction of the closest separation a particle may move in one step
+* @param[in] numLevels         Deepest level, with a timestep of timeStep/2^numLevels
+**/
+BlockTimestep::BlockTimestep(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime,
+                             const double accuracyParameter, const cloud_index numLevels)
+: Integrator(C, FA, timeStep, startTime), accuracy(accuracyParameter), maxLevel(numLevels),
+levels(C->n, 0), levelsCurrent(false), oddSubstep(true), numReorders(0), numSubsteps(0), numActive(0),
+deepestLevel(0) {
+	C->allocateSlopes(2);
+	active.reserve(C->n);
+	for (Force * const F : FA)
+		(F->activeForce(startTime, NULL, 0) ? activeForces : fullForces).push_back(F);
+}
+
+/**
+* @brief Moves particles forward with block timesteps.
+*
+* @details Level l steps timeStep/2^l, so every step of a level ends where a
+*          step of each finer level ends, and all particles are in sync at the
+*          end of each timestep. The substeps end where the steps of the
+*          deepest occupied level end. All particles drift to the end of the
+*          substep, which keeps the positions the active particles see current.
+*          Only the particles whose step ends are kicked with new forces and
+*          get a new level, from their closest separation, speed and
+*          acceleration. A particle may always move to a finer level, but only
+*          to a coarser one where a step of that level ends. This replaces the
+*          global timestep reduction of modifyTimeStep.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void BlockTimestep::moveParticles(const double endTime) {
+	const unsigned long ticksPerStep = 1ul << maxLevel;
+	const double tickLength = init_dt/(double)ticksPerStep;
+	while (currentTime < endTime) {
+		active.resize(cloud->n);
+		for (cloud_index i = 0; i < cloud->n; i++)
+			active[i] = i;
+
+		// Reordering the cloud moves the particles out from under their levels
+		// and accelerations.
+		if (!levelsCurrent || numReorders != cloud->numReorders) {
+			evaluate(currentTime);
+			assignLevels(0, ticksPerStep);
+			numReorders = cloud->numReorders;
+			levelsCurrent = true;
+		}
+		kick(false);
+
+		for (unsigned long tick = 0; tick < ticksPerStep;) {
+			const cloud_index deepest = deepestOccupiedLevel();
+			deepestLevel = std::max(deepestLevel, deepest);
+			const unsigned long span = ticksPerStep >> deepest;
+			const unsigned long next = (tick/span + 1)*span;
+			drift((double)(next - tick)*tickLength);
+			tick = next;
+
+			active.clear();
+			for (cloud_index i = 0; i < cloud->n; i++)
+				if (!(tick & ((ticksPerStep >> levels[i]) - 1)))
+					active.push_back(i);
+			++numSubsteps;
+			numActive += active.size();
+
+			predict();
+			evaluate(currentTime + (double)tick*tickLength);
+			kick(true);
+			assignLevels(tick, ticksPerStep);
+			if (tick < ticksPerStep)
+				kick(false);
+		}
+		currentTime += init_dt;
+	}
+}
+
+/**
+* @brief Computes the accelerations of the active particles, keeping them in k1
+*        and m1.
+*
+* @details If every particle is active, all forces take their usual path.
+*          Otherwise the forces that can compute a subset only compute the
+*          active particles, and the others compute every particle.
+*
+* @param[in] time Time of the positions
+**/
+void BlockTimestep::evaluate(const double time) {
+	const cloud_index numActiveParticles = (cloud_index)active.size();
+	if (numActiveParticles == cloud->n)
+		evaluateForces(forces, time, oddSubstep);
+	else {
+		for (Force * const F : activeForces)
+			F->activeForce(time, active.data(), numActiveParticles);
+		evaluateForces(fullForces, time, oddSubstep);
+	}
+
+	const cloud_index * const particles = active.data();
+	BEGIN_PARALLEL_FOR(a, e, numActiveParticles, 1, static)
+		const cloud_index i = particles[a];
+		cloud->k1[i] = cloud->forceX[i]/cloud->mass[i];
+		cloud->m1[i] = cloud->forceY[i]/cloud->mass[i];
+	END_PARALLEL_FOR
+
+	// reset forces to zero:
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		store_pd(cloud->forceX + i, set0_pd());
+		store_pd(cloud->forceY + i, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Gives each active particle the level whose timestep lets it move at
+*        most the accuracy parameter times its closest separation.
+*
+* @details Separations are capped at closeDistance, below which the timestep
+*          also shrinks in proportion to the separation, like modifyTimeStep
+*          reduces the global timestep. The closest separations are found
+*          with a cell list of that width.
+*
+* @param[in] tick         Time of the substep in units of the deepest level
+* @param[in] ticksPerStep Number of such units per timestep
+**/
+void BlockTimestep::assignLevels(const unsigned long tick, const unsigned long ticksPerStep) {
+	cells.build(cloud->x, cloud->y, closeDistance);
+
+	const cloud_index numActiveParticles = (cloud_index)active.size();
+	const cloud_index * const particles = active.data();
+	const CellList * const grid = &cells;
+	cloud_index * const level = levels.data();
+	const double dt = init_dt, alpha = accuracy;
+	const cloud_index deepest = maxLevel;
+	BEGIN_PARALLEL_FOR(a, e, numActiveParticles, 1, static)
+		const cloud_index i = particles[a];
+		const double x1 = cloud->x[i], y1 = cloud->y[i];
+		const cloud_index cell = grid->cell(x1, y1);
+		const cloud_index cx = cell%grid->numCellsX, cy = cell/grid->numCellsX;
+		double nearest2 = std::numeric_limits<double>::max();
+		for (cloud_index row = cy ? cy - 1 : 0; row <= cy + 1 && row < grid->numCellsY; row++)
+			for (cloud_index q = grid->rowBegin(cx, row), last = grid->rowEnd(cx, row); q < last; q++)
+				if (grid->particles[q] != i) {
+					const double dx = x1 - grid->sortedX[q];
+					const double dy = y1 - grid->sortedY[q];
+					nearest2 = std::min(nearest2, dx*dx + dy*dy);
+				}
+		const double separation = std::min(closeDistance, std::sqrt(nearest2));
+		const double speed = std::sqrt(cloud->Vx[i]*cloud->Vx[i] + cloud->Vy[i]*cloud->Vy[i]);
+		const double acceleration = std::sqrt(cloud->k1[i]*cloud->k1[i] + cloud->m1[i]*cloud->m1[i]);
+
+		double h = dt*(separation/closeDistance);
+		if (alpha*separation < speed*h)
+			h = alpha*separation/speed;
+		if (2.0*alpha*separation < acceleration*h*h)
+			h = std::sqrt(2.0*alpha*separation/acceleration);
+
+		cloud_index l = 0;
+		while (l < deepest && ldexp(dt, -(int)l) > h)
+			l++;
+		// Coarser levels have to wait for the end of one of their steps.
+		while (l < level[i] && (tick & ((ticksPerStep >> l) - 1)))
+			l++;
+		level[i] = l;
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Changes the velocities of the active particles by their accelerations
+*        over half their timestep.
+*
+* @param[in] closing True to end a step from the half step velocities in k2
+*                    and m2, false to start one from the current velocities
+**/
+void BlockTimestep::kick(const bool closing) {
+	const cloud_index numActiveParticles = (cloud_index)active.size();
+	const cloud_index * const particles = active.data();
+	const double * const startX = closing ? cloud->k2 : cloud->Vx;
+	const double * const startY = closing ? cloud->m2 : cloud->Vy;
+	const cloud_index * const level = levels.data();
+	const double dt = init_dt;
+	BEGIN_PARALLEL_FOR(a, e, numActiveParticles, 1, static)
+		const cloud_index i = particles[a];
+		const double halfh = 0.5*ldexp(dt, -(int)level[i]);
+		cloud->Vx[i] = startX[i] + halfh*cloud->k1[i];
+		cloud->Vy[i] = startY[i] + halfh*cloud->m1[i];
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Keeps the half step velocities of the active particles in k2 and m2
+*        and predicts their velocities at the end of the step from the
+*        accelerations at its start, for the velocity dependent forces.
+**/
+void BlockTimestep::predict() {
+	const cloud_index numActiveParticles = (cloud_index)active.size();
+	const cloud_index * const particles = active.data();
+	const cloud_index * const level = levels.data();
+	const double dt = init_dt;
+	BEGIN_PARALLEL_FOR(a, e, numActiveParticles, 1, static)
+		const cloud_index i = particles[a];
+		const double halfh = 0.5*ldexp(dt, -(int)level[i]);
+		cloud->k2[i] = cloud->Vx[i];
+		cloud->m2[i] = cloud->Vy[i];
+		cloud->Vx[i] += halfh*cloud->k1[i];
+		cloud->Vy[i] += halfh*cloud->m1[i];
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Moves all particles with their current velocities over h.
+*
+* @param[in] h Length of the substep
+**/
+void BlockTimestep::drift(const double h) const {
+	const doubleV vh = set1_pd(h);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		plusEqual_pd(cloud->x + i, mul_pd(vh, load_pd(cloud->Vx + i)));
+		plusEqual_pd(cloud->y + i, mul_pd(vh, load_pd(cloud->Vy + i)));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Finds the deepest level that holds a particle.
+*
+* @return The deepest occupied level
+**/
+cloud_index BlockTimestep::deepestOccupiedLevel() const {
+	return *std::max_element(levels.begin(), levels.end());
+}
+
+/**
+* @brief Prints how many substeps were taken and how many particles they
+*        moved on average.
+*
+* @param[in] out Stream to print to
+**/
+void BlockTimestep::printStatistics(std::ostream &out) const {
+	out << "Block timesteps: " << numSubsteps << " substeps, "
+	<< (numSubsteps ? 100.0*(double)numActive/((double)numSubsteps*(double)cloud->n) : 0.0)
+	<< "% of the particles active per substep, deepest level " << deepestLevel << " (timestep/"
+	<< (1ul << deepestLevel) << ")." << std::endl;
+}
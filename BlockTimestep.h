@@ -0,0 +1,49 @@
+/**
+* @file  BlockTimestep.h
+* @brief Defines the data and methods of the BlockTimestep class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef BLOCKTIMESTEP_H
+#define BLOCKTIMESTEP_H
+
+#include "Integrator.h"
+#include <vector>
+
+class BlockTimestep : public Integrator {
+public:
+	BlockTimestep(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime,
+	              const double accuracyParameter, const cloud_index numLevels);
+	~BlockTimestep() {}
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	static const double closeDistance; // separation below which the timestep shrinks like the separation [m]
+
+	const double accuracy;          // fraction of the closest separation a particle may move in one step
+	const cloud_index maxLevel;     // deepest level, with a timestep of timeStep/2^maxLevel
+	ForceArray activeForces;        // forces that can compute a subset of the particles
+	ForceArray fullForces;          // forces that always compute every particle
+	std::vector<cloud_index> levels; // level of each particle
+	std::vector<cloud_index> active; // particles whose step ends at the current substep
+	bool levelsCurrent;             // true if levels and k1/m1 belong to the current state
+	bool oddSubstep;                // alternates force1 and force2 so thermal forces alternate their random numbers
+	unsigned long numReorders;      // cloud reorders the levels belong to
+
+	unsigned long numSubsteps;      // number of substeps
+	unsigned long numActive;        // sum of the active particles of all substeps
+	cloud_index deepestLevel;       // deepest level any particle used
+
+	void evaluate(const double time);
+	void assignLevels(const unsigned long tick, const unsigned long ticksPerStep);
+	void predict();
+	void kick(const bool closing);
+	void drift(const double h) const;
+	cloud_index deepestOccupiedLevel() const;
+};
+
+#endif // BLOCKTIMESTEP_H
@@ -0,0 +1,138 @@
+/**
+* @file  CarpenterKennedy.cpp
+* @class CarpenterKennedy CarpenterKennedy.h
+*
+* @brief Implementation of the five stage, fourth order low-storage Runge-Kutta
+*        method of Carpenter and Kennedy, which keeps one register per
+*        coordinate instead of the slopes of every stage
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "CarpenterKennedy.h"
+
+const cloud_index CarpenterKennedy::numStages;
+
+const double CarpenterKennedy::nodes[numStages] = {
+	0.0,
+	1432997174477.0/9575080441755.0,
+	2526269341429.0/6820363962896.0,
+	2006345519317.0/3224310063776.0,
+	2802321613138.0/2924317926251.0
+};
+
+const double CarpenterKennedy::registerWeights[numStages] = {
+	0.0,
+	-567301805773.0/1357537059087.0,
+	-2404267990393.0/2016746695238.0,
+	-3550918686646.0/2091501179385.0,
+	-1275806237668.0/842570457699.0
+};
+
+const double CarpenterKennedy::stateWeights[numStages] = {
+	1432997174477.0/9575080441755.0,
+	5161836677717.0/13612068292357.0,
+	1720146321549.0/2090206949498.0,
+	3134564353537.0/4481467310338.0,
+	2277821191437.0/14882151754819.0
+};
+
+/**
+* @brief Constructor for the CarpenterKennedy class
+*
+* @details The registers are the only storage besides the cloud's state and
+*          forces. The forces are evaluated at the state itself, so the cloud
+*          does not need separate caches or stage arrays.
+*
+* @param[in] C         Cloud object
+* @param[in] FA        Array of forces
+* @param[in] timeStep  Simulation time step
+* @param[in] startTime Simulation start time
+**/
+CarpenterKennedy::CarpenterKennedy(Cloud * const C, const ForceArray &FA, const double timeStep,
+                                   const double startTime)
+: Integrator(C, FA, timeStep, startTime), buffer(alignedNew<double>(4*C->n)),
+registerX(buffer), registerY(registerX + C->n), registerVx(registerY + C->n), registerVy(registerVx + C->n),
+oddSubstep(true) {}
+
+/**
+* @brief Destructor for the CarpenterKennedy class
+**/
+CarpenterKennedy::~CarpenterKennedy() {
+	alignedDelete(buffer);
+}
+
+/**
+* @brief Moves particles forward with the 2N-storage scheme of Carpenter and
+*        Kennedy (NASA TM-109112, 1994).
+*
+* @details Each stage evaluates the forces at the current state, then sets
+*          every register to its previous value times registerWeights[stage]
+*          plus dt times the slope, and adds stateWeights[stage] times the
+*          register to the state. Five stages give fourth order with one force
+*          evaluation more than RK4, but only four arrays of storage. One
+*          team of threads runs the whole loop.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void CarpenterKennedy::moveParticles(const double endTime) {
+	BEGIN_PARALLEL_REGION
+	while (currentTime < endTime) {
+		const double dt = modifyTimeStep(1.0e-4f, init_dt); // implement dynamic timstep (if necessary):
+
+		for (cloud_index s = 0; s < numStages; s++) {
+			evaluateForces(forces, currentTime + nodes[s]*dt, oddSubstep);
+			stage(s, dt);
+		}
+		BEGIN_SERIAL
+			currentTime += dt;
+		END_SERIAL
+	}
+	END_PARALLEL_REGION
+}
+
+/**
+* @brief Updates the registers and the state of one stage and resets the forces,
+*        in one pass.
+*
+* @details The first stage overwrites the registers, so it does not read them.
+*
+* @param[in] s  Stage to take
+* @param[in] dt Timestep
+**/
+void CarpenterKennedy::stage(const cloud_index s, const double dt) const {
+	const doubleV vdt = set1_pd(dt);
+	const doubleV registerWeight = set1_pd(registerWeights[s]), stateWeight = set1_pd(stateWeights[s]);
+	const bool first = !s;
+	double * const rx = registerX, * const ry = registerY, * const rVx = registerVx, * const rVy = registerVy;
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+
+		// assign force pointers:
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+
+		const doubleV vx = load_pd(cloud->Vx + i);
+		const doubleV vy = load_pd(cloud->Vy + i);
+		const doubleV dx = first ? mul_pd(vdt, vx) : fmadd_pd(registerWeight, load_pd(rx + i), mul_pd(vdt, vx));
+		const doubleV dy = first ? mul_pd(vdt, vy) : fmadd_pd(registerWeight, load_pd(ry + i), mul_pd(vdt, vy));
+		const doubleV ax = div_pd(mul_pd(vdt, load_pd(pFx)), vmass);
+		const doubleV ay = div_pd(mul_pd(vdt, load_pd(pFy)), vmass);
+		const doubleV dVx = first ? ax : fmadd_pd(registerWeight, load_pd(rVx + i), ax);
+		const doubleV dVy = first ? ay : fmadd_pd(registerWeight, load_pd(rVy + i), ay);
+		store_pd(rx + i, dx);
+		store_pd(ry + i, dy);
+		store_pd(rVx + i, dVx);
+		store_pd(rVy + i, dVy);
+
+		plusEqual_pd(cloud->x + i, mul_pd(stateWeight, dx));
+		plusEqual_pd(cloud->y + i, mul_pd(stateWeight, dy));
+		store_pd(cloud->Vx + i, fmadd_pd(stateWeight, dVx, vx));
+		store_pd(cloud->Vy + i, fmadd_pd(stateWeight, dVy, vy));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
@@ -0,0 +1,34 @@
+/**
+* @file  CarpenterKennedy.h
+* @brief Defines the data and methods of the CarpenterKennedy class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef CARPENTERKENNEDY_H
+#define CARPENTERKENNEDY_H
+
+#include "Integrator.h"
+
+class CarpenterKennedy : public Integrator {
+public:
+	CarpenterKennedy(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime);
+	~CarpenterKennedy();
+
+	void moveParticles(const double endTime);
+
+private:
+	static const cloud_index numStages = 5;
+	static const double nodes[numStages];         // stage times as fractions of the step
+	static const double registerWeights[numStages]; // weights of the registers kept from the previous stage
+	static const double stateWeights[numStages];  // weights of the registers added to the state
+
+	double * const buffer;          // registers of all coordinates
+	double * const registerX, * const registerY, * const registerVx, * const registerVy; // sums of the weighted slopes
+	bool oddSubstep;                // alternates force1 and force2 so thermal forces alternate their random numbers
+
+	void stage(const cloud_index s, const double dt) const;
+};
+
+#endif // CARPENTERKENNEDY_H
@@ -0,0 +1,92 @@
+/**
+* @file  CellList.cpp
+* @class CellList CellList.h
+*
+* @brief Bins particles into a uniform grid of cells so that pair searches
+*        only visit neighboring cells
+*
+* @license This file is distributed under the BSD Open Source License. 
+*          See LICENSE.TXT for details. 
+**/
+
+#include "CellList.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+* @brief Constructor for the CellList class
+* @param[in] numPar The number of particles
+**/
+CellList::CellList(const cloud_index numPar)
+: n(numPar), numCellsX(0), numCellsY(0), cellSize(0.0), originX(0.0), originY(0.0),
+particles(new cloud_index[n]), particleCell(new cloud_index[n]),
+// Padded by a vector width so the last particles can be loaded as a full vector.
+sortedX(new double[n + DOUBLE_STRIDE]()), sortedY(new double[n + DOUBLE_STRIDE]()) {}
+
+/**
+* @brief Destructor for the CellList class
+**/
+CellList::~CellList() {
+	delete[] particles; delete[] particleCell;
+	delete[] sortedX; delete[] sortedY;
+}
+
+/**
+* @brief Sorts the particles into cells.
+*
+* @details The grid covers the bounding box of the particles. Cells are at least
+*          minCellSize wide so that all partners within minCellSize of a particle
+*          are in the 3x3 block of cells around it. Cells are widened if needed so
+*          there are never more cells than particles. Inside a parallel region
+*          one thread sorts the particles and the team copies their positions.
+*
+* @param[in] x           Particle x-positions
+* @param[in] y           Particle y-positions
+* @param[in] minCellSize Smallest allowed cell width (m)
+**/
+void CellList::build(const double * const x, const double * const y, const double minCellSize) {
+	BEGIN_SERIAL
+		double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+		for (cloud_index i = 1; i < n; i++) {
+			minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+			minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+		}
+
+		cellSize = minCellSize;
+		do {
+			numCellsX = (cloud_index)((maxX - minX)/cellSize) + 1;
+			numCellsY = (cloud_index)((maxY - minY)/cellSize) + 1;
+			cellSize *= 2.0;
+		} while ((double)numCellsX*(double)numCellsY > (double)n);
+		cellSize /= 2.0;
+		originX = minX;
+		originY = minY;
+
+		// Counting sort of the particles by cell.
+		const cloud_index numCells = numCellsX*numCellsY;
+		cellStart.assign(numCells + 1, 0);
+		for (cloud_index i = 0; i < n; i++) {
+			particleCell[i] = cell(x[i], y[i]);
+			cellStart[particleCell[i] + 1]++;
+		}
+		for (cloud_index c = 0; c < numCells; c++)
+			cellStart[c + 1] += cellStart[c];
+
+		cellCursor.assign(cellStart.begin(), cellStart.end() - 1);
+		for (cloud_index i = 0; i < n; i++)
+			particles[cellCursor[particleCell[i]]++] = i;
+	END_SERIAL
+
+	BEGIN_PARALLEL_FOR(p, e, n, 1, static)
+		const cloud_index i = particles[p];
+		sortedX[p] = x[i];
+		sortedY[p] = y[i];
+	END_PARALLEL_FOR
+
+	BEGIN_SERIAL
+		// particleCell is reused to hold the cell of each sorted particle.
+		for (cloud_index c = 0, numCells = numCellsX*numCellsY; c < numCells; c++)
+			for (cloud_index p = cellStart[c], e = cellStart[c + 1]; p < e; p++)
+				particleCell[p] = c;
+	END_SERIAL
+}
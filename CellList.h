@@ -0,0 +1,60 @@
+/**
+* @file  CellList.h
+* @brief Defines the data and methods of the CellList class
+*
+* @license This file is distributed under the BSD Open Source License. 
+*          See LICENSE.TXT for details. 
+**/
+
+#ifndef CELLLIST_H
+#define CELLLIST_H
+
+#include "Parallel.h"
+#include "VectorCompatibility.h"
+#include <algorithm>
+#include <vector>
+
+class CellList {
+public:
+	CellList(const cloud_index numPar);
+	~CellList();
+
+	const cloud_index n;                  //!< Number of particles
+	cloud_index numCellsX, numCellsY;     //!< Dimensions of the cell grid
+	double cellSize;                      //!< Width of a cell (m)
+	double originX, originY;              //!< Lower left corner of the cell grid (m)
+	std::vector<cloud_index> cellStart;   //!< First sorted index of each cell, plus one past the end
+	cloud_index * const particles;        //!< Particle indices sorted by cell
+	cloud_index * const particleCell;     //!< Cell of each sorted particle
+	double * const sortedX, * const sortedY; //!< Particle positions sorted by cell
+
+	void build(const double * const x, const double * const y, const double minCellSize);
+
+	/**
+	* @brief Cell of the position x, y, which has to lie within the grid
+	**/
+	const cloud_index cell(const double x, const double y) const {
+		const cloud_index cx = std::min((cloud_index)((x - originX)/cellSize), numCellsX - 1);
+		const cloud_index cy = std::min((cloud_index)((y - originY)/cellSize), numCellsY - 1);
+		return cy*numCellsX + cx;
+	}
+
+	/**
+	* @brief First sorted index of the cell row cy spanning cells cx - 1 to cx + 1
+	**/
+	const cloud_index rowBegin(const cloud_index cx, const cloud_index cy) const {
+		return cellStart[cy*numCellsX + (cx ? cx - 1 : 0)];
+	}
+
+	/**
+	* @brief One past the last sorted index of the cell row cy spanning cells cx - 1 to cx + 1
+	**/
+	const cloud_index rowEnd(const cloud_index cx, const cloud_index cy) const {
+		return cellStart[cy*numCellsX + (cx + 1 < numCellsX ? cx + 1 : cx) + 1];
+	}
+
+private:
+	std::vector<cloud_index> cellCursor; //!< Scratch space for the counting sort
+};
+
+#endif // CELLLIST_H
@@ -9,8 +9,11 @@
 **/
 
 #include "Cloud.h"
+#include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 const double Cloud::electronCharge = -1.602E-19;
 const double Cloud::epsilon0 = 8.8541878E-12;
@@ -19,18 +22,18 @@ const double Cloud::epsilon0 = 8.8541878E-12;
 /**
 * @brief Constructor for the cloud class
 * @param[in] numPar The number of particles
+* @param[in] seed   Seed of the random numbers
 **/
-Cloud::Cloud(const cloud_index numPar) :
+Cloud::Cloud(const cloud_index numPar, const uint64_t seed) :
 	n(numPar),
-	x(new double[n]), y(new double[n]), Vx(new double[n]), Vy(new double[n]), 
-	charge(new double[n]), mass(new double[n]),
-	k1(new double[n]), k2(new double[n]), k3(new double[n]), k4(new double[n]),
-	l1(new double[n]), l2(new double[n]), l3(new double[n]), l4(new double[n]),
-	m1(new double[n]), m2(new double[n]), m3(new double[n]), m4(new double[n]),
-	n1(new double[n]), n2(new double[n]), n3(new double[n]), n4(new double[n]),
-	forceX(new double[n]), forceY(new double[n]),
-	xCache(new doubleV[n/DOUBLE_STRIDE]), yCache(new doubleV[n/DOUBLE_STRIDE]), 
-	VxCache(new doubleV[n/DOUBLE_STRIDE]), VyCache(new doubleV[n/DOUBLE_STRIDE]) {
+	x(alignedNew<double>(n)), y(alignedNew<double>(n)), Vx(alignedNew<double>(n)), Vy(alignedNew<double>(n)), 
+	charge(alignedNew<double>(n)), mass(alignedNew<double>(n)),
+	k1(NULL), k2(NULL), k3(NULL), m1(NULL), m2(NULL), m3(NULL),
+	forceX(alignedNew<double>(n)), forceY(alignedNew<double>(n)),
+	xCache((doubleV *)x), yCache((doubleV *)y), VxCache((doubleV *)Vx), VyCache((doubleV *)Vy),
+	id(new cloud_index[n]), numReorders(0), rands(seed) {
+	for (cloud_index i = 0; i < n; i++)
+		id[i] = i;
 	#ifdef _OPENMP
 		omp_set_num_threads(omp_get_num_procs()); 
 	#endif
@@ -40,15 +43,16 @@ Cloud::Cloud(const cloud_index numPar) :
 * @brief Destructor for the cloud class
 **/
 Cloud::~Cloud() {
-	delete[] x; delete[] y; delete[] Vx; delete[] Vy;
-	delete[] charge; delete[] mass; 
-	delete[] k1; delete[] k2; delete[] k3; delete[] k4;
-	delete[] l1; delete[] l2; delete[] l3; delete[] l4;
-	delete[] m1; delete[] m2; delete[] m3; delete[] m4;
-	delete[] n1; delete[] n2; delete[] n3; delete[] n4;
-	delete[] forceX; delete[] forceY;
-	delete[] xCache; delete[] yCache; 
-	delete[] VxCache; delete[] VyCache;
+	alignedDelete(x); alignedDelete(y); alignedDelete(Vx); alignedDelete(Vy);
+	alignedDelete(charge); alignedDelete(mass); 
+	alignedDelete(k1); alignedDelete(k2); alignedDelete(k3);
+	alignedDelete(m1); alignedDelete(m2); alignedDelete(m3);
+	alignedDelete(forceX); alignedDelete(forceY);
+	if ((double *)xCache != x) {
+		alignedDelete(xCache); alignedDelete(yCache); 
+		alignedDelete(VxCache); alignedDelete(VyCache);
+	}
+	delete[] id;
 }
 
 /**
@@ -59,9 +63,13 @@ Cloud::~Cloud() {
 * @param[in] qSigma The standard deviation for the charge in Coulombs
 **/
 inline void Cloud::initCharge(const double qMean, const double qSigma) {
-	std::normal_distribution<double> dist(qMean, qSigma);
-	for (cloud_index i = 0; i < n; i++)
-		charge[i] = rands.gaussian(dist)*electronCharge;
+	const uint32_t stream = rands.newStream();
+	BEGIN_PARALLEL_FOR(i, e, n, DOUBLE_STRIDE, static)
+		doubleV u1, u2, g1, g2;
+		rands.uniform_pd(stream, loadWide_epi64(id + i), 0, u1, u2);
+		RandomNumbers::gaussian_pd(u1, u2, g1, g2);
+		store_pd(charge + i, mul_pd(fmadd_pd(g1, set1_pd(qSigma), set1_pd(qMean)), electronCharge));
+	END_PARALLEL_FOR
 }
 
 /**
@@ -73,11 +81,14 @@ inline void Cloud::initCharge(const double qMean, const double qSigma) {
 **/
 inline void Cloud::initMass(const double rMean, const double rSigma) {
 	const double particleMassConstant = (4.0/3.0)*M_PI*dustParticleMassDensity;
-	std::normal_distribution<double> dist(rMean, rSigma);
-	for (cloud_index i = 0; i < n; i++) {
-		const double r = rands.gaussian(dist);
-		mass[i] = particleMassConstant*r*r*r;
-	}
+	const uint32_t stream = rands.newStream();
+	BEGIN_PARALLEL_FOR(i, e, n, DOUBLE_STRIDE, static)
+		doubleV u1, u2, g1, g2;
+		rands.uniform_pd(stream, loadWide_epi64(id + i), 0, u1, u2);
+		RandomNumbers::gaussian_pd(u1, u2, g1, g2);
+		const doubleV r = fmadd_pd(g1, set1_pd(rSigma), set1_pd(rMean));
+		store_pd(mass + i, mul_pd(mul_pd(mul_pd(r, r), r), particleMassConstant));
+	END_PARALLEL_FOR
 }
 
 /**
@@ -91,14 +102,16 @@ inline void Cloud::initMass(const double rMean, const double rSigma) {
 * @param[in] rSigma The standard deviation for the radius in meters
 * @param[in] qMean  The average charge in Coulombs
 * @param[in] qSigma The standard deviation for the charge in Coulombs
+* @param[in] seed   Seed of the random numbers
 **/
 Cloud * const Cloud::initializeGrid(const cloud_index numParticles,
 									cloud_index row_x_particles,
 									cloud_index row_y_particles,
 									const double rMean, const double rSigma,
-                                    const double qMean, const double qSigma) {
+                                    const double qMean, const double qSigma,
+                                    const uint64_t seed) {
 
-	Cloud * const cloud = new Cloud(numParticles);
+	Cloud * const cloud = new Cloud(numParticles, seed);
 
 	const cloud_index sqrtNumPar = (cloud_index)floor(sqrt(numParticles));
 
@@ -142,9 +155,11 @@ Cloud * const Cloud::initializeGrid(const cloud_index numParticles,
 * @param[in]  file        The name of the fits file
 * @param[out] error       The error code (if any) that was produced when opening the file
 * @param[in]  currentTime ??UNKNOWN??
+* @param[in]  seed        Seed of the random numbers, unless the run is continued
+*                         (currentTime is given) and the file has a seed
 **/
 Cloud * const Cloud::initializeFromFile(fitsfile * const file, int &error, 
-					double * const currentTime) {
+					double * const currentTime, const uint64_t seed) {
 	int anyNull = 0;
 	long numParticles = 0;
 	long numTimeSteps = 0;
@@ -158,7 +173,7 @@ Cloud * const Cloud::initializeFromFile(fitsfile * const file, int &error,
 		fits_get_num_rows(file, &numParticles, &error);
 
 	// create cloud:
-	Cloud * const cloud = new Cloud((cloud_index)numParticles);
+	Cloud * const cloud = new Cloud((cloud_index)numParticles, seed);
 
 	// read mass information:
 	if (!error) {
@@ -185,6 +200,25 @@ Cloud * const Cloud::initializeFromFile(fitsfile * const file, int &error,
 		fits_read_col_dbl(file, 5, numTimeSteps, 1, numParticles, 0.0, cloud->Vy, &anyNull, &error);
 	}
 
+	// A continued run keeps the seed of the file, and its forces count substeps
+	// from 2^32 per written time step on, past those of the earlier runs. Files
+	// written before the seed was added have no randomSeed key.
+	if (!error && currentTime) {
+		LONGLONG fileSeed = (LONGLONG)seed;
+		fits_movabs_hdu(file, 1, IMAGE_HDU, &error);
+		if (!error) {
+			fits_read_key_lnglng(file, const_cast<char *> ("randomSeed"), &fileSeed, NULL, &error);
+			if (error == KEY_NO_EXIST)
+				error = 0;
+		}
+		cloud->rands = RandomNumbers((uint64_t)fileSeed, (uint64_t)numTimeSteps << 32);
+	}
+
+	// The charges and masses are read, but their streams are still taken so the
+	// forces get the same streams as in a run started from a grid.
+	cloud->rands.newStream();
+	cloud->rands.newStream();
+
 	return cloud;
 }
 
@@ -215,14 +249,23 @@ void Cloud::writeCloudSetup(fitsfile * const file, int &error) const {
 		const_cast<char *> ("m"), const_cast<char *> ("m"), 
 		const_cast<char *> ("m/s"), const_cast<char *> ("m/s")};
 
+	// write seed to the primary HDU, so -c continues the random numbers:
+	if (!error)
+		// file, # indicating primary HDU, HDU type, error
+		fits_movabs_hdu(file, 1, IMAGE_HDU, &error);
+	if (!error)
+		// file, key name, value, comment, error
+		fits_write_key_lng(file, const_cast<char *> ("randomSeed"), (LONGLONG)rands.getSeed(),
+		                   const_cast<char *> ("Seed of the random numbers"), &error);
+
 	// write mass:
 	if (!error)
 		// file, storage type, num rows, num columns, ...
 		fits_create_tbl(file, BINARY_TBL, (LONGLONG)n, 2, ttypeCloud, tformCloud, tunitCloud, "CLOUD", &error);	
 	if (!error) {
 		// file, column #, starting row, first element, num elements, mass array, error
-		fits_write_col_dbl(file, 1, 1, 1, (LONGLONG)n, mass, &error);
-		fits_write_col_dbl(file, 2, 1, 1, (LONGLONG)n, charge, &error);
+		writeColumn(file, 1, 1, mass, error);
+		writeColumn(file, 2, 1, charge, error);
 	}
 
 	// write position and velocity:
@@ -234,10 +277,10 @@ void Cloud::writeCloudSetup(fitsfile * const file, int &error) const {
 	if (!error) {
 		double time = 0.0;
 		fits_write_col_dbl(file, 1, 1, 1, 1, &time, &error);
-		fits_write_col_dbl(file, 2, 1, 1, (LONGLONG)n, x, &error);
-		fits_write_col_dbl(file, 3, 1, 1, (LONGLONG)n, y, &error);
-		fits_write_col_dbl(file, 4, 1, 1, (LONGLONG)n, Vx, &error);
-		fits_write_col_dbl(file, 5, 1, 1, (LONGLONG)n, Vy, &error);
+		writeColumn(file, 2, 1, x, error);
+		writeColumn(file, 3, 1, y, error);
+		writeColumn(file, 4, 1, Vx, error);
+		writeColumn(file, 5, 1, Vy, error);
 	}
 
 	// write buffer, close file, reopen at same point:
@@ -260,16 +303,147 @@ void Cloud::writeTimeStep(fitsfile * const file, int &error, double currentTime)
 		long numRows = 0;
 		fits_get_num_rows(file, &numRows, &error);
 		fits_write_col_dbl(file, 1, ++numRows, 1, 1, &currentTime, &error);
-		fits_write_col_dbl(file, 2, numRows, 1, (LONGLONG)n, x, &error);
-		fits_write_col_dbl(file, 3, numRows, 1, (LONGLONG)n, y, &error);
-		fits_write_col_dbl(file, 4, numRows, 1, (LONGLONG)n, Vx, &error);
-		fits_write_col_dbl(file, 5, numRows, 1, (LONGLONG)n, Vy, &error);
+		writeColumn(file, 2, numRows, x, error);
+		writeColumn(file, 3, numRows, y, error);
+		writeColumn(file, 4, numRows, Vx, error);
+		writeColumn(file, 5, numRows, Vy, error);
 	}
 
 	// write buffer, close file, reopen at same point:
 	fits_flush_file(file, &error);
 }
 
+/**
+* @brief Writes a particle array to a fits column in the original particle 
+*        order.
+*
+* @param[in]     file   The fits file
+* @param[in]     column Column number
+* @param[in]     row    Row number
+* @param[in]     a      Array with one value per particle
+* @param[in,out] error  Error status code
+**/
+void Cloud::writeColumn(fitsfile * const file, const int column, const LONGLONG row, 
+                        const double * const a, int &error) const {
+	if (!numReorders) {
+		fits_write_col_dbl(file, column, row, 1, (LONGLONG)n, const_cast<double *> (a), &error);
+		return;
+	}
+
+	std::vector<double> buffer(n);
+	double * const original = buffer.data();
+	BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+		original[id[i]] = a[i];
+	END_PARALLEL_FOR
+	fits_write_col_dbl(file, column, row, 1, (LONGLONG)n, original, &error);
+}
+
+/**
+* @brief Sorts the particles along a Hilbert curve through their bounding box,
+*        so that particles close in space are close in memory.
+*
+* @details Moves the positions, velocities, charges, masses and ids. The 
+*          Runge-Kutta stage arrays, caches and forces are recomputed in every
+*          timestep, so this must be called between timesteps and they are not
+*          moved. Forces that keep per-particle data must rebuild it when 
+*          numReorders changes. The forces are zero between timesteps, so
+*          forceX holds each array while it is permuted and is zeroed again.
+**/
+void Cloud::reorder() {
+	double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+	for (cloud_index i = 1; i < n; i++) {
+		minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+		minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+	}
+	const double side = std::max(maxX - minX, maxY - minY);
+	const double scale = side > 0.0 ? 65535.0/side : 0.0;
+
+	std::vector<std::pair<unsigned, cloud_index> > keys(n);
+	std::pair<unsigned, cloud_index> * const order = keys.data();
+	BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+		order[i] = std::make_pair(hilbertIndex((unsigned)((x[i] - minX)*scale), (unsigned)((y[i] - minY)*scale)), (cloud_index)i);
+	END_PARALLEL_FOR
+	std::sort(order, order + n);
+
+	double * const scratch = forceX;
+	for (double * const a : {x, y, Vx, Vy, charge, mass}) {
+		BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+			scratch[i] = a[order[i].second];
+		END_PARALLEL_FOR
+		std::copy(scratch, scratch + n, a);
+	}
+	std::fill(scratch, scratch + n, 0.0);
+
+	const std::vector<cloud_index> oldId(id, id + n);
+	const cloud_index * const previous = oldId.data();
+	BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+		id[i] = previous[order[i].second];
+	END_PARALLEL_FOR
+	++numReorders;
+}
+
+/**
+* @brief Allocates the velocity increments of the first stages, for integrators
+*        that keep them between force evaluations.
+*
+* @details Clouds only hold the state and forces until an integrator asks for
+*          more, so integrators that need fewer stage arrays leave room for
+*          larger clouds. Stages that are already allocated are kept.
+*
+* @param[in] numSlopes Number of stages of k and m to allocate (at most 3)
+**/
+void Cloud::allocateSlopes(const cloud_index numSlopes) {
+	double ** const kSlopes[] = {&k1, &k2, &k3};
+	double ** const mSlopes[] = {&m1, &m2, &m3};
+	for (cloud_index s = 0; s < numSlopes && s < 3; s++)
+		if (!*kSlopes[s]) {
+			*kSlopes[s] = alignedNew<double>(n);
+			*mSlopes[s] = alignedNew<double>(n);
+		}
+}
+
+/**
+* @brief Gives the caches read by force2, force3 and force4 their own storage.
+*
+* @details Until this is called the caches are the positions and velocities,
+*          so integrators that evaluate every force at the current state can
+*          use any substep without copying it. Integrators that evaluate forces
+*          at intermediate states write those into the caches and must call
+*          this first.
+**/
+void Cloud::allocateCaches() {
+	if ((double *)xCache != x)
+		return;
+	xCache = alignedNew<doubleV>(n/DOUBLE_STRIDE);
+	yCache = alignedNew<doubleV>(n/DOUBLE_STRIDE);
+	VxCache = alignedNew<doubleV>(n/DOUBLE_STRIDE);
+	VyCache = alignedNew<doubleV>(n/DOUBLE_STRIDE);
+}
+
+/**
+* @brief Returns the position of a cell along a Hilbert curve through a grid of
+*        2^16 by 2^16 cells.
+*
+* @param[in] x Cell column
+* @param[in] y Cell row
+**/
+unsigned Cloud::hilbertIndex(unsigned x, unsigned y) {
+	unsigned index = 0;
+	for (unsigned s = 1 << 15; s; s >>= 1) {
+		const unsigned rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+		index += s*s*((3*rx) ^ ry);
+		// Rotate the quadrant so the curve continues in the next one.
+		if (!ry) {
+			if (rx) {
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return index;
+}
+
 /**
 * @brief x-position helper method for 4th-order Runge-Kutta substep
 * @param[in] i ??UNKNOWN??
@@ -307,7 +481,7 @@ const doubleV Cloud::getx4_pd(const cloud_index i) const {
 * @param[in] i ??UNKNOWN??
 **/
 const doubleV Cloud::getx1r_pd(const cloud_index i) const {
-	return _mm_loadr_pd(x + i);
+	return loadr_pd(x + i);
 }
 
 /**
@@ -316,7 +490,7 @@ const doubleV Cloud::getx1r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::getx2r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(xCache[j], xCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(xCache[j]);
 }
 
 /**
@@ -325,7 +499,7 @@ const doubleV Cloud::getx2r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::getx3r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(xCache[j], xCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(xCache[j]);
 }
 
 /**
@@ -334,7 +508,7 @@ const doubleV Cloud::getx3r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::getx4r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(xCache[j], xCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(xCache[j]);
 }
 
 // Y position helper functions -------------------------------------------------
@@ -376,7 +550,7 @@ const doubleV Cloud::gety4_pd(const cloud_index i) const {
 * @param[in] i ??UNKNOWN??
 **/
 const doubleV Cloud::gety1r_pd(const cloud_index i) const {
-	return _mm_loadr_pd(y + i);
+	return loadr_pd(y + i);
 }
 
 /**
@@ -385,7 +559,7 @@ const doubleV Cloud::gety1r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::gety2r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(yCache[j], yCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(yCache[j]);
 }
 
 /**
@@ -394,7 +568,7 @@ const doubleV Cloud::gety2r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::gety3r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(yCache[j], yCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(yCache[j]);
 }
 
 /**
@@ -403,7 +577,7 @@ const doubleV Cloud::gety3r_pd(const cloud_index i) const {
 **/
 const doubleV Cloud::gety4r_pd(const cloud_index i) const {
 	const cloud_index j = i/DOUBLE_STRIDE;
-	return _mm_shuffle_pd(yCache[j], yCache[j], _MM_SHUFFLE2(0, 1));
+	return reverse_pd(yCache[j]);
 }
 
 // Vx position helper functions ------------------------------------------------
@@ -15,20 +15,20 @@
 
 class Cloud {	
 	public:
-		Cloud(const cloud_index numPar);
+		Cloud(const cloud_index numPar, const uint64_t seed);
 		~Cloud();
 
 		const cloud_index n; //!< Number of particles
 		double * const x, * const y, * const Vx, * const Vy;   //!< current positions and velocities
 		double * const charge, * const mass; 				   //!< Paricle charges and masses
-		double * const k1, * const k2, * const k3, * const k4; //!< velocityX (Runge-Kutta) tidbit
-		double * const l1, * const l2, * const l3, * const l4; //!< positionsX (Runge-Kutta) tidbits
-		double * const m1, * const m2, * const m3, * const m4; //!< velocityY (Runge-Kutta) tidbits
-		double * const n1, * const n2, * const n3, * const n4; //!< positionsY (Runge-Kutta) tidbits
+		double *k1, *k2, *k3; //!< velocityX (Runge-Kutta) tidbits, allocated by allocateSlopes()
+		double *m1, *m2, *m3; //!< velocityY (Runge-Kutta) tidbits, allocated by allocateSlopes()
 		double * const forceX, * const forceY;				   //!< Force on particles
-		doubleV * const xCache, * const yCache, * const VxCache, * const VyCache; //!< Cached position/velocity data
+		doubleV *xCache, *yCache, *VxCache, *VyCache; //!< Cached position/velocity data, the current state until allocateCaches()
+		cloud_index * const id; //!< Original index of the particle in each slot, used for output
+		unsigned long numReorders; //!< Number of times the particles were reordered
 		
-		RandomNumbers rands; //!< Random number class used for charge/mass initialization
+		RandomNumbers rands; //!< Random numbers of the charges, masses and thermal forces
 
 		static double interParticleSpacing; //!< The distance (m) between each particle in the grid
 		static const double electronCharge; //!< Electron charge (C)
@@ -42,6 +42,9 @@ class Cloud {
 
 		void writeCloudSetup(fitsfile * const file, int &error) const;
 		void writeTimeStep(fitsfile * const file, int &error, double currentTime) const;
+		void reorder();
+		void allocateSlopes(const cloud_index numSlopes);
+		void allocateCaches();
 	    
 		const doubleV getx1_pd(const cloud_index i) const;
 		const doubleV getx2_pd(const cloud_index i) const;
@@ -77,13 +80,17 @@ class Cloud {
 											cloud_index row_x_particles,
 											cloud_index row_y_particles,
 											const double rMean, const double rSigma,
-	                                        const double qMean, const double qSigma);
+	                                        const double qMean, const double qSigma,
+	                                        const uint64_t seed);
 		static Cloud * const initializeFromFile(fitsfile * const file, int &error, 
-	                                            double * const currentTime);
+	                                            double * const currentTime, const uint64_t seed);
 		
 	private:
 		void initCharge(const double qMean, const double qSigma);	
 		void initMass(const double rMean, const double rSigma);
+		void writeColumn(fitsfile * const file, const int column, const LONGLONG row, 
+		                 const double * const a, int &error) const;
+		static unsigned hilbertIndex(unsigned x, unsigned y);
 };
 
 #endif // CLOUD_H
@@ -49,8 +49,8 @@ inline void ConfinementForce::force(const cloud_index currentParticle, const dou
                                     const doubleV currentPositionY) {
 	const doubleV cV = mul_pd(load_pd(cloud->charge + currentParticle), confine);
 	
-	plusEqual_pd(cloud->forceX + currentParticle, mul_pd(cV, currentPositionX));
-	plusEqual_pd(cloud->forceY + currentParticle, mul_pd(cV, currentPositionY));
+	plusEqual_pd(targetX + currentParticle, mul_pd(cV, currentPositionX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(cV, currentPositionY));
 }
 
 void ConfinementForce::writeForce(fitsfile * const file, int * const error) const {
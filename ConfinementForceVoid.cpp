@@ -50,8 +50,8 @@ inline void ConfinementForceVoid::force(const cloud_index currentParticle, const
     const doubleV r = length_pd(currentPositionX, currentPositionY);
 	const doubleV expR = div_pd(exp_pd(mul_pd(r, -decay)), r);
 	
-	plusEqual_pd(cloud->forceX + currentParticle, mul_pd(mul_pd(decayV, expR), currentPositionX));
-	plusEqual_pd(cloud->forceY + currentParticle, mul_pd(mul_pd(decayV, expR), currentPositionY));
+	plusEqual_pd(targetX + currentParticle, mul_pd(mul_pd(decayV, expR), currentPositionX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(mul_pd(decayV, expR), currentPositionY));
 }
 
 void ConfinementForceVoid::writeForce(fitsfile * const file, int * const error) const {
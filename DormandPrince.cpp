@@ -0,0 +1,326 @@
+/**
+* @file  DormandPrince.cpp
+* @class DormandPrince DormandPrince.h
+*
+* @brief Implementation of the embedded Dormand-Prince 5(4) Runge-Kutta method,
+*        which adapts the timestep to a local error tolerance and interpolates
+*        the output times
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "DormandPrince.h"
+#include <algorithm>
+#include <cmath>
+
+const cloud_index DormandPrince::numStages;
+
+const double DormandPrince::nodes[numStages] = {0.0, 1.0/5.0, 3.0/10.0, 4.0/5.0, 8.0/9.0, 1.0, 1.0};
+
+const double DormandPrince::stageWeights[numStages][numStages - 1] = {
+	{0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+	{1.0/5.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+	{3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0, 0.0},
+	{44.0/45.0, -56.0/15.0, 32.0/9.0, 0.0, 0.0, 0.0},
+	{19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0, 0.0, 0.0},
+	{9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0, 0.0},
+	{35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0}
+};
+
+const double DormandPrince::errorWeights[numStages] = {
+	71.0/57600.0, 0.0, -71.0/16695.0, 71.0/1920.0, -17253.0/339200.0, 22.0/525.0, -1.0/40.0
+};
+
+const double DormandPrince::denseWeights[numStages][4] = {
+	{1.0, -8048581381.0/2820520608.0, 8663915743.0/2820520608.0, -12715105075.0/11282082432.0},
+	{0.0, 0.0, 0.0, 0.0},
+	{0.0, 131558114200.0/32700410799.0, -68118460800.0/10900136933.0, 87487479700.0/32700410799.0},
+	{0.0, -1754552775.0/470086768.0, 14199869525.0/1410260304.0, -10690763975.0/1880347072.0},
+	{0.0, 127303824393.0/49829197408.0, -318862633887.0/49829197408.0, 701980252875.0/199316789632.0},
+	{0.0, -282668133.0/205662961.0, 2019193451.0/616988883.0, -1453857185.0/822651844.0},
+	{0.0, 40617522.0/29380423.0, -110615467.0/29380423.0, 69997945.0/29380423.0}
+};
+
+/**
+* @brief Constructor for the DormandPrince class
+*
+* @param[in] C         Cloud object
+* @param[in] FA        Array of forces
+* @param[in] timeStep  Length of the first trial step [s]
+* @param[in] startTime Simulation start time
+* @param[in] relTol    Allowed local error relative to the size of each coordinate
+* @param[in] absTol    Allowed local error of coordinates near zero [m, m/s]
+**/
+DormandPrince::DormandPrince(Cloud * const C, const ForceArray &FA, const double timeStep,
+                             const double startTime, const double relTol, const double absTol)
+: Integrator(C, FA, timeStep, startTime), relativeTolerance(relTol), absoluteTolerance(absTol),
+minimumStep(1.0E-6*timeStep), numChunks((cloud_index)NUM_THREADS),
+buffer(alignedNew<double>((4*numStages + 4)*C->n)), chunkErrors(alignedNew<double>(numChunks*DOUBLE_STRIDE)),
+startX(buffer + 4*numStages*C->n), startY(startX + C->n), startVx(startY + C->n), startVy(startVx + C->n),
+stepStart(startTime), stepSize(0.0), trialStep(timeStep), previousError(1.0E-4), firstSlopeCurrent(false), interpolated(false),
+oddSubstep(true), numReorders(C->numReorders), numAccepted(0), numRejected(0), numEvaluations(0),
+shortestStep(0.0), longestStep(0.0) {
+	C->allocateCaches();
+	for (cloud_index stage = 0; stage < numStages; stage++) {
+		accelerationX[stage] = buffer + 4*stage*C->n;
+		accelerationY[stage] = accelerationX[stage] + C->n;
+		velocityX[stage] = accelerationY[stage] + C->n;
+		velocityY[stage] = velocityX[stage] + C->n;
+	}
+}
+
+/**
+* @brief Destructor for the DormandPrince class
+**/
+DormandPrince::~DormandPrince() {
+	alignedDelete(buffer);
+	alignedDelete(chunkErrors);
+}
+
+/**
+* @brief Moves particles forward with steps of the Dormand-Prince 5(4) method
+*        as long as the local error allows, and interpolates the state at
+*        endTime.
+*
+* @details Each step evaluates the forces six times. The slopes at the end of
+*          an accepted step are those at the start of the next. The step that
+*          passes endTime is kept, and the cloud is set to the 4th order
+*          interpolant of that step at endTime, so the output times do not
+*          limit the timestep. The next call continues from the end of the kept
+*          step. If the cloud has been reordered in between, it continues from
+*          the interpolated state instead, which is within the tolerance.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void DormandPrince::moveParticles(const double endTime) {
+	if (interpolated) {
+		if (numReorders != cloud->numReorders) {
+			firstSlopeCurrent = false;
+			interpolated = false;
+		} else if (stepStart + stepSize >= endTime) {
+			interpolate(endTime);
+			return;
+		} else {
+			// Restore the end of the kept step exactly like stage 7 computed it.
+			for (cloud_index stage = 0; stage < numStages - 1; stage++)
+				weights[stage] = stepSize*stageWeights[numStages - 1][stage];
+			combine(numStages - 1, startX, startY, startVx, startVy, cloud->x, cloud->y, cloud->Vx, cloud->Vy);
+			currentTime = stepStart + stepSize;
+			interpolated = false;
+			rotateSlopes();
+		}
+	}
+
+	// Reordering the cloud moves the particles out from under their slopes.
+	if (numReorders != cloud->numReorders) {
+		firstSlopeCurrent = false;
+		numReorders = cloud->numReorders;
+	}
+
+	bool rejected = false;
+	while (currentTime < endTime) {
+		if (!firstSlopeCurrent) {
+			combine(0, cloud->x, cloud->y, cloud->Vx, cloud->Vy,
+			        (double *)cloud->xCache, (double *)cloud->yCache, (double *)cloud->VxCache, (double *)cloud->VyCache);
+			evaluate(0, currentTime);
+			firstSlopeCurrent = true;
+		}
+
+		const double h = trialStep;
+		for (cloud_index stage = 1; stage < numStages; stage++) {
+			for (cloud_index slope = 0; slope < stage; slope++)
+				weights[slope] = h*stageWeights[stage][slope];
+			combine(stage, cloud->x, cloud->y, cloud->Vx, cloud->Vy,
+			        (double *)cloud->xCache, (double *)cloud->yCache, (double *)cloud->VxCache, (double *)cloud->VyCache);
+			evaluate(stage, currentTime + nodes[stage]*h);
+		}
+
+		// Step size control with a safety factor of 0.9 and the error of the
+		// last accepted step damping oscillations of the step, as in Hairer's
+		// DOPRI5. A NaN error fails the test and shrinks the step fivefold.
+		const double error = errorNorm(h);
+		const double factor = 0.9*pow(error, -0.17)*pow(previousError, 0.04);
+		if (!(error <= 1.0) && h > minimumStep) {
+			++numRejected;
+			trialStep = h*std::max(0.2, factor);
+			rejected = true;
+			continue;
+		}
+
+		shortestStep = numAccepted ? std::min(shortestStep, h) : h;
+		longestStep = std::max(longestStep, h);
+		++numAccepted;
+		trialStep = h*std::min(rejected ? 1.0 : 5.0, std::max(0.2, factor));
+		previousError = std::max(error, 1.0E-4);
+		rejected = false;
+
+		// Keep the step that passes endTime and interpolate within it.
+		if (currentTime + h >= endTime) {
+			combine(0, cloud->x, cloud->y, cloud->Vx, cloud->Vy, startX, startY, startVx, startVy);
+			stepStart = currentTime;
+			stepSize = h;
+			interpolated = true;
+			interpolate(endTime);
+			return;
+		}
+
+		// The 7th stage is evaluated at the 5th order solution.
+		combine(0, (const double *)cloud->xCache, (const double *)cloud->yCache,
+		        (const double *)cloud->VxCache, (const double *)cloud->VyCache,
+		        cloud->x, cloud->y, cloud->Vx, cloud->Vy);
+		currentTime += h;
+		rotateSlopes();
+	}
+}
+
+/**
+* @brief Evaluates the forces at the cached positions and velocities and stores
+*        the slopes of a stage.
+*
+* @param[in] stage Stage to store the slopes of
+* @param[in] time  Time of the stage
+**/
+void DormandPrince::evaluate(const cloud_index stage, const double time) {
+	runForces(forces, oddSubstep ? &Force::force3 : &Force::force4, time);
+	oddSubstep = !oddSubstep;
+	++numEvaluations;
+
+	double * const ax = accelerationX[stage], * const ay = accelerationY[stage];
+	double * const vx = velocityX[stage], * const vy = velocityY[stage];
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		store_pd(ax + i, div_pd(load_pd(pFx), vmass));
+		store_pd(ay + i, div_pd(load_pd(pFy), vmass));
+		store_pd(vx + i, cloud->getVx2_pd(i));
+		store_pd(vy + i, cloud->getVy2_pd(i));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Adds the slopes of the first stages times weights to a state.
+*
+* @param[in]  numSlopes Number of stages to add, 0 to copy the state
+* @param[in]  x0        x-positions to start from
+* @param[in]  y0        y-positions to start from
+* @param[in]  Vx0       x-velocities to start from
+* @param[in]  Vy0       y-velocities to start from
+* @param[out] x         x-positions
+* @param[out] y         y-positions
+* @param[out] Vx        x-velocities
+* @param[out] Vy        y-velocities
+**/
+void DormandPrince::combine(const cloud_index numSlopes,
+                            const double * const x0, const double * const y0,
+                            const double * const Vx0, const double * const Vy0,
+                            double * const x, double * const y, double * const Vx, double * const Vy) const {
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		doubleV vx = load_pd(x0 + i), vy = load_pd(y0 + i);
+		doubleV vVx = load_pd(Vx0 + i), vVy = load_pd(Vy0 + i);
+		for (cloud_index stage = 0; stage < numSlopes; stage++) {
+			const doubleV weight = set1_pd(weights[stage]);
+			vx = fmadd_pd(weight, load_pd(velocityX[stage] + i), vx);
+			vy = fmadd_pd(weight, load_pd(velocityY[stage] + i), vy);
+			vVx = fmadd_pd(weight, load_pd(accelerationX[stage] + i), vVx);
+			vVy = fmadd_pd(weight, load_pd(accelerationY[stage] + i), vVy);
+		}
+		store_pd(x + i, vx);
+		store_pd(y + i, vy);
+		store_pd(Vx + i, vVx);
+		store_pd(Vy + i, vVy);
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Computes the local error of a step relative to the tolerance.
+*
+* @details The error is the difference of the 5th and 4th order solutions.
+*          Each coordinate may have an error of absoluteTolerance plus
+*          relativeTolerance times its larger size at the start and end of
+*          the step. The largest ratio over all coordinates is returned, so a
+*          close pair can't hide among the rest of the cloud. Each chunk keeps
+*          the largest ratio of each lane, which are compared at the end.
+*
+* @param[in] h Length of the step [s]
+*
+* @return Largest ratio of error to allowed error, the step is accepted if <= 1
+**/
+const double DormandPrince::errorNorm(const double h) {
+	for (cloud_index stage = 0; stage < numStages; stage++)
+		weights[stage] = h*errorWeights[stage];
+
+	const cloud_index numParticles = cloud->n;
+	const cloud_index chunkSize = (numParticles/DOUBLE_STRIDE + numChunks - 1)/numChunks*DOUBLE_STRIDE;
+	const doubleV relTol = set1_pd(relativeTolerance), absTol = set1_pd(absoluteTolerance);
+	BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+		doubleV largest = set0_pd();
+		for (cloud_index i = chunk*chunkSize, end = std::min(numParticles, i + chunkSize); i < end; i += DOUBLE_STRIDE) {
+			const cloud_index v = i/DOUBLE_STRIDE;
+			const doubleV start[4] = {load_pd(cloud->x + i), load_pd(cloud->y + i),
+			                          load_pd(cloud->Vx + i), load_pd(cloud->Vy + i)};
+			const doubleV finish[4] = {cloud->xCache[v], cloud->yCache[v], cloud->VxCache[v], cloud->VyCache[v]};
+			doubleV error[4] = {set0_pd(), set0_pd(), set0_pd(), set0_pd()};
+			for (cloud_index stage = 0; stage < numStages; stage++) {
+				const doubleV weight = set1_pd(weights[stage]);
+				error[0] = fmadd_pd(weight, load_pd(velocityX[stage] + i), error[0]);
+				error[1] = fmadd_pd(weight, load_pd(velocityY[stage] + i), error[1]);
+				error[2] = fmadd_pd(weight, load_pd(accelerationX[stage] + i), error[2]);
+				error[3] = fmadd_pd(weight, load_pd(accelerationY[stage] + i), error[3]);
+			}
+			for (cloud_index k = 0; k < 4; k++) {
+				const doubleV size = max_pd(max_pd(start[k], sub_pd(set0_pd(), start[k])),
+				                            max_pd(finish[k], sub_pd(set0_pd(), finish[k])));
+				const doubleV allowed = fmadd_pd(relTol, size, absTol);
+				largest = max_pd(largest, div_pd(max_pd(error[k], sub_pd(set0_pd(), error[k])), allowed));
+			}
+		}
+		store_pd(chunkErrors + chunk*DOUBLE_STRIDE, largest);
+	END_PARALLEL_FOR
+
+	return *std::max_element(chunkErrors, chunkErrors + numChunks*DOUBLE_STRIDE);
+}
+
+/**
+* @brief Sets the cloud to the 4th order interpolant of the kept step.
+*
+* @param[in] time Time within the kept step
+**/
+void DormandPrince::interpolate(const double time) {
+	const double theta = (time - stepStart)/stepSize;
+	for (cloud_index stage = 0; stage < numStages; stage++) {
+		const double * const c = denseWeights[stage];
+		weights[stage] = stepSize*theta*(c[0] + theta*(c[1] + theta*(c[2] + theta*c[3])));
+	}
+	combine(numStages, startX, startY, startVx, startVy, cloud->x, cloud->y, cloud->Vx, cloud->Vy);
+	currentTime = time;
+}
+
+/**
+* @brief Makes the slopes of the last stage, which belong to the end of the
+*        step, the slopes of the first stage of the next step.
+**/
+void DormandPrince::rotateSlopes() {
+	std::swap(accelerationX[0], accelerationX[numStages - 1]);
+	std::swap(accelerationY[0], accelerationY[numStages - 1]);
+	std::swap(velocityX[0], velocityX[numStages - 1]);
+	std::swap(velocityY[0], velocityY[numStages - 1]);
+}
+
+/**
+* @brief Prints the number of accepted and rejected steps and their lengths.
+*
+* @param[in] out Stream to print to
+**/
+void DormandPrince::printStatistics(std::ostream &out) const {
+	out << "Dormand-Prince: " << numAccepted << " accepted and " << numRejected << " rejected steps, "
+	<< numEvaluations << " force evaluations";
+	if (numAccepted)
+		out << ", steps from " << shortestStep << " to " << longestStep << " s";
+	out << "." << std::endl;
+}
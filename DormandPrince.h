@@ -0,0 +1,65 @@
+/**
+* @file  DormandPrince.h
+* @brief Defines the data and methods of the DormandPrince class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef DORMANDPRINCE_H
+#define DORMANDPRINCE_H
+
+#include "Integrator.h"
+
+class DormandPrince : public Integrator {
+public:
+	DormandPrince(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime,
+	              const double relTol, const double absTol);
+	~DormandPrince();
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	static const cloud_index numStages = 7;
+	static const double nodes[numStages];              // stage times as fractions of the step
+	static const double stageWeights[numStages][numStages - 1]; // weights of the earlier slopes of each stage
+	static const double errorWeights[numStages];       // weights of the difference of the 5th and 4th order solutions
+	static const double denseWeights[numStages][4];    // coefficients of theta^1..4 of the interpolant
+
+	const double relativeTolerance; // allowed local error relative to the size of each coordinate
+	const double absoluteTolerance; // allowed local error of coordinates near zero [m, m/s]
+	const double minimumStep;       // steps this short are accepted whatever their error [s]
+	const cloud_index numChunks;    // number of chunks of the error norm
+	double * const buffer;          // slopes of all stages and the start of the last step
+	double * const chunkErrors;     // largest scaled error of each chunk and lane
+	double *accelerationX[numStages], *accelerationY[numStages]; // velocity slopes of the stages
+	double *velocityX[numStages], *velocityY[numStages];         // position slopes of the stages
+	double * const startX, * const startY, * const startVx, * const startVy; // state at the start of the last step
+	double weights[numStages];      // weights of the slopes in combine()
+
+	double stepStart;               // start time of the last step [s]
+	double stepSize;                // length of the last step [s]
+	double trialStep;               // length of the next step [s]
+	double previousError;           // scaled error of the last accepted step
+	bool firstSlopeCurrent;         // true if stage 1 holds the slopes of the current state
+	bool interpolated;              // true if the cloud holds a state interpolated within the last step
+	bool oddSubstep;                // alternates force3 and force4 so thermal forces alternate their random numbers
+	unsigned long numReorders;      // cloud reorders the slopes belong to
+
+	unsigned long numAccepted;      // number of accepted steps
+	unsigned long numRejected;      // number of rejected steps
+	unsigned long numEvaluations;   // number of force evaluations
+	double shortestStep, longestStep; // shortest and longest accepted step [s]
+
+	void evaluate(const cloud_index stage, const double time);
+	void combine(const cloud_index numSlopes,
+	             const double * const x0, const double * const y0,
+	             const double * const Vx0, const double * const Vy0,
+	             double * const x, double * const y, double * const Vx, double * const Vy) const;
+	const double errorNorm(const double h);
+	void interpolate(const double time);
+	void rotateSlopes();
+};
+
+#endif // DORMANDPRINCE_H
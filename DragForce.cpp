@@ -49,11 +49,26 @@ void DragForce::force4(const double currentTime) {
 inline void DragForce::force(const cloud_index currentParticle, const doubleV currentVelocityX, const doubleV currentVelocityY) {
 	const doubleV drag = mul_pd(load_pd(cloud->mass + currentParticle), dragConst);
 		
-	plusEqual_pd(cloud->forceX + currentParticle, mul_pd(drag, currentVelocityX));
-	plusEqual_pd(cloud->forceY + currentParticle, mul_pd(drag, currentVelocityY));
+	plusEqual_pd(targetX + currentParticle, mul_pd(drag, currentVelocityX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(drag, currentVelocityY));
 
 }
 
+/**
+* @brief Adds the drag rate, which ExponentialVerlet solves exactly.
+*
+* @param[in]     currentTime The current time of the simulation
+* @param[in,out] drag        Drag rate [Hz]
+* @param[in,out] field       Magnetic field in the z-direction [T]
+*
+* @return True
+**/
+bool DragForce::linearVelocityTerms(const double currentTime, double &drag, double &field) const {
+	(void)currentTime; (void)field;
+	drag -= dragConst;
+	return true;
+}
+
 void DragForce::writeForce(fitsfile * const file, int * const error) const {
 	// move to primary HDU:
 	if (!*error)
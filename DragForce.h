@@ -24,6 +24,8 @@ public:
 	
 	virtual void writeForce(fitsfile * const file, int * const error) const;
 	virtual void readForce(fitsfile * const file, int * const error);
+	virtual bool velocityDependent() const { return true; }
+	virtual bool linearVelocityTerms(const double currentTime, double &drag, double &field) const;
 
 protected:
 	double dragConst; //<! The strength of the drag force (Hz)
@@ -15,28 +15,28 @@ const double DrivingForce::waveNum = 2.0*M_PI/0.002; // wavelength = 2mm
 const double DrivingForce::angFreq = 2.0*M_PI*10.0; // 10Hz
 
 void DrivingForce::force1(const double currentTime) {
-	const doubleV vtime = _mm_set1_pd(currentTime);
+	const doubleV vtime = set1_pd(currentTime);
 	BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static)
 		force(currentParticle, vtime, cloud->getx1_pd(currentParticle));
     END_PARALLEL_FOR
 }
 
 void DrivingForce::force2(const double currentTime) {
-	const doubleV vtime = _mm_set1_pd(currentTime);
+	const doubleV vtime = set1_pd(currentTime);
 	BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
 		force(currentParticle, vtime, cloud->getx2_pd(currentParticle));
     END_PARALLEL_FOR
 }
 
 void DrivingForce::force3(const double currentTime) {
-	const doubleV vtime = _mm_set1_pd(currentTime);
+	const doubleV vtime = set1_pd(currentTime);
 	BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
 		force(currentParticle, vtime, cloud->getx3_pd(currentParticle));
     END_PARALLEL_FOR
 }
 
 void DrivingForce::force4(const double currentTime) {
-	const doubleV vtime = _mm_set1_pd(currentTime);
+	const doubleV vtime = set1_pd(currentTime);
 	BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static)
 		force(currentParticle, vtime, cloud->getx4_pd(currentParticle));
     END_PARALLEL_FOR
@@ -56,7 +56,7 @@ inline void DrivingForce::force(const cloud_index currentParticle, const doubleV
 	const doubleV sinArg = sub_pd(mul_pd(currentPositionX, waveNum), mul_pd(currentTime, angFreq));
 	const doubleV expArg = div_pd(sub_pd(distV, distV), -driveConst);
 
-	plusEqual_pd(cloud->forceX + currentParticle, 
+	plusEqual_pd(targetX + currentParticle, 
                  mul_pd(mul_pd(sin_pd(sinArg), exp_pd(expArg)), amplitude)); // _mm_set_pd() is backwards
 }
 
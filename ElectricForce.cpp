@@ -56,8 +56,8 @@ inline void ElectricForce::force(const cloud_index currentParticle, const double
     const doubleV rad= set1_pd(radius * (-1));
     const doubleV eV = mul_pd(cV, exp_pd(div_pd(R,rad)));
 	
-	plusEqual_pd(cloud->forceX + currentParticle, mul_pd(eV, currentPositionX));
-	plusEqual_pd(cloud->forceY + currentParticle, mul_pd(eV, currentPositionY));
+	plusEqual_pd(targetX + currentParticle, mul_pd(eV, currentPositionX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(eV, currentPositionY));
 
 }
  
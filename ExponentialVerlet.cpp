@@ -0,0 +1,224 @@
+/**
+* @file  ExponentialVerlet.cpp
+* @class ExponentialVerlet ExponentialVerlet.h
+*
+* @brief Implementation of an exponential velocity Verlet method, which solves
+*        the drag and magnetic forces exactly and kicks the particles with the
+*        remaining forces
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "ExponentialVerlet.h"
+#include <cmath>
+
+/**
+* @brief Constructor for the ExponentialVerlet class
+*
+* @param[in] C         Cloud object
+* @param[in] FA        Array of forces
+* @param[in] timeStep  Simulation time step
+* @param[in] startTime Simulation start time
+**/
+ExponentialVerlet::ExponentialVerlet(Cloud * const C, const ForceArray &FA, const double timeStep,
+                                     const double startTime)
+: Integrator(C, FA, timeStep, startTime), accelerationsCurrent(false), oddSubstep(true), numReorders(0),
+numEvaluations(0) {
+	C->allocateSlopes(2);
+	for (Force * const F : FA) {
+		double drag = 0.0, field = 0.0;
+		(F->linearVelocityTerms(startTime, drag, field) ? linearForces : positionForces).push_back(F);
+	}
+}
+
+/**
+* @brief Multiplies two vectors of complex numbers.
+**/
+static inline void complexMul(const doubleV aRe, const doubleV aIm, const doubleV bRe, const doubleV bIm,
+                              doubleV &re, doubleV &im) {
+	re = sub_pd(mul_pd(aRe, bRe), mul_pd(aIm, bIm));
+	im = fmadd_pd(aRe, bIm, mul_pd(aIm, bRe));
+}
+
+/**
+* @brief Computes phi1(z) = (exp(z) - 1)/z and phi2(z) = (phi1(z) - 1)/z of
+*        z = zRe + i*zIm, given exp(z).
+*
+* @details Within the unit circle the quotients cancel, so phi2 is summed from
+*          its Taylor series z^k/(k + 2)! instead, which has converged to double
+*          precision after 17 terms, and phi1 = 1 + z*phi2.
+**/
+static inline void phi(const doubleV zRe, const doubleV zIm, const doubleV expRe, const doubleV expIm,
+                       doubleV &phi1Re, doubleV &phi1Im, doubleV &phi2Re, doubleV &phi2Im) {
+	const doubleV one = set1_pd(1.0);
+	const doubleV normZ = fmadd_pd(zRe, zRe, mul_pd(zIm, zIm));
+	const doubleV small = cmplt_pd(normZ, 1.0);
+
+	// 1/z = conj(z)/|z|^2, kept finite in the lanes that use the series.
+	const doubleV invNorm = div_pd(one, max_pd(normZ, one));
+	const doubleV invRe = mul_pd(zRe, invNorm);
+	const doubleV invIm = sub_pd(set0_pd(), mul_pd(zIm, invNorm));
+	doubleV quotient1Re, quotient1Im, quotient2Re, quotient2Im;
+	complexMul(sub_pd(expRe, 1.0), expIm, invRe, invIm, quotient1Re, quotient1Im);
+	complexMul(sub_pd(quotient1Re, 1.0), quotient1Im, invRe, invIm, quotient2Re, quotient2Im);
+
+	double factorial = 1.0;
+	for (cloud_index k = 2; k <= 18; k++)
+		factorial *= (double)k;
+	doubleV seriesRe = set1_pd(1.0/factorial), seriesIm = set0_pd();
+	for (cloud_index k = 18; k > 2; k--) {
+		factorial /= (double)k;
+		complexMul(seriesRe, seriesIm, zRe, zIm, seriesRe, seriesIm);
+		seriesRe = add_pd(seriesRe, set1_pd(1.0/factorial));
+	}
+	doubleV series1Re, series1Im;
+	complexMul(seriesRe, seriesIm, zRe, zIm, series1Re, series1Im);
+	series1Re = add_pd(series1Re, one);
+
+	phi1Re = blendv_pd(quotient1Re, series1Re, small);
+	phi1Im = blendv_pd(quotient1Im, series1Im, small);
+	phi2Re = blendv_pd(quotient2Re, seriesRe, small);
+	phi2Im = blendv_pd(quotient2Im, seriesIm, small);
+}
+
+/**
+* @brief Moves particles forward with exponential velocity Verlet steps.
+*
+* @details With w = Vx + i*Vy, the drag and magnetic forces give
+*          dw/dt = lambda*w + a with lambda = -gamma - i*q*B/m and a the
+*          acceleration of the other forces. Taking a constant over the step
+*          for the positions, and linear between its values at both ends for
+*          the velocities, integrates this exactly:
+*          x(h) = x + h*phi1(z)*w + h^2*phi2(z)*a(0),
+*          w(h) = exp(z)*w + h*phi1(z)*a(0) + h*phi2(z)*(a(h) - a(0)),
+*          with z = lambda*h. This is velocity Verlet for gamma = B = 0 and
+*          second order in the other forces, while the step stays stable for
+*          any gamma*h and q*B*h/m. Drag and field are taken at the middle of
+*          the step.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void ExponentialVerlet::moveParticles(const double endTime) {
+	while (currentTime < endTime) {
+		const double dt = modifyTimeStep(1.0e-4f, init_dt); // implement dynamic timstep (if necessary):
+
+		// Reordering the cloud moves the particles out from under their
+		// accelerations.
+		if (!accelerationsCurrent || numReorders != cloud->numReorders) {
+			evaluate(currentTime);
+			numReorders = cloud->numReorders;
+			accelerationsCurrent = true;
+		}
+
+		double drag = 0.0, field = 0.0;
+		for (Force * const F : linearForces)
+			F->linearVelocityTerms(currentTime + 0.5*dt, drag, field);
+
+		drift(dt, drag, field);
+		evaluateForces(positionForces, currentTime + dt, oddSubstep);
+		++numEvaluations;
+		kick();
+
+		currentTime += dt;
+	}
+}
+
+/**
+* @brief Computes the accelerations of the position forces, keeping them in k1
+*        and m1.
+*
+* @param[in] time Time of the positions
+**/
+void ExponentialVerlet::evaluate(const double time) {
+	evaluateForces(positionForces, time, oddSubstep);
+	++numEvaluations;
+
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		store_pd(cloud->k1 + i, div_pd(load_pd(pFx), vmass));
+		store_pd(cloud->m1 + i, div_pd(load_pd(pFy), vmass));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Moves the particles over h and advances the velocities by the exact
+*        drag and magnetic rotation plus the accelerations at the start of the
+*        step. Keeps h*phi2(z) in k2 and m2 for kick().
+*
+* @param[in] h     Timestep
+* @param[in] drag  Drag rate [Hz]
+* @param[in] field Magnetic field in the z-direction [T]
+**/
+void ExponentialVerlet::drift(const double h, const double drag, const double field) const {
+	const doubleV vh = set1_pd(h), zRe = set1_pd(-drag*h), decay = set1_pd(exp(-drag*h));
+	const double fieldh = field*h;
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV rotation = div_pd(mul_pd(load_pd(cloud->charge + i), fieldh), load_pd(cloud->mass + i));
+		doubleV sinRotation, cosRotation;
+		sincos_pd(rotation, sinRotation, cosRotation);
+		const doubleV zIm = sub_pd(set0_pd(), rotation);
+		const doubleV expRe = mul_pd(decay, cosRotation);
+		const doubleV expIm = sub_pd(set0_pd(), mul_pd(decay, sinRotation));
+		doubleV phi1Re, phi1Im, phi2Re, phi2Im;
+		phi(zRe, zIm, expRe, expIm, phi1Re, phi1Im, phi2Re, phi2Im);
+
+		const doubleV vx = load_pd(cloud->Vx + i), vy = load_pd(cloud->Vy + i);
+		const doubleV ax = load_pd(cloud->k1 + i), ay = load_pd(cloud->m1 + i);
+		doubleV phi1VRe, phi1VIm, phi1ARe, phi1AIm, phi2ARe, phi2AIm, expVRe, expVIm;
+		complexMul(phi1Re, phi1Im, vx, vy, phi1VRe, phi1VIm);
+		complexMul(phi1Re, phi1Im, ax, ay, phi1ARe, phi1AIm);
+		complexMul(phi2Re, phi2Im, ax, ay, phi2ARe, phi2AIm);
+		complexMul(expRe, expIm, vx, vy, expVRe, expVIm);
+
+		plusEqual_pd(cloud->x + i, mul_pd(vh, fmadd_pd(vh, phi2ARe, phi1VRe)));
+		plusEqual_pd(cloud->y + i, mul_pd(vh, fmadd_pd(vh, phi2AIm, phi1VIm)));
+		store_pd(cloud->Vx + i, fmadd_pd(vh, phi1ARe, expVRe));
+		store_pd(cloud->Vy + i, fmadd_pd(vh, phi1AIm, expVIm));
+		store_pd(cloud->k2 + i, mul_pd(vh, phi2Re));
+		store_pd(cloud->m2 + i, mul_pd(vh, phi2Im));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Corrects the velocities by h*phi2(z) times the change of the
+*        accelerations over the step, then keeps the new accelerations in k1
+*        and m1.
+**/
+void ExponentialVerlet::kick() const {
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		const doubleV ax = div_pd(load_pd(pFx), vmass);
+		const doubleV ay = div_pd(load_pd(pFy), vmass);
+		doubleV dVx, dVy;
+		complexMul(load_pd(cloud->k2 + i), load_pd(cloud->m2 + i),
+		           sub_pd(ax, load_pd(cloud->k1 + i)), sub_pd(ay, load_pd(cloud->m1 + i)), dVx, dVy);
+		plusEqual_pd(cloud->Vx + i, dVx);
+		plusEqual_pd(cloud->Vy + i, dVy);
+		store_pd(cloud->k1 + i, ax);
+		store_pd(cloud->m1 + i, ay);
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Prints the number of position force evaluations.
+*
+* @param[in] out Stream to print to
+**/
+void ExponentialVerlet::printStatistics(std::ostream &out) const {
+	Integrator::printStatistics(out);
+	out << "Exponential Verlet: " << numEvaluations << " position force evaluations, "
+	<< linearForces.size() << " forces solved exactly." << std::endl;
+}
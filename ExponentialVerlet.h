@@ -0,0 +1,35 @@
+/**
+* @file  ExponentialVerlet.h
+* @brief Defines the data and methods of the ExponentialVerlet class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef EXPONENTIALVERLET_H
+#define EXPONENTIALVERLET_H
+
+#include "Integrator.h"
+
+class ExponentialVerlet : public Integrator {
+public:
+	ExponentialVerlet(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime);
+	~ExponentialVerlet() {}
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	ForceArray positionForces;      // forces integrated with velocity Verlet kicks
+	ForceArray linearForces;        // drag and magnetic forces, which are solved exactly
+	bool accelerationsCurrent;      // true if k1/m1 belong to the current state
+	bool oddSubstep;                // alternates force1 and force2 so thermal forces alternate their random numbers
+	unsigned long numReorders;      // cloud reorders the accelerations belong to
+	unsigned long numEvaluations;   // number of position force evaluations
+
+	void evaluate(const double time);
+	void drift(const double h, const double drag, const double field) const;
+	void kick() const;
+};
+
+#endif // EXPONENTIALVERLET_H
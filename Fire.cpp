@@ -0,0 +1,194 @@
+/**
+* @file  Fire.cpp
+* @class Fire Fire.h
+*
+* @brief Implementation of the fast inertial relaxation engine (FIRE), which
+*        relaxes the cloud to a minimum of its potential energy
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "Fire.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const cloud_index Fire::delaySteps = 5;
+const double Fire::stepIncrease = 1.1;
+const double Fire::stepDecrease = 0.5;
+const double Fire::mixingStart = 0.1;
+const double Fire::mixingDecrease = 0.99;
+
+/**
+* @brief Constructor for the Fire class
+*
+* @details Only the forces that do not depend on the velocities are relaxed,
+*          so drag and magnetic forces are left out.
+*
+* @param[in] C              Cloud object
+* @param[in] FA             Array of forces
+* @param[in] timeStep       Initial step, which grows to 10 times its length
+* @param[in] startTime      Time at which the forces are evaluated
+* @param[in] forceTolerance Largest force on any particle of a relaxed cloud [N]
+* @param[in] iterationLimit Iterations after which the relaxation gives up
+**/
+Fire::Fire(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime,
+           const double forceTolerance, const cloud_index iterationLimit)
+: Integrator(C, FA, timeStep, startTime), tolerance(forceTolerance), maxIterations(iterationLimit),
+relaxed(false), oddSubstep(true), numIterations(0), numRestarts(0), largestForce(0.0) {
+	for (Force * const F : FA)
+		if (!F->velocityDependent())
+			positionForces.push_back(F);
+}
+
+/**
+* @brief Relaxes the cloud once and stops the clock at endTime.
+*
+* @details The relaxation runs in a fictitious time of its own, so the relaxed
+*          state is that of the start time, and later calls keep it.
+*
+* @param[in] endTime Time the relaxed state is written for
+**/
+void Fire::moveParticles(const double endTime) {
+	if (!relaxed)
+		relax();
+	currentTime = endTime;
+}
+
+/**
+* @brief Moves the particles downhill until the largest force on any of them
+*        is below the tolerance, or the iterations run out, then stops them.
+*
+* @details Each iteration is a semi-implicit Euler step, whose velocities are
+*          turned toward the forces by mixing in a fraction of the forces
+*          scaled to the speed. While the power F.v stays positive, the step
+*          grows up to 10 times the initial step and the mixing fades. Once it
+*          turns negative, the particles step back half a step and stop, the
+*          step halves down to a fiftieth of the initial step and the mixing
+*          restarts. The first steps do not shrink the step. This is FIRE 2.0
+*          of Guenole et al. (2020), after Bitzek et al. (2006).
+**/
+void Fire::relax() {
+	const double maxStep = 10.0*init_dt, minStep = 0.02*init_dt;
+	double h = init_dt, mixing = mixingStart;
+	cloud_index numDownhill = 0;
+	for (numIterations = 0; numIterations < (unsigned long)maxIterations; numIterations++) {
+		evaluateForces(positionForces, currentTime, oddSubstep);
+		double power, speed2, force2, maxForce2;
+		measure(power, speed2, force2, maxForce2);
+		largestForce = std::sqrt(maxForce2);
+		if (largestForce < tolerance)
+			break;
+
+		if (power > 0.0) {
+			if (++numDownhill > delaySteps) {
+				h = std::min(stepIncrease*h, maxStep);
+				mixing *= mixingDecrease;
+			}
+			step(h, 0.0, 1.0 - mixing, mixing*std::sqrt(speed2/force2));
+		} else {
+			numDownhill = 0;
+			++numRestarts;
+			if (numIterations >= delaySteps) {
+				h = std::max(stepDecrease*h, minStep);
+				mixing = mixingStart;
+			}
+			step(h, -0.5*h, 0.0, 0.0);
+		}
+	}
+
+	// reset forces to zero:
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		store_pd(cloud->forceX + i, set0_pd());
+		store_pd(cloud->forceY + i, set0_pd());
+		store_pd(cloud->Vx + i, set0_pd());
+		store_pd(cloud->Vy + i, set0_pd());
+	END_PARALLEL_FOR
+	relaxed = true;
+}
+
+/**
+* @brief Sums the power F.v, the squared speed and force of the whole cloud,
+*        and finds the largest squared force on a particle.
+*
+* @details Each thread reduces its chunk of particles, and the chunks are
+*          combined at the end, so no locks are needed.
+*
+* @param[out] power     Sum of F.v over the particles [W]
+* @param[out] speed2    Sum of the squared speeds [m^2/s^2]
+* @param[out] force2    Sum of the squared forces [N^2]
+* @param[out] maxForce2 Largest squared force on a particle [N^2]
+**/
+void Fire::measure(double &power, double &speed2, double &force2, double &maxForce2) const {
+	const cloud_index numChunks = (cloud_index)NUM_THREADS;
+	const cloud_index chunkSize = (cloud->n/DOUBLE_STRIDE + numChunks - 1)/numChunks*DOUBLE_STRIDE;
+	std::vector<double> chunkSums(4*numChunks);
+	double * const sums = chunkSums.data();
+	BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+		doubleV vpower = set0_pd(), vspeed2 = set0_pd(), vforce2 = set0_pd(), vmaxForce2 = set0_pd();
+		for (cloud_index i = chunk*chunkSize, end = std::min(cloud->n, i + chunkSize); i < end; i += DOUBLE_STRIDE) {
+			const doubleV vx = load_pd(cloud->Vx + i), vy = load_pd(cloud->Vy + i);
+			const doubleV fx = load_pd(cloud->forceX + i), fy = load_pd(cloud->forceY + i);
+			const doubleV f2 = fmadd_pd(fx, fx, mul_pd(fy, fy));
+			vpower = add_pd(vpower, fmadd_pd(fx, vx, mul_pd(fy, vy)));
+			vspeed2 = add_pd(vspeed2, fmadd_pd(vx, vx, mul_pd(vy, vy)));
+			vforce2 = add_pd(vforce2, f2);
+			vmaxForce2 = max_pd(vmaxForce2, f2);
+		}
+		sums[4*chunk] = sum_pd(vpower);
+		sums[4*chunk + 1] = sum_pd(vspeed2);
+		sums[4*chunk + 2] = sum_pd(vforce2);
+		sums[4*chunk + 3] = max_pd(vmaxForce2);
+	END_PARALLEL_FOR
+
+	power = speed2 = force2 = maxForce2 = 0.0;
+	for (cloud_index chunk = 0; chunk < numChunks; chunk++) {
+		power += sums[4*chunk];
+		speed2 += sums[4*chunk + 1];
+		force2 += sums[4*chunk + 2];
+		maxForce2 = std::max(maxForce2, sums[4*chunk + 3]);
+	}
+}
+
+/**
+* @brief Mixes the velocities with the forces, kicks them by the forces over h
+*        and moves the particles with the new velocities, then resets the
+*        forces.
+*
+* @param[in] h              Length of the step
+* @param[in] backstep       Time to move the particles with their old velocities first
+* @param[in] velocityFactor Fraction of the old velocities kept
+* @param[in] forceFactor    Velocity added per unit force [m/(N s)]
+**/
+void Fire::step(const double h, const double backstep, const double velocityFactor, const double forceFactor) const {
+	const doubleV vh = set1_pd(h), vbackstep = set1_pd(backstep);
+	const doubleV vvelocityFactor = set1_pd(velocityFactor), vforceFactor = set1_pd(forceFactor);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		const doubleV fx = load_pd(pFx), fy = load_pd(pFy);
+		const doubleV vx = load_pd(cloud->Vx + i), vy = load_pd(cloud->Vy + i);
+		const doubleV newVx = fmadd_pd(vh, div_pd(fx, vmass), fmadd_pd(vforceFactor, fx, mul_pd(vvelocityFactor, vx)));
+		const doubleV newVy = fmadd_pd(vh, div_pd(fy, vmass), fmadd_pd(vforceFactor, fy, mul_pd(vvelocityFactor, vy)));
+		store_pd(cloud->Vx + i, newVx);
+		store_pd(cloud->Vy + i, newVy);
+		plusEqual_pd(cloud->x + i, fmadd_pd(vbackstep, vx, mul_pd(vh, newVx)));
+		plusEqual_pd(cloud->y + i, fmadd_pd(vbackstep, vy, mul_pd(vh, newVy)));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Prints the iterations, restarts and the largest remaining force.
+*
+* @param[in] out Stream to print to
+**/
+void Fire::printStatistics(std::ostream &out) const {
+	out << "FIRE: " << numIterations << " iterations, " << numRestarts << " restarts, largest force "
+	<< largestForce << " N" << (largestForce < tolerance ? "." : ", not relaxed to the tolerance.") << std::endl;
+}
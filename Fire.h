@@ -0,0 +1,44 @@
+/**
+* @file  Fire.h
+* @brief Defines the data and methods of the Fire class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef FIRE_H
+#define FIRE_H
+
+#include "Integrator.h"
+
+class Fire : public Integrator {
+public:
+	Fire(Cloud * const C, const ForceArray &FA, const double timeStep, const double startTime,
+	     const double forceTolerance, const cloud_index iterationLimit);
+	~Fire() {}
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	static const cloud_index delaySteps; // uphill free steps before the step may grow
+	static const double stepIncrease;    // factor of the step after each further downhill step
+	static const double stepDecrease;    // factor of the step after an uphill step
+	static const double mixingStart;     // mixing of the velocities with the forces after an uphill step
+	static const double mixingDecrease;  // factor of the mixing after each further downhill step
+
+	ForceArray positionForces;      // forces that only depend on the positions and time
+	const double tolerance;         // largest force on any particle of a relaxed cloud [N]
+	const cloud_index maxIterations; // iterations after which the relaxation gives up
+	bool relaxed;                   // true once the relaxation ran
+	bool oddSubstep;                // alternates force1 and force2 of the forces
+	unsigned long numIterations;    // number of iterations, one force evaluation each
+	unsigned long numRestarts;      // number of uphill steps, which stop the particles
+	double largestForce;            // largest force on any particle at the end [N]
+
+	void relax();
+	void measure(double &power, double &speed2, double &force2, double &maxForce2) const;
+	void step(const double h, const double backstep, const double velocityFactor, const double forceFactor) const;
+};
+
+#endif // FIRE_H
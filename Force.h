@@ -10,17 +10,20 @@
 #define FORCE_H
 
 #include "Cloud.h"
+#include <ostream>
 #include <vector>
 
 class Force {
 public:
 	Cloud * const cloud; //!< Cloud object
+	double *targetX;     //!< Array the x-forces are added to, the cloud forces unless an integrator gives the force a buffer
+	double *targetY;     //!< Array the y-forces are added to
 	
 	/**
 	* @brief Constructor method
 	* @param[in] C Cloud object
 	**/
-	Force(Cloud * const C) : cloud(C) {} 
+	Force(Cloud * const C) : cloud(C), targetX(C->forceX), targetY(C->forceY) {} 
 
 	/**
 	* @brief Destructor method
@@ -66,6 +69,53 @@ public:
 	* @param[in,out] error Error status code
 	**/
 	virtual void readForce(fitsfile * const file, int * const error)=0;	// read force information from file
+
+	/**
+	* @brief Prints performance statistics gathered during the run, if any
+	*
+	* @param[in] out Stream to print to
+	**/
+	virtual void printStatistics(std::ostream &out) const { (void)out; }
+
+	/**
+	* @brief Tells integrators that treat velocity dependent forces apart, like
+	*        VelocityVerlet, whether this force depends on the velocities
+	*
+	* @return True if the force depends on the particle velocities
+	**/
+	virtual bool velocityDependent() const { return false; }
+
+	/**
+	* @brief Adds the drag rate and magnetic field of this force to those of the
+	*        acceleration -drag*v + (q*field/m)*(v x z), which integrators like
+	*        ExponentialVerlet solve exactly
+	*
+	* @param[in]     currentTime The current time of the simulation
+	* @param[in,out] drag        Drag rate [Hz]
+	* @param[in,out] field       Magnetic field in the z-direction [T]
+	*
+	* @return True if the force is made up of these terms
+	**/
+	virtual bool linearVelocityTerms(const double currentTime, double &drag, double &field) const {
+		(void)currentTime; (void)drag; (void)field;
+		return false;
+	}
+
+	/**
+	* @brief Adds the force on the given particles only, at the positions and
+	*        velocities of the cloud, for integrators with per-particle
+	*        timesteps like BlockTimestep
+	*
+	* @param[in] currentTime The current time of the simulation
+	* @param[in] active      Indices of the particles
+	* @param[in] numActive   Number of particles
+	*
+	* @return False if the force only computes every particle, with force1()
+	**/
+	virtual bool activeForce(const double currentTime, const cloud_index * const active, const cloud_index numActive) {
+		(void)currentTime; (void)active; (void)numActive;
+		return false;
+	}
 };
 	
 typedef std::vector<Force *> ForceArray; //!< Vector of Force objects
@@ -73,21 +123,22 @@ typedef long force_flags;				 //!< Force flag for  bit-packed FORCES keyword in
 
 //!< Binary assignments for the bit-packed FORCES keyword in Fits file:
 enum ForceFlag : force_flags {
-	ConfinementForceFlag = 1,          // 000000000000001
-	DragForceFlag = 2,                 // 000000000000010
-	ShieldedCoulombForceFlag = 4,      // 000000000000100
-	GravitationalForceFlag = 8,        // 000000000001000
-	ThermalForceFlag = 16,             // 000000000010000
-	ThermalForceLocalizedFlag = 32,    // 000000000100000
-	DrivingForceFlag = 64,             // 000000001000000
-	RotationalForceFlag = 128,         // 000000010000000
-	TimeVaryingDragForceFlag = 256,    // 000000100000000
-	TimeVaryingThermalForceFlag = 512, // 000001000000000
-	MagneticForceFlag = 1024,          // 000010000000000
-	ConfinementForceVoidFlag = 2048,   // 000100000000000
-    ElectricForceFlag = 4096,          // 001000000000000
-	RectConfinementForceFlag = 8192,   // 010000000000000
-	VertElectricForceFlag = 16384      // 100000000000000
+	ConfinementForceFlag = 1,          // 0000000000000001
+	DragForceFlag = 2,                 // 0000000000000010
+	ShieldedCoulombForceFlag = 4,      // 0000000000000100
+	GravitationalForceFlag = 8,        // 0000000000001000
+	ThermalForceFlag = 16,             // 0000000000010000
+	ThermalForceLocalizedFlag = 32,    // 0000000000100000
+	DrivingForceFlag = 64,             // 0000000001000000
+	RotationalForceFlag = 128,         // 0000000010000000
+	TimeVaryingDragForceFlag = 256,    // 0000000100000000
+	TimeVaryingThermalForceFlag = 512, // 0000001000000000
+	MagneticForceFlag = 1024,          // 0000010000000000
+	ConfinementForceVoidFlag = 2048,   // 0000100000000000
+    ElectricForceFlag = 4096,          // 0001000000000000
+	RectConfinementForceFlag = 8192,   // 0010000000000000
+	VertElectricForceFlag = 16384,     // 0100000000000000
+	TreeCoulombForceFlag = 32768       // 1000000000000000
 };
 
 #endif // FORCE_H
@@ -46,7 +46,7 @@ void GravitationalForce::force4(const double currentTime) {
 inline void GravitationalForce::force(const cloud_index currentParticle) {
 	const doubleV gravity = mul_pd(load_pd(cloud->mass + currentParticle), gravitational);
 
-	plusEqual_pd(cloud->forceY + currentParticle, gravity);
+	plusEqual_pd(targetY + currentParticle, gravity);
 }
 
 void GravitationalForce::writeForce(fitsfile * const file, int * const error) const {
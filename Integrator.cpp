@@ -9,17 +9,10 @@
 **/
 
 #include "Integrator.h"
-#include "CacheOperator.h"
+#include <algorithm>
 #include <cmath>
 #include <limits>
-
-#ifdef DISPATCH_QUEUES
-#define BLOCK_VALUE_TIME currTimeStep    //!< ??UNKNOWN??
-#define BLOCK_VALUE_DIST currDist        //!< ??UNKNOWN??
-#else
-#define BLOCK_VALUE_TIME currentTimeStep //!< ??UNKNOWN??
-#define BLOCK_VALUE_DIST currentDist     //!< ??UNKNOWN??
-#endif
+#include <vector>
 
 /**
 * @brief Constructor for the Integrator class
@@ -32,19 +25,15 @@
 Integrator::Integrator(Cloud * const C, const ForceArray &FA,
                        const double timeStep, double startTime)
 : currentTime(startTime), cloud(C), forces(FA), init_dt(timeStep),
-operations({{new CacheOperator(C)}})
-SEMAPHORES_MALLOC(1) {
-    SEMAPHORES_INIT(1);
-}
+cells(C->n), numChecks(0), numReductions(0),
+closestSeparation(std::numeric_limits<float>::max()), separationMinima(NUM_THREADS) {}
 
 /**
 * @brief Destructor for the Integrator class
 **/
 Integrator::~Integrator() {
-	for (Operator * const opt : operations)
-		delete opt;
-    
-    SEMAPHORES_FREE(1);
+	for (const std::pair<const Force * const, double *> &partial : partialForces)
+		alignedDelete(partial.second);
 }
 
 /**
@@ -53,130 +42,181 @@ Integrator::~Integrator() {
 * @details If particle spacing is less than the specified distance reduce timestep by a
 * 		   factor of 10 and recheck with disance reduced by a factor of 10. Once all
 *          particle spacings are outside the specified distance use the current 
-*          timestep. This allows fine grain control of reduced timesteps
+*          timestep. This allows fine grain control of reduced timesteps. Only 
+*          the smallest separation decides this, so it is found once with a 
+*          cell list instead of checking every pair. Every thread of a parallel
+*          region gets the same timestep.
 *
 * @param[in] currentDist     The current distance..?
 * @param[in] currentTImeStep The current simulation timestep
 *
 * @return The new timestep
-*
-* @bug When changing this over to AVX to simplify, change force methods to
-* 	   triangle and block forces. Triangle forces cover the outter loop force. Block
-*	   covers the inner loop forces. AVX specific differences would go into that 
-*	   section.
 **/
 const double Integrator::modifyTimeStep(float currentDist, double currentTimeStep) const {
-	#ifdef __AVX__
-	#error "Integrator::modifyTimeStep does not fully support AVX."
-	#endif
-		const cloud_index numParticles = cloud->n;
-	    
-	#ifdef DISPATCH_QUEUES
-	    // You cannot block capture method arguments. Store these values in to non
-	    // const block captured variables. The correct names subsequently used by
-	    // BLOCK_VALUE_DIST and BLOCK_VALUE_TIME
-	    __block float currDist = currentDist;
-	    __block double currTimeStep = currentTimeStep;
-	#endif
-	    
-		// Loop through entire cloud, or until reduction occurs. Reset innerIndex 
-	    // after each loop iteration.
-	#ifdef DISPATCH_QUEUES
-		const cloud_index outerLoop = numParticles;
-	#else
-		const cloud_index outerLoop = numParticles - 1;
-	#endif
+	const float separation = minimumSeparation(currentDist);
+	BEGIN_SERIAL
+		++numChecks;
+		if (separation <= currentDist) {
+			++numReductions;
+			closestSeparation = std::min(closestSeparation, separation);
+		}
+	END_SERIAL
+
+	// The distance drops faster than any positive separation, so this ends 
+	// unless two particles are on top of each other.
+	while (separation <= currentDist) {
+		currentDist /= 10.0f;
+		currentTimeStep /= 10.0f;
+	}
+	return currentTimeStep;
+}
+
+/**
+* @brief Finds the smallest separation of any two particles if it is within
+*        range.
+*
+* @details The particles are sorted into cells at least range wide, so all 
+*          pairs within range are in neighboring cells, and each particle is 
+*          compared with the particles of the 3x3 cells around it that come 
+*          after it. Each thread keeps the minimum of its chunk of particles,
+*          and the minima of the chunks are compared at the end, so no locks 
+*          are needed. Positions are rounded to float before subtracting, like
+*          the pair scan this replaces. The minima are members, so the
+*          threads of a parallel region share them.
+*
+* @param[in] range Largest separation that has to be found (m)
+*
+* @return The smallest separation, or a larger value if no pair is within range
+**/
+float Integrator::minimumSeparation(const float range) const {
+	const cloud_index numParticles = cloud->n;
+	cells.build(cloud->x, cloud->y, (double)range);
 
-    BEGIN_PARALLEL_FOR(outerIndex, e, outerLoop, FLOAT_STRIDE, dynamic)
-		// calculate separation distance b/t adjacent elements:
-		const floatV outPosX = loadFloatVector(cloud->x + outerIndex);
-		const floatV outPosY = loadFloatVector(cloud->y + outerIndex);
-	
-        // seperation (a1 - a2, a3 - a4, a1 - a3, a2 - a4)
-        floatV sepx = _mm_hsub_ps(outPosX, _mm_shuffle_ps(outPosX, outPosX, _MM_SHUFFLE(1, 2, 0, 3)));
-        floatV sepy = _mm_hsub_ps(outPosY, _mm_shuffle_ps(outPosY, outPosY, _MM_SHUFFLE(1, 2, 0, 3)));
-        tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
-		
-        // seperation (a1 - a2, a3 - a4, a1 - a4, a2 - a3) The lower half 
-        // operation is a repeat of the lower half of the above.
-        sepx = _mm_hsub_ps(outPosX, _mm_shuffle_ps(outPosX, outPosX, _MM_SHUFFLE(1, 3, 0, 2)));
-        sepy = _mm_hsub_ps(outPosY, _mm_shuffle_ps(outPosY, outPosY, _MM_SHUFFLE(1, 3, 0, 2)));
-		tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
-        
-		// Calculate separation distance b/t nonadjacent elements:
-		for (cloud_index innerIndex = outerIndex + FLOAT_STRIDE; innerIndex < numParticles; innerIndex += FLOAT_STRIDE) {
-			const floatV inPosX = loadFloatVector(cloud->x + innerIndex);
-			const floatV inPosY = loadFloatVector(cloud->y + innerIndex);
-			
-            // seperation (a1 - b1, a2 - b2, a3 - b3, a4 - b4) 
-			sepx = outPosX - inPosX;
-			sepy = outPosY - inPosY;
-			tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
-			
-            // seperation (a1 - b2, a2 - b3, a3 - b4, a4 - b5)
-			sepx = outPosX - _mm_shuffle_ps(inPosX, inPosX, _MM_SHUFFLE(3, 2, 1, 0));
-			sepy = outPosY - _mm_shuffle_ps(inPosY, inPosY, _MM_SHUFFLE(3, 2, 1, 0));
-			tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
-			
-            // seperation (a1 - b3, a2 - b4, a3 - b1, a4 - b2)
-			sepx = outPosX - _mm_shuffle_ps(inPosX, inPosX, _MM_SHUFFLE(0, 3, 2, 1));
-			sepy = outPosY - _mm_shuffle_ps(inPosY, inPosY, _MM_SHUFFLE(0, 3, 2, 1));
-			tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
-			
-            // seperation (a1 - b4, a2 - b1, a3 - b2, a4 - b3)
-			sepx = outPosX - _mm_shuffle_ps(inPosX, inPosX, _MM_SHUFFLE(1, 0, 3, 2));
-			sepy = outPosY - _mm_shuffle_ps(inPosY, inPosY, _MM_SHUFFLE(1, 0, 3, 2));
-			tryToReduceTimeStep(sepx, sepy, BLOCK_VALUE_DIST, BLOCK_VALUE_TIME);
+	const cloud_index numChunks = (cloud_index)separationMinima.size();
+	const cloud_index chunkSize = (numParticles + numChunks - 1)/numChunks;
+	float * const minima = separationMinima.data();
+	const CellList * const grid = &cells;
+	BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+		float nearest2 = std::numeric_limits<float>::max();
+		for (cloud_index p = chunk*chunkSize, end = std::min(numParticles, p + chunkSize); p < end; p++) {
+			const cloud_index cx = grid->particleCell[p]%grid->numCellsX;
+			const cloud_index cy = grid->particleCell[p]/grid->numCellsX;
+			const float x1 = (float)grid->sortedX[p], y1 = (float)grid->sortedY[p];
+			for (cloud_index row = cy ? cy - 1 : 0; row <= cy + 1 && row < grid->numCellsY; row++)
+				for (cloud_index q = std::max(grid->rowBegin(cx, row), p + 1), last = grid->rowEnd(cx, row); q < last; q++) {
+					const float dx = x1 - (float)grid->sortedX[q];
+					const float dy = y1 - (float)grid->sortedY[q];
+					nearest2 = std::min(nearest2, dx*dx + dy*dy);
+				}
 		}
+		minima[chunk] = nearest2;
 	END_PARALLEL_FOR
 
-    return BLOCK_VALUE_TIME;
+	return std::sqrt(*std::min_element(minima, minima + numChunks));
 }
 
 /**
-* @brief Reduces timestep if particles are within distance
+* @brief Computes the forces at the positions and velocities of the cloud for
+*        integrators that evaluate every force the same way in each step.
+*
+* @details The calls alternate between substeps 1 and 2. The thermal forces 
+*          use the random numbers drawn by the previous substep and draw new 
+*          ones for the next, so a single substep would repeat the same random 
+*          force forever. Substep 2 reads the caches, so the state is copied 
+*          into them first unless they are the state. Inside a parallel region
+*          every thread calls this with the same parity, and one flips it.
 *
-* @param[in]     sepX      Particle separation in x-direction
-* @param[in]     sepY 	   Particle separation in y-direction
-* @param[in,out] distance  Distance to check if less than
-* @param[in,out] time      Current simulation timestep
+* @param[in]     level      Forces to evaluate
+* @param[in]     time       Current time
+* @param[in,out] oddSubstep True for substep 1, flipped for the next call
 **/
-inline void Integrator::tryToReduceTimeStep(const floatV sepx, const floatV sepy, float &distance, double &time) const {
-	// If particles are too close, reduce time step:
-	while (isWithInDistance(sepx, sepy, distance)) {
-		// Only one thread should modify the distance and timesStep at a time.
-		SEMAPHORE_WAIT(0)
-		if (isWithInDistance(sepx, sepy, distance)) {
-			distance /= 10.0f;
-			time /= 10.0f;
+void Integrator::evaluateForces(const ForceArray &level, const double time, bool &oddSubstep) const {
+	if (oddSubstep)
+		runForces(level, &Force::force1, time);
+	else {
+		if ((double *)cloud->xCache != cloud->x) {
+			BEGIN_PARALLEL_FOR(i, e, cloud->n/DOUBLE_STRIDE, 1, static)
+				const cloud_index offset = DOUBLE_STRIDE*i;
+				cloud->xCache[i] = load_pd(cloud->x + offset);
+				cloud->yCache[i] = load_pd(cloud->y + offset);
+				cloud->VxCache[i] = load_pd(cloud->Vx + offset);
+				cloud->VyCache[i] = load_pd(cloud->Vy + offset);
+			END_PARALLEL_FOR
 		}
-		SEMAPHORE_SIGNAL(0)
+		runForces(level, &Force::force2, time);
 	}
+	BEGIN_SERIAL
+		oddSubstep = !oddSubstep;
+	END_SERIAL
 }
 
 /**
-* @brief Loads a float vector with particle locations
+* @brief Computes the forces of a level at one substep.
+*
+* @details With a thread pool, all forces but the first run as tasks, each
+*          into a buffer of its own, while the calling thread computes the
+*          first force straight into the cloud forces. The buffers are then
+*          added in the order of the forces, so the sum does not depend on
+*          which force finished first. Otherwise the forces run one after
+*          another.
 *
-* @param[in] x Particle location
+* @param[in] level   Forces to compute
+* @param[in] substep Substep of the forces, like Force::force1
+* @param[in] time    Time of the substep
 **/
-inline floatV Integrator::loadFloatVector(double * const x) {
-#ifdef __AVX__
-    return _mm256_set_ps((float)x[0], (float)x[1], (float)x[2], (float)x[3],
-                         (float)x[4], (float)x[5], (float)x[6], (float)x[7]);
-#else
-    return _mm_set_ps((float)x[0], (float)x[1], (float)x[2], (float)x[3]);
+void Integrator::runForces(const ForceArray &level, void (Force::*substep)(const double), const double time) const {
+#ifdef THREAD_POOL
+	if (level.size() > 1 && NUM_THREADS > 1) {
+		const cloud_index numParticles = cloud->n;
+		std::vector<double *> buffers;
+		TaskGroup group;
+		for (ForceArray::size_type k = 1; k < level.size(); k++) {
+			Force * const F = level[k];
+			double *&buffer = partialForces[F];
+			if (!buffer) {
+				buffer = alignedNew<double>(2*numParticles);
+				std::fill(buffer, buffer + 2*numParticles, 0.0);
+			}
+			F->targetX = buffer;
+			F->targetY = buffer + numParticles;
+			buffers.push_back(buffer);
+			group.run([F, substep, time]() { (F->*substep)(time); });
+		}
+		(level[0]->*substep)(time);
+		group.wait();
+
+		for (Force * const F : level) {
+			F->targetX = cloud->forceX;
+			F->targetY = cloud->forceY;
+		}
+		const cloud_index numBuffers = (cloud_index)buffers.size();
+		double * const * const partial = buffers.data();
+		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static)
+			for (cloud_index b = 0; b < numBuffers; b++) {
+				double * const pX = partial[b] + i;
+				double * const pY = partial[b] + numParticles + i;
+				plusEqual_pd(cloud->forceX + i, load_pd(pX));
+				plusEqual_pd(cloud->forceY + i, load_pd(pY));
+				store_pd(pX, set0_pd());
+				store_pd(pY, set0_pd());
+			}
+		END_PARALLEL_FOR
+		return;
+	}
 #endif
+	for (Force * const F : level)
+		(F->*substep)(time);
 }
 
 /**
-* @brief Checks if any particles are within a certain distance
+* @brief Prints how often the timestep was reduced and the closest separation
+*        that reduced it.
 *
-* @param[in] a    Vector of particle separations in x-direction
-* @param[in] b    Vector of particle separations in y-direction
-* @param[in] dist Distance to check
-* 
-* @return True if particle is within the set distance
+* @param[in] out Stream to print to
 **/
-inline bool Integrator::isWithInDistance(const floatV a, const floatV b, const float dist) {
-	return (bool)movemask_ps(cmple_ps(sqrt_ps(add_ps(mul_ps(a, a), mul_ps(b, b))), set1_ps(dist)));
+void Integrator::printStatistics(std::ostream &out) const {
+	out << "Timestep check: " << numReductions << " of " << numChecks << " timesteps reduced";
+	if (numReductions)
+		out << ", closest separation " << closestSeparation << " m";
+	out << "." << std::endl;
 }
@@ -9,10 +9,12 @@
 #ifndef INTEGRATOR_H
 #define INTEGRATOR_H
 
+#include "CellList.h"
 #include "Cloud.h"
 #include "Force.h"
-#include "Operator.h"
-#include <array>
+#include <map>
+#include <ostream>
+#include <vector>
 
 class Integrator {
 public:
@@ -23,18 +25,23 @@ public:
 	double currentTime;
     
     virtual void moveParticles(const double endTime)=0;
+    virtual void printStatistics(std::ostream &out) const;
     
 protected:
 	Cloud * const cloud; // pointer to cloud object
 	const ForceArray &forces;
 	const double init_dt; // store initial time step
-    const std::array<Operator * const, 1> operations;
-    SEMAPHORES
+    mutable CellList cells; // cell list used to find the closest pair
+    mutable unsigned long numChecks; // number of calls to modifyTimeStep
+    mutable unsigned long numReductions; // number of calls that reduced the timestep
+    mutable float closestSeparation; // smallest separation that reduced the timestep
+    mutable std::vector<float> separationMinima; // smallest separation of each chunk of particles
+    mutable std::map<const Force *, double *> partialForces; // x- then y-forces of the forces computed concurrently
     
     const double modifyTimeStep(float currentDist, double currentTimeStep) const;
-	void tryToReduceTimeStep(const floatV sepx, const floatV sepy, float &distance, double &time) const;
-	static floatV loadFloatVector(double * const x);
-	static bool isWithInDistance(const floatV a, const floatV b, const float dist);
+	float minimumSeparation(const float range) const;
+	void evaluateForces(const ForceArray &level, const double time, bool &oddSubstep) const;
+	void runForces(const ForceArray &level, void (Force::*substep)(const double), const double time) const;
 };
 
 #endif // INTEGRATOR_H
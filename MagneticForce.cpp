@@ -49,8 +49,23 @@ inline void MagneticForce::force(const cloud_index currentParticle, const double
                                  const doubleV currentVelocityY) {
 	const doubleV qB = mul_pd(load_pd(cloud->charge + currentParticle), BField);
 
-	plusEqual_pd(cloud->forceX  + currentParticle, mul_pd(qB, currentVelocityY));
-	minusEqual_pd(cloud->forceY + currentParticle, mul_pd(qB, currentVelocityX));
+	plusEqual_pd(targetX  + currentParticle, mul_pd(qB, currentVelocityY));
+	minusEqual_pd(targetY + currentParticle, mul_pd(qB, currentVelocityX));
+}
+
+/**
+* @brief Adds the magnetic field, which ExponentialVerlet solves exactly.
+*
+* @param[in]     currentTime The current time of the simulation
+* @param[in,out] drag        Drag rate [Hz]
+* @param[in,out] field       Magnetic field in the z-direction [T]
+*
+* @return True
+**/
+bool MagneticForce::linearVelocityTerms(const double currentTime, double &drag, double &field) const {
+	(void)currentTime; (void)drag;
+	field += BField;
+	return true;
 }
 
 void MagneticForce::writeForce(fitsfile * const file, int * const error) const {
@@ -24,6 +24,8 @@ public:
 	
 	void writeForce(fitsfile * const file, int * const error) const;
 	void readForce(fitsfile * const file, int * const error);
+	bool velocityDependent() const { return true; }
+	bool linearVelocityTerms(const double currentTime, double &drag, double &field) const;
 
 protected:
 	double BField; //!< The strength of the magnetic force [T]
@@ -0,0 +1,121 @@
+/**
+* @file  NearCoulombForce.cpp
+* @class NearCoulombForce NearCoulombForce.h
+*
+* @brief Models the part of the shielded coulomb interaction between close
+*        particles, which changes fastest. The Respa integrator adds it on the
+*        fast level and subtracts it from the full coulomb force on the slow
+*        level.
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "NearCoulombForce.h"
+#include <cmath>
+
+const double NearCoulombForce::coulomb = 1.0/(4.0*M_PI*Cloud::epsilon0);
+
+/**
+* @brief Constructor for the NearCoulombForce class
+*
+* @param[in] C                 Cloud object
+* @param[in] shieldingConstant Inverse of shielding distance [m^-1]
+* @param[in] radius            Pairs farther apart are left out [m]
+* @param[in] factor            1 to add the near force, -1 to subtract it
+**/
+NearCoulombForce::NearCoulombForce(Cloud * const C, const double shieldingConstant, const double radius,
+                                   const double factor)
+: Force(C), shielding(shieldingConstant), splitRadius(radius), innerRadius(0.8*radius), sign(factor),
+cells(C->n) {}
+
+void NearCoulombForce::force1(const double currentTime) {
+    (void)currentTime;
+    nearForce(cloud->x, cloud->y);
+}
+
+void NearCoulombForce::force2(const double currentTime) {
+    (void)currentTime;
+    nearForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void NearCoulombForce::force3(const double currentTime) {
+    (void)currentTime;
+    nearForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void NearCoulombForce::force4(const double currentTime) {
+    (void)currentTime;
+    nearForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+/**
+* @brief Computes the shielded coulomb force of the pairs within splitRadius,
+*        weighted by a switch that falls smoothly from 1 at innerRadius to 0 at
+*        splitRadius.
+*
+* @details The switch keeps the near force and the remaining far force smooth,
+*          so the far force can be integrated with a longer timestep. Pairs
+*          beyond 10*(ion debye length) are left out like in the full force.
+*          Each particle only accumulates its own force, so no locks are
+*          needed.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void NearCoulombForce::nearForce(const double * const x, const double * const y) {
+	cells.build(x, y, splitRadius);
+
+	const double splitRadius2 = splitRadius*splitRadius;
+	const double switchWidth = splitRadius - innerRadius;
+	const double * const charge = cloud->charge;
+	BEGIN_PARALLEL_FOR(p, e, cells.n, 1, static)
+		const cloud_index cx = cells.particleCell[p]%cells.numCellsX;
+		const cloud_index cy = cells.particleCell[p]/cells.numCellsX;
+		const double x1 = cells.sortedX[p], y1 = cells.sortedY[p];
+		double forceX = 0.0, forceY = 0.0;
+
+		for (cloud_index row = cy ? cy - 1 : 0; row <= cy + 1 && row < cells.numCellsY; row++)
+			for (cloud_index q = cells.rowBegin(cx, row), end = cells.rowEnd(cx, row); q < end; q++) {
+				const double displacementX = x1 - cells.sortedX[q];
+				const double displacementY = y1 - cells.sortedY[q];
+				const double displacement2 = displacementX*displacementX + displacementY*displacementY;
+				if (q == p || displacement2 >= splitRadius2)
+					continue;
+
+				const double displacement = sqrt(displacement2);
+				const double valExp = displacement*shielding;
+				if (valExp >= 10.0)
+					continue;
+
+				// smoothstep from 1 at innerRadius to 0 at splitRadius:
+				const double t = displacement > innerRadius ? (displacement - innerRadius)/switchWidth : 0.0;
+				const double weight = 1.0 - t*t*(3.0 - 2.0*t);
+				const double forceC = weight*charge[cells.particles[q]]*(1.0 + valExp)*exp(-valExp)
+				                      /(displacement2*displacement);
+				forceX += forceC*displacementX;
+				forceY += forceC*displacementY;
+			}
+
+		const cloud_index currentParticle = cells.particles[p];
+		const double q1 = sign*coulomb*charge[currentParticle];
+		targetX[currentParticle] += q1*forceX;
+		targetY[currentParticle] += q1*forceY;
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Does nothing, the split is set up by the integrator and not saved.
+**/
+void NearCoulombForce::writeForce(fitsfile * const file, int * const error) const {
+	(void)file;
+	(void)error;
+}
+
+/**
+* @brief Does nothing, the split is set up by the integrator and not saved.
+**/
+void NearCoulombForce::readForce(fitsfile * const file, int * const error) {
+	(void)file;
+	(void)error;
+}
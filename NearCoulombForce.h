@@ -0,0 +1,40 @@
+/**
+* @file  NearCoulombForce.h
+* @brief Defines the data and methods of the NearCoulombForce class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef NEARCOULOMBFORCE_H
+#define NEARCOULOMBFORCE_H
+
+#include "CellList.h"
+#include "Force.h"
+
+class NearCoulombForce : public Force {
+public:
+	NearCoulombForce(Cloud * const C, const double shieldingConstant, const double radius, const double factor);
+	~NearCoulombForce() {}
+
+	void force1(const double currentTime); //rk substep 1
+	void force2(const double currentTime); //rk substep 2
+	void force3(const double currentTime); //rk substep 3
+	void force4(const double currentTime); //rk substep 4
+
+	void writeForce(fitsfile * const file, int * const error) const;
+	void readForce(fitsfile * const file, int * const error);
+
+private:
+	const double shielding;   //<! Inverse of shielding distance [m^-1]
+	const double splitRadius; //<! Pairs farther apart are left out [m]
+	const double innerRadius; //<! Pairs closer together are fully included [m]
+	const double sign;        //<! 1 to add the near force, -1 to subtract it
+	CellList cells;           //<! Cell list rebuilt from the positions of every substep
+
+	static const double coulomb; //<! Coulomb constant: 8.987551787 [m/F]
+
+	void nearForce(const double * const x, const double * const y);
+};
+
+#endif // NEARCOULOMBFORCE_H
@@ -0,0 +1,149 @@
+/**
+* @file  NeighborList.cpp
+* @class NeighborList NeighborList.h
+*
+* @brief Keeps a Verlet list of the partners within the cutoff plus a skin
+*        radius of each particle. The list is reused until some particle has
+*        moved more than half the skin since it was built.
+*
+* @license This file is distributed under the BSD Open Source License. 
+*          See LICENSE.TXT for details. 
+**/
+
+#include "NeighborList.h"
+#include <algorithm>
+
+const cloud_index NeighborList::chunkSize;
+
+/**
+* @brief Constructor for the NeighborList class
+*
+* @param[in] numPar     The number of particles
+* @param[in] skinRadius Extra radius beyond the cutoff kept in the lists (m)
+**/
+NeighborList::NeighborList(const cloud_index numPar, const double skinRadius)
+: n(numPar), skin(skinRadius), neighborStart(new cloud_index[n + 1]()),
+cells(numPar), x0(new double[n]), y0(new double[n]), listCutoff(0.0),
+numBuilds(0), numUpdates(0), totalLength(0.0), chunkMoved((numPar + chunkSize - 1)/chunkSize) {}
+
+/**
+* @brief Destructor for the NeighborList class
+**/
+NeighborList::~NeighborList() {
+	delete[] neighborStart;
+	delete[] x0; delete[] y0;
+}
+
+/**
+* @brief Rebuilds the lists if they could be missing a pair within the cutoff.
+*
+* @param[in] x      Particle x-positions
+* @param[in] y      Particle y-positions
+* @param[in] cutoff Interaction cutoff (m)
+**/
+void NeighborList::update(const double * const x, const double * const y, const double cutoff) {
+	BEGIN_SERIAL
+		++numUpdates;
+	END_SERIAL
+	if (!numBuilds || cutoff != listCutoff || hasMovedTooFar(x, y))
+		build(x, y, cutoff);
+}
+
+/**
+* @brief Checks if any particle has moved more than half the skin since the last
+*        build. Two particles that each moved less than that are still in each
+*        others lists if they are within the cutoff.
+*
+* @details Each chunk of particles is checked in parallel and writes a flag,
+*          and the flags are combined at the end.
+*
+* @param[in] x Particle x-positions
+* @param[in] y Particle y-positions
+*
+* @return True if the lists have to be rebuilt
+**/
+bool NeighborList::hasMovedTooFar(const double * const x, const double * const y) {
+	const double maxDisplacement = 0.25*skin*skin;
+	const cloud_index numChunks = (cloud_index)chunkMoved.size();
+	int * const moved = chunkMoved.data();
+	BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+		int tooFar = 0;
+		for (cloud_index i = chunk*chunkSize, end = std::min(n, i + chunkSize); i < end && !tooFar; i++) {
+			const double dx = x[i] - x0[i];
+			const double dy = y[i] - y0[i];
+			tooFar = dx*dx + dy*dy > maxDisplacement;
+		}
+		moved[chunk] = tooFar;
+	END_PARALLEL_FOR
+
+	return *std::max_element(moved, moved + numChunks) != 0;
+}
+
+/**
+* @brief Builds the lists from a cell list with cells of the cutoff plus skin.
+*
+* @param[in] x      Particle x-positions
+* @param[in] y      Particle y-positions
+* @param[in] cutoff Interaction cutoff (m)
+**/
+void NeighborList::build(const double * const x, const double * const y, const double cutoff) {
+	const double listRadius = cutoff + skin;
+	const double listRadius2 = listRadius*listRadius;
+	cells.build(x, y, listRadius);
+
+	// Count the neighbors of each particle, then fill the lists.
+	for (int pass = 0; pass < 2; pass++) {
+		BEGIN_PARALLEL_FOR(p, e, n, 1, static)
+			const cloud_index cx = cells.particleCell[p]%cells.numCellsX;
+			const cloud_index cy = cells.particleCell[p]/cells.numCellsX;
+			const cloud_index i = cells.particles[p];
+			cloud_index count = 0;
+
+			for (cloud_index row = cy ? cy - 1 : 0; row <= cy + 1 && row < cells.numCellsY; row++)
+				for (cloud_index q = cells.rowBegin(cx, row), end = cells.rowEnd(cx, row); q < end; q++) {
+					const double dx = cells.sortedX[p] - cells.sortedX[q];
+					const double dy = cells.sortedY[p] - cells.sortedY[q];
+					if (q != p && dx*dx + dy*dy < listRadius2) {
+						if (pass)
+							neighbors[neighborStart[i] + count] = cells.particles[q];
+						++count;
+					}
+				}
+
+			if (!pass)
+				neighborStart[i + 1] = count;
+		END_PARALLEL_FOR
+
+		if (!pass) {
+			BEGIN_SERIAL
+				neighborStart[0] = 0;
+				for (cloud_index i = 0; i < n; i++)
+					neighborStart[i + 1] += neighborStart[i];
+				// Padded so the last neighbors can be loaded as a full vector.
+				neighbors.assign(neighborStart[n] + DOUBLE_STRIDE, 0);
+			END_SERIAL
+		}
+	}
+
+	BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+		x0[i] = x[i];
+		y0[i] = y[i];
+	END_PARALLEL_FOR
+
+	BEGIN_SERIAL
+		listCutoff = cutoff;
+		totalLength += (double)neighborStart[n]/(double)n;
+		++numBuilds;
+	END_SERIAL
+}
+
+/**
+* @brief Prints how often the lists were rebuilt and how long they were.
+*
+* @param[in] out Stream to print to
+**/
+void NeighborList::printStatistics(std::ostream &out) const {
+	out << "Neighbor list: " << numBuilds << " builds in " << numUpdates
+	<< " substeps, " << (numBuilds ? totalLength/numBuilds : 0.0)
+	<< " neighbors per particle on average (skin " << skin << " m)." << std::endl;
+}
@@ -0,0 +1,44 @@
+/**
+* @file  NeighborList.h
+* @brief Defines the data and methods of the NeighborList class
+*
+* @license This file is distributed under the BSD Open Source License. 
+*          See LICENSE.TXT for details. 
+**/
+
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include "CellList.h"
+#include <ostream>
+
+class NeighborList {
+public:
+	NeighborList(const cloud_index numPar, const double skinRadius);
+	~NeighborList();
+
+	const cloud_index n;                 //!< Number of particles
+	const double skin;                   //!< Extra radius beyond the cutoff kept in the lists (m)
+	cloud_index * const neighborStart;   //!< First index into neighbors of each particle, plus one past the end
+	std::vector<cloud_index> neighbors;  //!< Neighbors of every particle, one particle after another
+
+	void update(const double * const x, const double * const y, const double cutoff);
+	void invalidate() { listCutoff = 0.0; } //!< Forces a rebuild, e.g. after the particles were reordered
+	void printStatistics(std::ostream &out) const;
+
+private:
+	CellList cells;             //!< Cell list used to build the neighbor lists
+	double * const x0, * const y0; //!< Positions at the last build (m)
+	double listCutoff;          //!< Cutoff the lists were built for (m)
+	unsigned long numBuilds;    //!< Number of times the lists were built
+	unsigned long numUpdates;   //!< Number of times update was called
+	double totalLength;         //!< Sum of the average list length over all builds
+	std::vector<int> chunkMoved; //!< Whether a particle of each chunk moved too far
+
+	static const cloud_index chunkSize = 1024; //!< Particles checked per chunk by hasMovedTooFar
+
+	void build(const double * const x, const double * const y, const double cutoff);
+	bool hasMovedTooFar(const double * const x, const double * const y);
+};
+
+#endif // NEIGHBORLIST_H
@@ -0,0 +1,90 @@
+/**
+* @file  PairScheduler.cpp
+* @class PairScheduler PairScheduler.h
+*
+* @brief Splits the upper triangle of the pair matrix into square blocks and
+*        deals out consecutive runs of blocks with equal numbers of pairs to
+*        the threads
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "PairScheduler.h"
+#include <algorithm>
+
+const cloud_index PairScheduler::maxBlockSize;
+const cloud_index PairScheduler::blocksPerThread;
+
+/**
+* @brief Constructor for the PairScheduler class
+*
+* @details Blocks are made small enough for every thread to get at least
+*          blocksPerThread of them, so the work of the threads differs by less
+*          than a block. Their width is a multiple of FLOAT_STRIDE, which lets
+*          both double and float kernels step through them in whole vectors.
+*          Each thread gets the blocks whose middle falls into its share of the
+*          pairs. The blocks of a thread are consecutive and mostly share their
+*          band of rows.
+*
+* @param[in] numPar The number of particles, a multiple of FLOAT_STRIDE
+**/
+PairScheduler::PairScheduler(const cloud_index numPar)
+: n(numPar), numThreads((cloud_index)NUM_THREADS), threadTime(new double[numThreads]()), numRuns(0) {
+	cloud_index numBands = 1;
+	while (numBands*(numBands + 1)/2 < blocksPerThread*numThreads)
+		++numBands;
+	blockSize = (n + numBands - 1)/numBands;
+	blockSize = std::max((cloud_index)FLOAT_STRIDE, std::min(maxBlockSize, (blockSize + FLOAT_STRIDE - 1)/FLOAT_STRIDE*FLOAT_STRIDE));
+
+	std::vector<double> work;
+	double totalWork = 0.0;
+	for (cloud_index row = 0; row < n; row += blockSize)
+		for (cloud_index column = row; column < n; column += blockSize) {
+			const Block block = {row, std::min(n, row + blockSize), column, std::min(n, column + blockSize)};
+			const double rows = (double)(block.rowEnd - block.rowBegin);
+			blocks.push_back(block);
+			work.push_back(row == column ? 0.5*rows*(rows + 1.0) : rows*(double)(block.columnEnd - block.columnBegin));
+			totalWork += work.back();
+		}
+
+	threadStart.assign(1, 0);
+	double done = 0.0;
+	for (cloud_index k = 0; k < (cloud_index)blocks.size(); k++) {
+		const cloud_index owner = std::min(numThreads - 1, (cloud_index)((done + 0.5*work[k])/totalWork*(double)numThreads));
+		while ((cloud_index)threadStart.size() <= owner)
+			threadStart.push_back(k);
+		done += work[k];
+	}
+	threadStart.resize(numThreads + 1, (cloud_index)blocks.size());
+}
+
+/**
+* @brief Destructor for the PairScheduler class
+**/
+PairScheduler::~PairScheduler() {
+	delete[] threadTime;
+}
+
+/**
+* @brief Prints the average time of each thread per run and the ratio of the
+*        slowest thread to the average.
+*
+* @param[in] out  Stream to print to
+* @param[in] name Name of the loop
+**/
+void PairScheduler::printStatistics(std::ostream &out, const char * const name) const {
+	if (!numRuns)
+		return;
+
+	double total = 0.0, slowest = 0.0;
+	for (cloud_index thread = 0; thread < numThreads; thread++) {
+		total += threadTime[thread];
+		slowest = std::max(slowest, threadTime[thread]);
+	}
+	out << name << " pair blocks: " << blocks.size() << " blocks of " << blockSize << " particles on "
+	<< numThreads << " threads, thread times";
+	for (cloud_index thread = 0; thread < numThreads; thread++)
+		out << " " << 1E3*threadTime[thread]/numRuns;
+	out << " ms per run, slowest/average " << (total > 0.0 ? slowest*numThreads/total : 1.0) << "." << std::endl;
+}
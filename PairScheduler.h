@@ -0,0 +1,59 @@
+/**
+* @file  PairScheduler.h
+* @brief Defines the data and methods of the PairScheduler class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef PAIRSCHEDULER_H
+#define PAIRSCHEDULER_H
+
+#include "Parallel.h"
+#include "VectorCompatibility.h"
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+class PairScheduler {
+public:
+	PairScheduler(const cloud_index numPar);
+	~PairScheduler();
+
+	//!< A rectangle of the upper triangle of the pair matrix:
+	struct Block {
+		cloud_index rowBegin, rowEnd;       //!< Range of first particles of the pairs
+		cloud_index columnBegin, columnEnd; //!< Range of second particles, starts at rowBegin on the diagonal
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	static const cloud_index maxBlockSize = 256; //!< Largest block width, so a block fits in L1 cache
+	static const cloud_index blocksPerThread = 8; //!< Smallest number of blocks per thread
+
+	const cloud_index n;                    //!< Number of particles
+	const cloud_index numThreads;           //!< Number of threads the blocks are dealt out to
+	cloud_index blockSize;                  //!< Block width, a multiple of FLOAT_STRIDE
+	std::vector<Block> blocks;              //!< Blocks, band of rows after band of rows
+	std::vector<cloud_index> threadStart;   //!< First block of each thread, plus one past the end
+
+	/**
+	* @brief Counts a pass over all pairs.
+	**/
+	void startRun() {++numRuns;}
+
+	/**
+	* @brief Adds the time since start to the time spent by thread.
+	**/
+	void addTime(const cloud_index thread, const Clock::time_point start) {
+		threadTime[thread] += std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void printStatistics(std::ostream &out, const char * const name) const;
+
+private:
+	double * const threadTime; //!< Time spent by each thread over all runs (s)
+	unsigned long numRuns;     //!< Number of passes over all pairs
+};
+
+#endif // PAIRSCHEDULER_H
@@ -14,17 +14,101 @@
 #ifdef _OPENMP
 #include <omp.h>
 
-#define STRING(s) #s
-
 typedef int cloud_index;
 
+// Number of serial sections and parallel loops the calling thread is in. Loops
+// inside them run serially on that thread.
+inline int &serialDepth() {
+	static thread_local int depth = 0;
+	return depth;
+}
+
+struct SerialSection {
+	SerialSection() { ++serialDepth(); }
+	~SerialSection() { --serialDepth(); }
+};
+
+struct staticSchedule {};
+struct dynamicSchedule {};
+
+// Runs a loop body for every step of [0, num). Inside a parallel region the
+// team shares the iterations and waits for each other at the end, otherwise
+// the loop starts a team of its own.
+template <typename Body>
+inline void parallelFor(const cloud_index num, const cloud_index step, const staticSchedule, const Body &body) {
+	if (!omp_get_level()) {
+		_Pragma("omp parallel")
+		{
+			const SerialSection inLoop;
+			_Pragma("omp for schedule(static)")
+			for (cloud_index i = 0; i < num; i += step)
+				body(i);
+		}
+	} else if (serialDepth()) {
+		for (cloud_index i = 0; i < num; i += step)
+			body(i);
+	} else {
+		const SerialSection inLoop;
+		_Pragma("omp for schedule(static)")
+		for (cloud_index i = 0; i < num; i += step)
+			body(i);
+	}
+}
+
+template <typename Body>
+inline void parallelFor(const cloud_index num, const cloud_index step, const dynamicSchedule, const Body &body) {
+	if (!omp_get_level()) {
+		_Pragma("omp parallel")
+		{
+			const SerialSection inLoop;
+			_Pragma("omp for schedule(dynamic)")
+			for (cloud_index i = 0; i < num; i += step)
+				body(i);
+		}
+	} else if (serialDepth()) {
+		for (cloud_index i = 0; i < num; i += step)
+			body(i);
+	} else {
+		const SerialSection inLoop;
+		_Pragma("omp for schedule(dynamic)")
+		for (cloud_index i = 0; i < num; i += step)
+			body(i);
+	}
+}
+
 // Parallelize for loops. kind determines the scheduling of iterations to the 
-// threads.
-#define BEGIN_PARALLEL_FOR(i,e,num,step,kind)\
-_Pragma(STRING(omp parallel for schedule(kind))) \
-for (cloud_index i = 0; i < num; i += step) {
+// threads. The body is passed as a lambda, like the blocks of libDispatch.
+#define BEGIN_PARALLEL_FOR(i,e,num,step,kind) \
+parallelFor((num), (step), kind##Schedule(), [&](cloud_index i) {
 
-#define END_PARALLEL_FOR }
+#define END_PARALLEL_FOR });
+
+// Keeps one team of threads for a whole integration loop, so the parallel
+// loops inside it do not start and stop a team each. Every thread runs the
+// code between the loops, so functions called inside keep the data the
+// threads share in members, and change shared state in serial sections.
+#define BEGIN_PARALLEL_REGION _Pragma("omp parallel") {
+
+#define END_PARALLEL_REGION }
+
+// Runs a section on the first thread of the team, once every thread got there,
+// while the others wait at its end. Outside a team, or inside a serial section
+// or loop, the calling thread runs it.
+#define BEGIN_SERIAL { \
+const bool teamSerial = omp_get_level() && !serialDepth(); \
+if (teamSerial) { \
+    _Pragma("omp barrier") \
+} \
+if (!teamSerial || !omp_get_thread_num()) { \
+    const SerialSection serialSection;
+
+#define END_SERIAL } \
+if (teamSerial) { \
+    _Pragma("omp barrier") \
+} }
+
+// Number of threads that execute a parallel loop.
+#define NUM_THREADS omp_get_max_threads()
 
 // Thread synronization routines.
 #define SEMAPHORES omp_lock_t *locks;
@@ -52,6 +136,7 @@ omp_destroy_lock(locks + i);
 // compiler. libDispatch is avalible here http://libdispatch.macosforge.org/
 #elif defined (__APPLE__)
 #include <dispatch/dispatch.h>
+#include <unistd.h>
 
 #define DISPATCH_QUEUES
 
@@ -64,6 +149,19 @@ dispatch_apply((num)/step, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIG
 
 #define END_PARALLEL_FOR });
 
+// Each loop is handed to the global queues, which keep their threads, so
+// regions and serial sections only group the code.
+#define BEGIN_PARALLEL_REGION {
+
+#define END_PARALLEL_REGION }
+
+#define BEGIN_SERIAL {
+
+#define END_SERIAL }
+
+// Number of threads that execute a parallel loop.
+#define NUM_THREADS ((cloud_index)sysconf(_SC_NPROCESSORS_ONLN))
+
 // Thread synronization routines.
 #define SEMAPHORES dispatch_semaphore_t *semaphores;
 
@@ -83,8 +181,56 @@ dispatch_apply(num, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0),
 
 #define SEMAPHORE_SIGNAL(i) dispatch_semaphore_signal(semaphores[i]);
 
+/*===- std::thread --------------------------------------------------------===*/
+// Implements parallelization with a work-stealing pool of std::threads. This 
+// is used on all other targets unless SERIAL is defined. Besides parallel 
+// loops the pool runs tasks, so independent work like separate forces can run 
+// at the same time.
+#elif !defined (SERIAL)
+#include <mutex>
+
+#define THREAD_POOL
+
+typedef int cloud_index;
+
+#include "ThreadPool.h"
+
+// Parallelize for loops. kind determines how many chunks of iterations each 
+// thread gets, which idle threads steal from the others.
+#define BEGIN_PARALLEL_FOR(i,e,num,step,kind) \
+ThreadPool::instance().parallelFor((num), (step), ThreadPool::kind##Chunks, [&](cloud_index i) {
+
+#define END_PARALLEL_FOR });
+
+// The pool keeps its threads, and only the calling thread runs the code 
+// between the loops, so regions and serial sections only group the code.
+#define BEGIN_PARALLEL_REGION {
+
+#define END_PARALLEL_REGION }
+
+#define BEGIN_SERIAL {
+
+#define END_SERIAL }
+
+// Number of threads that execute a parallel loop.
+#define NUM_THREADS ThreadPool::instance().numThreads()
+
+// Thread synronization routines.
+#define SEMAPHORES std::mutex *locks;
+
+#define SEMAPHORES_MALLOC(num) , locks(new std::mutex[num])
+
+#define SEMAPHORES_INIT(num)
+
+#define SEMAPHORES_FREE(num) delete[] locks;
+
+#define SEMAPHORE_WAIT(i) locks[i].lock();
+
+#define SEMAPHORE_SIGNAL(i) locks[i].unlock();
+
 /*===- scalar -------------------------------------------------------------===*/
-// If no parallelization is availible fallback to single threaded code.
+// If no parallelization is availible, or SERIAL is defined, fallback to single
+// threaded code.
 #else
 
 typedef unsigned int cloud_index;
@@ -94,6 +240,18 @@ typedef unsigned int cloud_index;
 
 #define END_PARALLEL_FOR }
 
+// There is only one thread, so regions and serial sections only group the code.
+#define BEGIN_PARALLEL_REGION {
+
+#define END_PARALLEL_REGION }
+
+#define BEGIN_SERIAL {
+
+#define END_SERIAL }
+
+// Number of threads that execute a parallel loop.
+#define NUM_THREADS 1
+
 // Thread synronization routines. Since there is only one thread these expand to
 // nothing.
 #define SEMAPHORES
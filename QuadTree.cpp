@@ -0,0 +1,292 @@
+/**
+* @file  QuadTree.cpp
+* @class QuadTree QuadTree.h
+*
+* @brief Sorts particles along a Morton curve and splits the square around
+*        them into a quadtree whose cells hold the multipole moments of their
+*        charges up to second order
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "QuadTree.h"
+#include <algorithm>
+#include <cmath>
+
+const cloud_index QuadTree::leafSize;
+const unsigned QuadTree::maxDepth;
+
+/**
+* @brief Constructor for the QuadTree class
+* @param[in] numPar The number of particles
+**/
+QuadTree::QuadTree(const cloud_index numPar)
+: n(numPar), numLevels(0), particles(new cloud_index[n]),
+// Padded by a vector width so the last particles can be loaded as a full vector.
+sortedX(new double[n + DOUBLE_STRIDE]()), sortedY(new double[n + DOUBLE_STRIDE]()),
+sortedCharge(new double[n + DOUBLE_STRIDE]()),
+keys(new unsigned[n]), keyScratch(new unsigned[n]), indexScratch(new cloud_index[n]),
+digitCounts(256*NUM_THREADS) {}
+
+/**
+* @brief Destructor for the QuadTree class
+**/
+QuadTree::~QuadTree() {
+	delete[] particles;
+	delete[] sortedX; delete[] sortedY; delete[] sortedCharge;
+	delete[] keys; delete[] keyScratch; delete[] indexScratch;
+}
+
+/**
+* @brief Rebuilds the tree for new positions.
+*
+* @details The keys interleave 16 bits of each coordinate, so sorting them
+*          orders the particles cell by cell at every level and the particles
+*          of any cell are a contiguous range. The tree is then split one level
+*          at a time and the moments are summed from the leaves up, with the
+*          cells of each level handled in parallel. Inside a parallel region
+*          the whole team builds the tree, and one thread does the bookkeeping
+*          between the loops.
+*
+* @param[in] x      Particle x-positions
+* @param[in] y      Particle y-positions
+* @param[in] charge Particle charges
+**/
+void QuadTree::build(const double * const x, const double * const y, const double * const charge) {
+	BEGIN_SERIAL
+		double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+		for (cloud_index i = 1; i < n; i++) {
+			minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+			minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+		}
+		// Slightly enlarged so the largest coordinates get keys below 2^16.
+		double side = std::max(maxX - minX, maxY - minY)*(1.0 + 1E-9);
+		if (!(side > 0.0))
+			side = 1.0;
+
+		nodes.resize(1);
+		Node &root = nodes[0];
+		root.begin = 0;
+		root.end = n;
+		root.cornerX = minX;
+		root.cornerY = minY;
+		root.side = side;
+
+		levelStart.assign(1, 0);
+		levelStart.push_back(1);
+	END_SERIAL
+	const double minX = nodes[0].cornerX, minY = nodes[0].cornerY, scale = 65536.0/nodes[0].side;
+
+	BEGIN_PARALLEL_FOR(i, e, n, 1, static)
+		const unsigned keyX = std::min((unsigned)((x[i] - minX)*scale), 65535u);
+		const unsigned keyY = std::min((unsigned)((y[i] - minY)*scale), 65535u);
+		keys[i] = spreadBits(keyX) << 1 | spreadBits(keyY);
+		particles[i] = i;
+	END_PARALLEL_FOR
+
+	sortKeys();
+
+	BEGIN_PARALLEL_FOR(p, e, n, 1, static)
+		const cloud_index i = particles[p];
+		sortedX[p] = x[i];
+		sortedY[p] = y[i];
+		sortedCharge[p] = charge[i];
+	END_PARALLEL_FOR
+
+	unsigned levels = 0;
+	do
+		splitLevel(levels++);
+	while (levelStart[levels + 1] > levelStart[levels]);
+	BEGIN_SERIAL
+		numLevels = levels;
+	END_SERIAL
+
+	for (unsigned level = levels; level-- > 0;)
+		computeMoments(level);
+}
+
+/**
+* @brief Sorts the particle indices by key with a parallel radix sort.
+*
+* @details Each of the four passes sorts by eight bits. Every thread counts the
+*          digits of its own chunk, so after a prefix sum over digits and
+*          chunks each thread knows where to scatter its keys. The sort is
+*          stable, which makes it exact after the last pass.
+**/
+void QuadTree::sortKeys() {
+	const cloud_index numChunks = (cloud_index)digitCounts.size()/256;
+	const cloud_index chunkSize = (n + numChunks - 1)/numChunks;
+	cloud_index * const counts = digitCounts.data();
+	unsigned *fromKeys = keys, *toKeys = keyScratch;
+	cloud_index *fromIndices = particles, *toIndices = indexScratch;
+
+	for (unsigned shift = 0; shift < 32; shift += 8) {
+		BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+			cloud_index * const count = counts + 256*chunk;
+			std::fill(count, count + 256, 0);
+			for (cloud_index i = chunk*chunkSize, end = std::min(n, i + chunkSize); i < end; i++)
+				++count[fromKeys[i] >> shift & 255];
+		END_PARALLEL_FOR
+
+		BEGIN_SERIAL
+			cloud_index total = 0;
+			for (cloud_index digit = 0; digit < 256; digit++)
+				for (cloud_index chunk = 0; chunk < numChunks; chunk++) {
+					const cloud_index count = counts[256*chunk + digit];
+					counts[256*chunk + digit] = total;
+					total += count;
+				}
+		END_SERIAL
+
+		BEGIN_PARALLEL_FOR(chunk, e, numChunks, 1, static)
+			cloud_index * const position = counts + 256*chunk;
+			for (cloud_index i = chunk*chunkSize, end = std::min(n, i + chunkSize); i < end; i++) {
+				const cloud_index to = position[fromKeys[i] >> shift & 255]++;
+				toKeys[to] = fromKeys[i];
+				toIndices[to] = fromIndices[i];
+			}
+		END_PARALLEL_FOR
+
+		std::swap(fromKeys, toKeys);
+		std::swap(fromIndices, toIndices);
+	}
+	// After an even number of passes the result is back in keys and particles.
+}
+
+/**
+* @brief Splits the cells of one level with more than leafSize particles into
+*        their nonempty quadrants, which make up the next level.
+*
+* @param[in] level Level to split, 0 for the root
+**/
+void QuadTree::splitLevel(const unsigned level) {
+	const cloud_index first = levelStart[level], last = levelStart[level + 1];
+	BEGIN_SERIAL
+		splits.resize(5*(last - first));
+	END_SERIAL
+
+	BEGIN_PARALLEL_FOR(k, e, last - first, 1, static)
+		Node &node = nodes[first + k];
+		cloud_index * const split = splits.data() + 5*k;
+		split[0] = node.begin;
+		split[4] = node.end;
+		node.numChildren = 0;
+		if (node.end - node.begin > leafSize && level < maxDepth) {
+			// The quadrant is given by the two key bits below the bits this
+			// level shares.
+			const unsigned shift = 30 - 2*level;
+			const unsigned long long prefix = keys[node.begin] & ~((1ULL << (shift + 2)) - 1);
+			for (unsigned quadrant = 1; quadrant < 4; quadrant++)
+				split[quadrant] = std::lower_bound(keys + node.begin, keys + node.end,
+				                                   (unsigned)(prefix + ((unsigned long long)quadrant << shift))) - keys;
+			for (unsigned quadrant = 0; quadrant < 4; quadrant++)
+				if (split[quadrant + 1] > split[quadrant])
+					++node.numChildren;
+		}
+	END_PARALLEL_FOR
+
+	// Children are stored consecutively after the current last node.
+	BEGIN_SERIAL
+		cloud_index next = last;
+		for (cloud_index k = first; k < last; k++) {
+			nodes[k].firstChild = next;
+			next += nodes[k].numChildren;
+		}
+		nodes.resize(next);
+		levelStart.push_back(next);
+	END_SERIAL
+
+	BEGIN_PARALLEL_FOR(k, e, last - first, 1, static)
+		const Node &node = nodes[first + k];
+		const cloud_index * const split = splits.data() + 5*k;
+		const double half = 0.5*node.side;
+		for (cloud_index quadrant = 0, child = node.firstChild; node.numChildren && quadrant < 4; quadrant++)
+			if (split[quadrant + 1] > split[quadrant]) {
+				Node &childNode = nodes[child++];
+				childNode.begin = split[quadrant];
+				childNode.end = split[quadrant + 1];
+				// The x-bit is the higher of the two key bits.
+				childNode.cornerX = node.cornerX + (double)(quadrant >> 1)*half;
+				childNode.cornerY = node.cornerY + (double)(quadrant & 1)*half;
+				childNode.side = half;
+			}
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Computes the moments of the cells of one level from their particles,
+*        or from their children, which must already be done.
+*
+* @details The expansion center is the center of the absolute charge, which
+*          makes the dipole moment vanish when all charges have the same sign.
+*          Moments of the children are shifted to the new center with the
+*          parallel axis theorem.
+*
+* @param[in] level Level of the cells
+**/
+void QuadTree::computeMoments(const unsigned level) {
+	const cloud_index first = levelStart[level], last = levelStart[level + 1];
+	BEGIN_PARALLEL_FOR(k, e, last - first, 1, static)
+		Node &node = nodes[first + k];
+		const Node * const children = nodes.data() + node.firstChild;
+		double absCharge = 0.0, sumX = 0.0, sumY = 0.0;
+		if (node.numChildren)
+			for (cloud_index c = 0; c < node.numChildren; c++) {
+				absCharge += children[c].absCharge;
+				sumX += children[c].absCharge*children[c].centerX;
+				sumY += children[c].absCharge*children[c].centerY;
+			}
+		else
+			for (cloud_index p = node.begin; p < node.end; p++) {
+				const double q = std::fabs(sortedCharge[p]);
+				absCharge += q;
+				sumX += q*sortedX[p];
+				sumY += q*sortedY[p];
+			}
+
+		const double middleX = node.cornerX + 0.5*node.side, middleY = node.cornerY + 0.5*node.side;
+		node.absCharge = absCharge;
+		node.centerX = absCharge > 0.0 ? sumX/absCharge : middleX;
+		node.centerY = absCharge > 0.0 ? sumY/absCharge : middleY;
+		node.offset = std::hypot(node.centerX - middleX, node.centerY - middleY);
+
+		node.charge = node.dipoleX = node.dipoleY = node.quadXX = node.quadXY = node.quadYY = 0.0;
+		if (node.numChildren)
+			for (cloud_index c = 0; c < node.numChildren; c++) {
+				const Node &child = children[c];
+				const double sx = child.centerX - node.centerX, sy = child.centerY - node.centerY;
+				node.charge += child.charge;
+				node.dipoleX += child.dipoleX + child.charge*sx;
+				node.dipoleY += child.dipoleY + child.charge*sy;
+				node.quadXX += child.quadXX + 2.0*child.dipoleX*sx + child.charge*sx*sx;
+				node.quadXY += child.quadXY + child.dipoleX*sy + child.dipoleY*sx + child.charge*sx*sy;
+				node.quadYY += child.quadYY + 2.0*child.dipoleY*sy + child.charge*sy*sy;
+			}
+		else
+			for (cloud_index p = node.begin; p < node.end; p++) {
+				const double q = sortedCharge[p];
+				const double sx = sortedX[p] - node.centerX, sy = sortedY[p] - node.centerY;
+				node.charge += q;
+				node.dipoleX += q*sx;
+				node.dipoleY += q*sy;
+				node.quadXX += q*sx*sx;
+				node.quadXY += q*sx*sy;
+				node.quadYY += q*sy*sy;
+			}
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Moves the lower 16 bits of a to the even bit positions.
+*
+* @param[in] a The bits to spread
+**/
+inline unsigned QuadTree::spreadBits(unsigned a) {
+	a &= 0xFFFF;
+	a = (a | a << 8) & 0x00FF00FF;
+	a = (a | a << 4) & 0x0F0F0F0F;
+	a = (a | a << 2) & 0x33333333;
+	a = (a | a << 1) & 0x55555555;
+	return a;
+}
@@ -0,0 +1,61 @@
+/**
+* @file  QuadTree.h
+* @brief Defines the data and methods of the QuadTree class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include "Parallel.h"
+#include "VectorCompatibility.h"
+#include <vector>
+
+class QuadTree {
+public:
+	QuadTree(const cloud_index numPar);
+	~QuadTree();
+
+	//!< A square cell of the tree with the multipole moments of its charges:
+	struct Node {
+		cloud_index begin, end;       //!< Range of sorted particles in the cell
+		cloud_index firstChild;       //!< Index of the first child node, the children are consecutive
+		cloud_index numChildren;      //!< Number of nonempty children, 0 for a leaf
+		double cornerX, cornerY;      //!< Lower left corner of the cell (m)
+		double side;                  //!< Width of the cell (m)
+		double centerX, centerY;      //!< Expansion center, the center of the absolute charge (m)
+		double offset;                //!< Distance from the middle of the cell to the expansion center (m)
+		double absCharge;             //!< Sum of the absolute charges (C)
+		double charge;                //!< Monopole moment (C)
+		double dipoleX, dipoleY;      //!< Dipole moment about the expansion center (C m)
+		double quadXX, quadXY, quadYY; //!< Second moment about the expansion center (C m^2)
+	};
+
+	static const cloud_index leafSize = 16; //!< Cells with more particles are split
+	static const unsigned maxDepth = 16;    //!< Depth limit set by the 16 key bits per axis
+
+	const cloud_index n;                     //!< Number of particles
+	std::vector<Node> nodes;                 //!< Cells, level by level starting with the root
+	unsigned numLevels;                      //!< Number of levels of the last build
+	cloud_index * const particles;           //!< Particle indices sorted along the Morton curve
+	double * const sortedX, * const sortedY; //!< Particle positions in sorted order
+	double * const sortedCharge;             //!< Particle charges in sorted order
+
+	void build(const double * const x, const double * const y, const double * const charge);
+
+private:
+	std::vector<cloud_index> levelStart;       //!< First node of each level, plus one past the end
+	unsigned * const keys, * const keyScratch; //!< Morton keys and scratch space of the radix sort
+	cloud_index * const indexScratch;          //!< Scratch space of the radix sort
+	std::vector<cloud_index> splits;           //!< Sorted child ranges of the current level
+	std::vector<cloud_index> digitCounts;      //!< Digit counts, then scatter positions, of each chunk of the radix sort
+
+	void sortKeys();
+	void splitLevel(const unsigned level);
+	void computeMoments(const unsigned level);
+	static unsigned spreadBits(unsigned a);
+};
+
+#endif // QUADTREE_H
@@ -15,36 +15,47 @@ using namespace std::chrono;
 
 /**
 * @brief Constructor for RandomNumbers class
+*
+* @param[in] seed         Seed of the generator
+* @param[in] firstSubstep Substep the users start counting from, past the
+*                         substeps of earlier runs with the same seed
 **/
-RandomNumbers::RandomNumbers() 
-: engine(static_cast<uint64_t> (system_clock::to_time_t(system_clock::now()))), 
-zeroToOne(0.0, 1.0), zeroToTwoPi(0.0, 2.0*M_PI) {}
+RandomNumbers::RandomNumbers(const uint64_t seed, const uint64_t firstSubstep)
+: key{(uint32_t)seed, (uint32_t)(seed >> 32)}, firstSubstep(firstSubstep), numStreams(0) {}
 
 /**
-* @brief Uniformly distributed random numbers between 0 - 1
+* @brief Makes a seed from the current time.
 *
-* @return Number between 0 - 1
+* @return Seed
 **/
-const double RandomNumbers::uniformZeroToOne() {
-	return zeroToOne(engine);
+const uint64_t RandomNumbers::clockSeed() {
+	return static_cast<uint64_t> (system_clock::to_time_t(system_clock::now()));
 }
 
 /**
-* @brief Uniformly distributed random numbers between 0 - 2*Pi
+* @brief Returns the seed of the generator.
 *
-* @return Number between 0 - 2*pi
+* @return Seed
 **/
-const double RandomNumbers::uniformZeroToTwoPi() {
-	return zeroToTwoPi(engine);
+const uint64_t RandomNumbers::getSeed() const {
+	return (uint64_t)key[0] | (uint64_t)key[1] << 32;
 }
 
+/**
+* @brief Returns the substep the users start counting from.
+*
+* @return First substep
+**/
+const uint64_t RandomNumbers::getFirstSubstep() const {
+	return firstSubstep;
+}
 
 /**
-* @brief Standard gaussian distributed random numbers
+* @brief Hands out a stream, whose numbers differ from those of all other
+*        streams of this generator.
 *
-* @param[in] dist Object that produces values according to a normal distribution
-* @return Number with gaussian distribution with mean 0 and std dev 1
+* @return Stream
 **/
-const double RandomNumbers::gaussian(std::normal_distribution<double> &dist) {
-	return dist(engine);
+const uint32_t RandomNumbers::newStream() {
+	return numStreams++;
 }
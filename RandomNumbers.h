@@ -9,55 +9,101 @@
 #ifndef RANDOMNUMBERS
 #define RANDOMNUMBERS
 
-#include <random>
+#include <cstdint>
 #include "VectorCompatibility.h"
 
+/**
+* @brief Counter-based random numbers from Philox4x32-10 (Salmon et al. 2011)
+*
+* @details Each draw is a function of the seed and a counter made of a stream,
+*          the particle and a substep, so every thread draws the numbers of its
+*          own particles without shared state, and the numbers do not depend on
+*          the number of threads. Each user of the numbers takes a stream of
+*          its own. A continued run keeps the seed and starts counting its
+*          substeps at the first substep, past those of the earlier runs.
+**/
 class RandomNumbers {
 public:
-	RandomNumbers();
+	explicit RandomNumbers(const uint64_t seed, const uint64_t firstSubstep = 0);
 	~RandomNumbers() {}
-	
-	const double uniformZeroToOne();
-	const double uniformZeroToTwoPi();
-	const double gaussian(std::normal_distribution<double> &dist);
-	
+
+	static const uint64_t clockSeed();
+	const uint64_t getSeed() const;
+	const uint64_t getFirstSubstep() const;
+	const uint32_t newStream();
+	void uniform_pd(const uint32_t stream, const indexV particles, const uint64_t substep,
+	                doubleV &u1, doubleV &u2) const;
+	static void gaussian_pd(const doubleV u1, const doubleV u2, doubleV &g1, doubleV &g2);
+	static void direction_pd(const doubleV u, doubleV &x, doubleV &y);
+
 private:
-	std::mt19937_64 engine; //<! Mersenne Twister pseudo-random generator of 64-bit numbers with a state size of 19937 bits
-	
-	std::uniform_real_distribution<double> zeroToOne;
-	std::uniform_real_distribution<double> zeroToTwoPi;
+	uint32_t key[2];       //<! Key of the generator, the seed
+	uint64_t firstSubstep; //<! Substep the users start counting from
+	uint32_t numStreams;   //<! Number of streams handed out
 };
 
 /**
-* @brief Structure to hold precomputed random numbers for use with thermal forces.
+* @brief Draws two numbers uniform in [0, 1) for each particle of a vector.
+*
+* @details The ten rounds of Philox4x32 run on 32 bit words in 64 bit lanes,
+*          since SSE and AVX only multiply 32 bit words into 64 bit products.
+*          Only the low 32 bits of the words are kept in order.
+*
+* @param[in]  stream    Stream of the caller, from newStream()
+* @param[in]  particles Particle IDs, one per lane
+* @param[in]  substep   Substep of the caller, which it counts itself
+* @param[out] u1        First number of each particle
+* @param[out] u2        Second number of each particle
 **/
-struct RandCache {
-	doubleV r;
-    double r1, r2
-#ifdef __AVX__
-    r3, r4
-#endif
-    ;
-    
-    RandCache(RandomNumbers &rands) :
-#ifdef __AVX__
-    r(_mm256_set_pd(rands.uniformZeroToOne(),
-                    rands.uniformZeroToOne(),
-                    rands.uniformZeroToOne(),
-                    rands.uniformZeroToOne())),
-    r1(rands.uniformZeroToTwoPi()), r2(rands.uniformZeroToTwoPi()),
-    r3(rands.uniformZeroToTwoPi()), r4(rands.uniformZeroToTwoPi()) {}
-#else
-    r(_mm_set_pd(rands.uniformZeroToOne(),
-                 rands.uniformZeroToOne())),
-    r1(rands.uniformZeroToTwoPi()), r2(rands.uniformZeroToTwoPi()) {}
-#endif
-	RandCache() 
-	: r(set1_pd(0.0)), r1(0.0), r2(0.0) 
-#ifdef __AVX__
-    r3(0.0), r4(0.0) 
-#endif
-    {}
-};
+inline void RandomNumbers::uniform_pd(const uint32_t stream, const indexV particles, const uint64_t substep,
+                                      doubleV &u1, doubleV &u2) const {
+	const indexV multiplier0 = set1_epi64(0xD2511F53), multiplier1 = set1_epi64(0xCD9E8D57);
+	indexV c0 = particles, c1 = set1_epi64(stream);
+	indexV c2 = set1_epi64((uint32_t)substep), c3 = set1_epi64((uint32_t)(substep >> 32));
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int round = 0; round < 10; round++) {
+		const indexV product0 = mulWide_epu32(multiplier0, c0);
+		const indexV product1 = mulWide_epu32(multiplier1, c2);
+		c0 = xor_epi64(xor_epi64(srli_epi64(product1, 32), c1), set1_epi64(k0));
+		c2 = xor_epi64(xor_epi64(srli_epi64(product0, 32), c3), set1_epi64(k1));
+		c1 = product1;
+		c3 = product0;
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+
+	// 64 bits from each pair of words, clearing the high bits of the second.
+	u1 = unitInterval_pd(or_epi64(slli_epi64(c0, 32), srli_epi64(slli_epi64(c1, 32), 32)));
+	u2 = unitInterval_pd(or_epi64(slli_epi64(c2, 32), srli_epi64(slli_epi64(c3, 32), 32)));
+}
+
+/**
+* @brief Turns two numbers uniform in [0, 1) into two independent standard
+*        gaussian numbers with the Box-Muller transform.
+*
+* @param[in]  u1 First uniform numbers
+* @param[in]  u2 Second uniform numbers
+* @param[out] g1 First gaussian numbers
+* @param[out] g2 Second gaussian numbers
+**/
+inline void RandomNumbers::gaussian_pd(const doubleV u1, const doubleV u2, doubleV &g1, doubleV &g2) {
+	// 1 - u1 is exact and in (0, 1], so the log stays finite.
+	const doubleV radius = sqrt_pd(mul_pd(log_pd(sub_pd(set1_pd(1.0), u1)), -2.0));
+	doubleV x, y;
+	direction_pd(u2, x, y);
+	g1 = mul_pd(radius, x);
+	g2 = mul_pd(radius, y);
+}
+
+/**
+* @brief Turns numbers uniform in [0, 1) into unit vectors of uniform direction.
+*
+* @param[in]  u Uniform numbers
+* @param[out] x x-components of the unit vectors
+* @param[out] y y-components of the unit vectors
+**/
+inline void RandomNumbers::direction_pd(const doubleV u, doubleV &x, doubleV &y) {
+	sincos_pd(mul_pd(u, 2.0*M_PI), y, x);
+}
 
 #endif // RANDOMNUMBERS
@@ -52,9 +52,9 @@ inline void RectConfinementForce::force(const cloud_index currentParticle,
                                         const doubleV currentPositionY) {
 	const doubleV charge = load_pd(cloud->charge + currentParticle); 
 	
-	plusEqual_pd(cloud->forceX + currentParticle, 
+	plusEqual_pd(targetX + currentParticle, 
                  mul_pd(mul_pd(charge, confineX), currentPositionX));
-	plusEqual_pd(cloud->forceY + currentParticle, 
+	plusEqual_pd(targetY + currentParticle, 
                  mul_pd(mul_pd(charge, confineY), currentPositionY));
 }
 
@@ -0,0 +1,176 @@
+/**
+* @file  Respa.cpp
+* @class Respa Respa.h
+*
+* @brief Implementation of the reversible reference system propagator (RESPA),
+*        which integrates slowly changing forces with a longer timestep than
+*        the rest
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "Respa.h"
+#include "NearCoulombForce.h"
+#include <algorithm>
+
+/**
+* @brief Constructor for the Respa class
+*
+* @details With a split radius, the coulomb force of pairs closer than the
+*          radius is moved from the slow to the fast level by subtracting it on
+*          the slow level and adding it on the fast level.
+*
+* @param[in] C                 Cloud object
+* @param[in] FA                Array of all forces
+* @param[in] slow              Forces of FA integrated with the slow timestep
+* @param[in] timeStep          Fast timestep
+* @param[in] startTime         Simulation start time
+* @param[in] fastSteps         Fast timesteps per slow timestep
+* @param[in] splitRadius       Radius of the coulomb split, 0 for none [m]
+* @param[in] shieldingConstant Inverse of shielding distance used by the split [m^-1]
+**/
+Respa::Respa(Cloud * const C, const ForceArray &FA, const ForceArray &slow,
+             const double timeStep, const double startTime, const cloud_index fastSteps,
+             const double splitRadius, const double shieldingConstant)
+: Integrator(C, FA, timeStep, startTime), slowForces(slow), numFastSteps(fastSteps), slowCurrent(false),
+oddSlowSubstep(true), oddFastSubstep(true), numReorders(0), numSlowEvaluations(0), numFastEvaluations(0) {
+	C->allocateSlopes(2);
+	for (Force * const F : FA)
+		if (std::find(slow.begin(), slow.end(), F) == slow.end())
+			fastForces.push_back(F);
+
+	if (splitRadius > 0.0) {
+		splitForces.push_back(new NearCoulombForce(C, shieldingConstant, splitRadius, 1.0));
+		fastForces.push_back(splitForces.back());
+		splitForces.push_back(new NearCoulombForce(C, shieldingConstant, splitRadius, -1.0));
+		slowForces.push_back(splitForces.back());
+	}
+}
+
+/**
+* @brief Destructor for the Respa class
+**/
+Respa::~Respa() {
+	for (Force * const F : splitForces)
+		delete F;
+}
+
+/**
+* @brief Moves particles forward with a velocity Verlet step of the slow forces
+*        around numFastSteps velocity Verlet steps of the fast forces.
+*
+* @details The slow accelerations are kept in k1 and m1, the fast ones in k2 and
+*          m2. The slow accelerations at the end of a step are those at the
+*          start of the next, so the slow forces are evaluated once per slow
+*          step. The fast forces are evaluated again at the start of every slow
+*          step, as velocity dependent forces belong on the fast level and the
+*          slow kick has changed the velocities. The step is time reversible for
+*          forces that only depend on the positions.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void Respa::moveParticles(const double endTime) {
+	while (currentTime < endTime) {
+		const double dt = modifyTimeStep(1.0e-4f, init_dt); // implement dynamic timstep (if necessary):
+		const double slowStep = numFastSteps*dt;
+
+		// Reordering the cloud moves the particles out from under their
+		// accelerations.
+		if (!slowCurrent || numReorders != cloud->numReorders) {
+			evaluate(slowForces, currentTime, oddSlowSubstep, cloud->k1, cloud->m1);
+			++numSlowEvaluations;
+			numReorders = cloud->numReorders;
+		}
+		kick(0.5*slowStep, cloud->k1, cloud->m1);
+
+		evaluate(fastForces, currentTime, oddFastSubstep, cloud->k2, cloud->m2);
+		++numFastEvaluations;
+		for (cloud_index step = 1; step <= numFastSteps; step++) {
+			kickDrift(dt, cloud->k2, cloud->m2);
+			evaluate(fastForces, currentTime + step*dt, oddFastSubstep, cloud->k2, cloud->m2);
+			++numFastEvaluations;
+			kick(0.5*dt, cloud->k2, cloud->m2);
+		}
+
+		evaluate(slowForces, currentTime + slowStep, oddSlowSubstep, cloud->k1, cloud->m1);
+		++numSlowEvaluations;
+		slowCurrent = true;
+		kick(0.5*slowStep, cloud->k1, cloud->m1);
+
+		currentTime += slowStep;
+	}
+}
+
+/**
+* @brief Computes the accelerations of one level of forces at the current
+*        positions and velocities.
+*
+* @param[in]     level         Forces to evaluate
+* @param[in]     time          Time of the positions
+* @param[in,out] oddSubstep    Substep parity of the level
+* @param[out]    accelerationX x-accelerations
+* @param[out]    accelerationY y-accelerations
+**/
+void Respa::evaluate(const ForceArray &level, const double time, bool &oddSubstep,
+                     double * const accelerationX, double * const accelerationY) const {
+	evaluateForces(level, time, oddSubstep);
+
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		store_pd(accelerationX + i, div_pd(load_pd(pFx), vmass));
+		store_pd(accelerationY + i, div_pd(load_pd(pFy), vmass));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Changes the velocities by the given accelerations over dt.
+*
+* @param[in] dt            Time over which the accelerations act
+* @param[in] accelerationX x-accelerations
+* @param[in] accelerationY y-accelerations
+**/
+void Respa::kick(const double dt, const double * const accelerationX, const double * const accelerationY) const {
+	const doubleV vdt = set1_pd(dt);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		plusEqual_pd(cloud->Vx + i, mul_pd(vdt, load_pd(accelerationX + i)));
+		plusEqual_pd(cloud->Vy + i, mul_pd(vdt, load_pd(accelerationY + i)));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Changes the velocities by the given accelerations over dt/2, then
+*        moves the particles with the new velocities over dt.
+*
+* @param[in] dt            Fast timestep
+* @param[in] accelerationX x-accelerations
+* @param[in] accelerationY y-accelerations
+**/
+void Respa::kickDrift(const double dt, const double * const accelerationX, const double * const accelerationY) const {
+	const doubleV vdt = set1_pd(dt), halfdt = set1_pd(0.5*dt);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vx = fmadd_pd(halfdt, load_pd(accelerationX + i), load_pd(cloud->Vx + i));
+		const doubleV vy = fmadd_pd(halfdt, load_pd(accelerationY + i), load_pd(cloud->Vy + i));
+		store_pd(cloud->Vx + i, vx);
+		store_pd(cloud->Vy + i, vy);
+		plusEqual_pd(cloud->x + i, mul_pd(vdt, vx));
+		plusEqual_pd(cloud->y + i, mul_pd(vdt, vy));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Prints the number of force evaluations of each level.
+*
+* @param[in] out Stream to print to
+**/
+void Respa::printStatistics(std::ostream &out) const {
+	Integrator::printStatistics(out);
+	out << "RESPA: " << numSlowEvaluations << " slow and " << numFastEvaluations << " fast force evaluations ("
+	<< numFastSteps << " fast steps per slow step)." << std::endl;
+}
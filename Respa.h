@@ -0,0 +1,42 @@
+/**
+* @file  Respa.h
+* @brief Defines the data and methods of the Respa class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef RESPA_H
+#define RESPA_H
+
+#include "Integrator.h"
+
+class Respa : public Integrator {
+public:
+	Respa(Cloud * const C, const ForceArray &FA, const ForceArray &slow,
+	      const double timeStep, const double startTime, const cloud_index fastSteps,
+	      const double splitRadius, const double shieldingConstant);
+	~Respa();
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	ForceArray fastForces;            //!< Forces integrated with every timestep
+	ForceArray slowForces;            //!< Forces integrated every numFastSteps timesteps
+	ForceArray splitForces;           //!< Near coulomb forces owned by the integrator
+	const cloud_index numFastSteps;   //!< Fast timesteps per slow timestep
+	bool slowCurrent;                 //!< True if the slow accelerations are those of the current positions
+	bool oddSlowSubstep;              //!< Substep parity of the slow forces
+	bool oddFastSubstep;              //!< Substep parity of the fast forces
+	unsigned long numReorders;        //!< Cloud reorders the slow accelerations belong to
+	unsigned long numSlowEvaluations; //!< Number of slow force evaluations
+	unsigned long numFastEvaluations; //!< Number of fast force evaluations
+
+	void evaluate(const ForceArray &level, const double time, bool &oddSubstep,
+	              double * const accelerationX, double * const accelerationY) const;
+	void kick(const double dt, const double * const accelerationX, const double * const accelerationY) const;
+	void kickDrift(const double dt, const double * const accelerationX, const double * const accelerationY) const;
+};
+
+#endif // RESPA_H
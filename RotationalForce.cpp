@@ -61,8 +61,8 @@ inline void RotationalForce::force(const cloud_index currentParticle,
 	doubleV cRotConst = select_pd(mask, rotationalConst, 0.0);
 	
 	// force in theta direction:
-	minusEqual_pd(cloud->forceX + currentParticle, div_pd(mul_pd(cRotConst, currentPositionY), dustRadV));
-	plusEqual_pd(cloud->forceY + currentParticle, div_pd(mul_pd(cRotConst, currentPositionX), dustRadV));
+	minusEqual_pd(targetX + currentParticle, div_pd(mul_pd(cRotConst, currentPositionY), dustRadV));
+	plusEqual_pd(targetY + currentParticle, div_pd(mul_pd(cRotConst, currentPositionX), dustRadV));
 }
 
 void RotationalForce::writeForce(fitsfile * const file, int * const error) const {
@@ -20,11 +20,11 @@ public:
 	virtual void moveParticles(const double endTime);
     
 protected:
-	void operate1(const double currentTime) const; // rk substep 1
-	void operate2(const double currentTime) const; // rk substep 2
-    
 	void force1(const double currentTime) const; // rk substep 1
 	void force2(const double currentTime) const; // rk substep 2
+
+	void halfStep(const double dt) const; // cache the midpoint
+	void fullStep(const double dt) const; // advance the state
 };
 
 #endif // RUNGE_KUTTA2_H
@@ -12,128 +12,190 @@
 
 Runge_Kutta4::Runge_Kutta4(Cloud * const C, const ForceArray &FA, 
                            const double timeStep, const double startTime)
-: Runge_Kutta2(C, FA, timeStep, startTime) {}
+: Runge_Kutta2(C, FA, timeStep, startTime) {
+	C->allocateSlopes(3);
+}
 
 
 /**
 * @brief Moves particles forward based on 4th order Runge-Kutta method
 *
+* @details One team of threads runs the whole loop, so the stages and forces
+*          share it instead of starting a team for each of their loops.
+*
 * @param[in] endTime Final time of the simulation
 **/
 void Runge_Kutta4::moveParticles(const double endTime) {
+	BEGIN_PARALLEL_REGION
 	while (currentTime < endTime) {
 		const double dt = modifyTimeStep(1.0e-4f, init_dt); // implement dynamic timstep (if necessary):
-		const doubleV vdt = set1_pd(dt); // store timestep as vector const
-		
-		const cloud_index numParticles = cloud->n;
-        
-		operate1(currentTime);
-		force1(currentTime); // compute net force1
-		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static) // calculate k1 and l1 for entire cloud
-			const doubleV vmass = load_pd(cloud->mass + i);
-
-			// assign force pointers for stylistic purposes:
-			double * const pFx = cloud->forceX + i;
-			double * const pFy = cloud->forceY + i;
-           
-            store_pd(cloud->k1 + i, div_pd(mul_pd(vdt, load_pd(pFx)), vmass)); // velocityX tidbit
-            store_pd(cloud->l1 + i, mul_pd(vdt, cloud->getVx1_pd(i))); // positionX tidbit
-            store_pd(cloud->m1 + i, div_pd(mul_pd(vdt, load_pd(pFy)), vmass)); // velocityY tidbit
-            store_pd(cloud->n1 + i, mul_pd(vdt, cloud->getVy1_pd(i))); // positionY tidbit
-
-			// reset forces to zero:
-			store_pd(pFx, set0_pd());
-			store_pd(pFy, set0_pd());
-		END_PARALLEL_FOR
-        
-		operate2(currentTime + dt/2.0);
-		force2(currentTime + dt/2.0); // compute net force2
-		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static) // calculate k2 and l2 for entire cloud
-            const doubleV vmass = load_pd(cloud->mass + i);
-
-			// assign force pointers:
-			double * const pFx = cloud->forceX + i;
-			double * const pFy = cloud->forceY + i;
 
-            store_pd(cloud->k2 + i, div_pd(mul_pd(vdt, load_pd(pFx)), vmass)); // velocityX tidbit
-            store_pd(cloud->l2 + i, mul_pd(vdt, cloud->getVx2_pd(i))); // positionX tidbit
-            store_pd(cloud->m2 + i, div_pd(mul_pd(vdt, load_pd(pFy)), vmass)); // velocityY tidbit
-            store_pd(cloud->n2 + i, mul_pd(vdt, cloud->getVy2_pd(i))); // positionY tidbit
+		force1(currentTime); // compute net force1
+		stage1(dt); // calculate k1 and cache the state for force2
 
-			// reset forces to zero:
-			store_pd(pFx, set0_pd());
-			store_pd(pFy, set0_pd());
-		END_PARALLEL_FOR
+		force2(currentTime + dt/2.0); // compute net force2
+		stage2(dt); // calculate k2 and cache the state for force3
 
-		operate3(currentTime + dt/2.0);
 		force3(currentTime + dt/2.0); // compute net force3
-		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static) // calculate k3 and l3 for entire cloud
-			const doubleV vmass = load_pd(cloud->mass + i);
-
-			// assign force pointers:
-			double * const pFx = cloud->forceX + i;
-			double * const pFy = cloud->forceY + i;
-
-			store_pd(cloud->k3 + i, div_pd(mul_pd(vdt, load_pd(pFx)), vmass)); // velocityX tidbit
-			store_pd(cloud->l3 + i, mul_pd(vdt, cloud->getVx3_pd(i))); // positionX tidbit
-			store_pd(cloud->m3 + i, div_pd(mul_pd(vdt, load_pd(pFy)), vmass)); // velocityY tidbit
-			store_pd(cloud->n3 + i, mul_pd(vdt, cloud->getVy3_pd(i))); // positionY tidbit
-			
-			// reset forces to zero:
-			store_pd(pFx, set0_pd());
-			store_pd(pFy, set0_pd());
-		END_PARALLEL_FOR
-        
-		operate4(currentTime + dt);
+		stage3(dt); // calculate k3 and cache the state for force4
+
 		force4(currentTime + dt); // compute net force4
-		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static) // calculate k4 and l4 for entire cloud
-			const doubleV vmass = load_pd(cloud->mass + i);
-
-			// assign force pointers:
-			double * const pFx = cloud->forceX + i;
-			double * const pFy = cloud->forceY + i;
-            
-			store_pd(cloud->k4 + i, div_pd(mul_pd(vdt, load_pd(pFx)), vmass)); // velocityX tidbit
-			store_pd(cloud->l4 + i, mul_pd(vdt, cloud->getVx4_pd(i))); // positionX tidbit
-			store_pd(cloud->m4 + i, div_pd(mul_pd(vdt, load_pd(pFy)), vmass)); // velocityY tidbit
-			store_pd(cloud->n4 + i, mul_pd(vdt, cloud->getVy4_pd(i))); // positionY tidbit
-			
-			// reset forces to zero:
-			store_pd(pFx, set0_pd());
-			store_pd(pFy, set0_pd());
-		END_PARALLEL_FOR
-
-        // Calculate next position and next velocity for entire cloud.
-        BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static)
-			const doubleV vk1 = load_pd(cloud->k1 + i);
-			const doubleV vk2 = load_pd(cloud->k2 + i);
-			const doubleV vk3 = load_pd(cloud->k3 + i);
-			const doubleV vk4 = load_pd(cloud->k4 + i);
-
-			const doubleV vl1 = load_pd(cloud->l1 + i);
-			const doubleV vl2 = load_pd(cloud->l2 + i);
-			const doubleV vl3 = load_pd(cloud->l3 + i);
-			const doubleV vl4 = load_pd(cloud->l4 + i);
-
-			const doubleV vm1 = load_pd(cloud->m1 + i);
-			const doubleV vm2 = load_pd(cloud->m2 + i);
-			const doubleV vm3 = load_pd(cloud->m3 + i);
-			const doubleV vm4 = load_pd(cloud->m4 + i);
-
-			const doubleV vn1 = load_pd(cloud->n1 + i);
-			const doubleV vn2 = load_pd(cloud->n2 + i);
-			const doubleV vn3 = load_pd(cloud->n3 + i);
-			const doubleV vn4 = load_pd(cloud->n4 + i);
-
-			// calculate next positions and velocities:
-			plusEqual_pd(cloud->Vx + i, da(vk1, vk2, vk3, vk4));
-			plusEqual_pd(cloud->x + i, da(vl1, vl2, vl3, vl4));
-			plusEqual_pd(cloud->Vy + i, da(vm1, vm2, vm3, vm4));
-			plusEqual_pd(cloud->y + i, da(vn1, vn2, vn3, vn4));
-		END_PARALLEL_FOR
-
-		currentTime += dt;
+		stage4(dt); // calculate next position and next velocity
+
+		BEGIN_SERIAL
+			currentTime += dt;
+		END_SERIAL
 	}
+	END_PARALLEL_REGION
+}
+
+/**
+* @brief Stores the velocity increments k1 and m1, caches the state at the
+*        midpoint of the first slope and resets the forces, in one pass.
+*
+* @details The position increments are dt times the velocities of the
+*          previous stage, so they are not stored; stage4() rebuilds their sum
+*          from the velocity increments.
+*
+* @param[in] dt Timestep
+**/
+void Runge_Kutta4::stage1(const double dt) const {
+	const doubleV vdt = set1_pd(dt), halfdt = set1_pd(0.5*dt), halfv = set1_pd(0.5);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		const doubleV vx = load_pd(cloud->Vx + i);
+		const doubleV vy = load_pd(cloud->Vy + i);
+
+		// assign force pointers for stylistic purposes:
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+
+		const doubleV vk1 = div_pd(mul_pd(vdt, load_pd(pFx)), vmass); // velocityX tidbit
+		const doubleV vm1 = div_pd(mul_pd(vdt, load_pd(pFy)), vmass); // velocityY tidbit
+		store_pd(cloud->k1 + i, vk1);
+		store_pd(cloud->m1 + i, vm1);
+
+		const cloud_index v = i/DOUBLE_STRIDE;
+		cloud->xCache[v] = fmadd_pd(halfdt, vx, load_pd(cloud->x + i)); // x + l1/2
+		cloud->yCache[v] = fmadd_pd(halfdt, vy, load_pd(cloud->y + i)); // y + n1/2
+		cloud->VxCache[v] = fmadd_pd(halfv, vk1, vx); // Vx + k1/2
+		cloud->VyCache[v] = fmadd_pd(halfv, vm1, vy); // Vy + m1/2
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Stores the velocity increments k2 and m2, caches the state at the
+*        midpoint of the second slope and resets the forces, in one pass.
+*
+* @param[in] dt Timestep
+**/
+void Runge_Kutta4::stage2(const double dt) const {
+	const doubleV vdt = set1_pd(dt), halfdt = set1_pd(0.5*dt), halfv = set1_pd(0.5);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+
+		// assign force pointers:
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+
+		const doubleV vk2 = div_pd(mul_pd(vdt, load_pd(pFx)), vmass); // velocityX tidbit
+		const doubleV vm2 = div_pd(mul_pd(vdt, load_pd(pFy)), vmass); // velocityY tidbit
+		store_pd(cloud->k2 + i, vk2);
+		store_pd(cloud->m2 + i, vm2);
+
+		// the cache still holds the velocities of stage 2:
+		const cloud_index v = i/DOUBLE_STRIDE;
+		cloud->xCache[v] = fmadd_pd(halfdt, cloud->VxCache[v], load_pd(cloud->x + i)); // x + l2/2
+		cloud->yCache[v] = fmadd_pd(halfdt, cloud->VyCache[v], load_pd(cloud->y + i)); // y + n2/2
+		cloud->VxCache[v] = fmadd_pd(halfv, vk2, load_pd(cloud->Vx + i)); // Vx + k2/2
+		cloud->VyCache[v] = fmadd_pd(halfv, vm2, load_pd(cloud->Vy + i)); // Vy + m2/2
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Stores the velocity increments k3 and m3, caches the state at the end
+*        of the third slope and resets the forces, in one pass.
+*
+* @param[in] dt Timestep
+**/
+void Runge_Kutta4::stage3(const double dt) const {
+	const doubleV vdt = set1_pd(dt);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+
+		// assign force pointers:
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+
+		const doubleV vk3 = div_pd(mul_pd(vdt, load_pd(pFx)), vmass); // velocityX tidbit
+		const doubleV vm3 = div_pd(mul_pd(vdt, load_pd(pFy)), vmass); // velocityY tidbit
+		store_pd(cloud->k3 + i, vk3);
+		store_pd(cloud->m3 + i, vm3);
+
+		// the cache still holds the velocities of stage 3:
+		const cloud_index v = i/DOUBLE_STRIDE;
+		cloud->xCache[v] = fmadd_pd(vdt, cloud->VxCache[v], load_pd(cloud->x + i)); // x + l3
+		cloud->yCache[v] = fmadd_pd(vdt, cloud->VyCache[v], load_pd(cloud->y + i)); // y + n3
+		cloud->VxCache[v] = add_pd(load_pd(cloud->Vx + i), vk3); // Vx + k3
+		cloud->VyCache[v] = add_pd(load_pd(cloud->Vy + i), vm3); // Vy + m3
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Computes the last velocity increments, moves the particles and resets
+*        the forces, in one pass.
+*
+* @details With l1 = dt*Vx, l2 = dt*(Vx + k1/2), l3 = dt*(Vx + k2/2) and
+*          l4 = dt*(Vx + k3), the position increment (l1 + 2*(l2 + l3) + l4)/6
+*          is dt*(Vx + (k1 + k2 + k3)/6).
+*
+* @param[in] dt Timestep
+**/
+void Runge_Kutta4::stage4(const double dt) const {
+	const doubleV vdt = set1_pd(dt), sixthv = set1_pd(1.0/6.0);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+
+		// assign force pointers:
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+
+		const doubleV vk1 = load_pd(cloud->k1 + i);
+		const doubleV vk2 = load_pd(cloud->k2 + i);
+		const doubleV vk3 = load_pd(cloud->k3 + i);
+		const doubleV vk4 = div_pd(mul_pd(vdt, load_pd(pFx)), vmass); // velocityX tidbit
+
+		const doubleV vm1 = load_pd(cloud->m1 + i);
+		const doubleV vm2 = load_pd(cloud->m2 + i);
+		const doubleV vm3 = load_pd(cloud->m3 + i);
+		const doubleV vm4 = div_pd(mul_pd(vdt, load_pd(pFy)), vmass); // velocityY tidbit
+
+		// calculate next positions and velocities:
+		double * const pVx = cloud->Vx + i;
+		double * const pVy = cloud->Vy + i;
+		const doubleV vx = load_pd(pVx);
+		const doubleV vy = load_pd(pVy);
+		plusEqual_pd(cloud->x + i, mul_pd(vdt, fmadd_pd(sixthv, add_pd(vk1, add_pd(vk2, vk3)), vx)));
+		plusEqual_pd(cloud->y + i, mul_pd(vdt, fmadd_pd(sixthv, add_pd(vm1, add_pd(vm2, vm3)), vy)));
+		store_pd(pVx, add_pd(vx, da(vk1, vk2, vk3, vk4)));
+		store_pd(pVy, add_pd(vy, da(vm1, vm2, vm3, vm4)));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
 }
 
 /**
@@ -150,22 +212,10 @@ inline const doubleV Runge_Kutta4::da(const doubleV a1, const doubleV a2,
     return div_pd(add_pd(a1, add_pd(mul_pd(add_pd(a2, a3), 2.0), a4)), 6.0);
 }
 
-inline void Runge_Kutta4::operate3(const double time) const {
- 	for (Operator * const O : operations)
-		O->operation3(time);
-}
-
-inline void Runge_Kutta4::operate4(const double time) const {
- 	for (Operator * const O : operations)
-		O->operation4(time);
-}
-
 inline void Runge_Kutta4::force3(const double time) const {
-	for (Force * const F : forces)
-		F->force3(time);
+	runForces(forces, &Force::force3, time);
 }
 
 inline void Runge_Kutta4::force4(const double time) const {
-	for (Force * const F : forces)
-		F->force4(time);
+	runForces(forces, &Force::force4, time);
 }
@@ -19,12 +19,14 @@ public:
 
 	void moveParticles(const double endTime);
 
-private:
-	void operate3(const double currentTime) const; // rk substep 3
-	void operate4(const double currentTime) const; // rk substep 4
-  
+protected:
 	void force3(const double currentTime) const; // rk substep 3
 	void force4(const double currentTime) const; // rk substep 4
+
+	void stage1(const double dt) const; // k1 and the cache for force2
+	void stage2(const double dt) const; // k2 and the cache for force3
+	void stage3(const double dt) const; // k3 and the cache for force4
+	void stage4(const double dt) const; // k4 and the next state
     
     static const doubleV da(const doubleV a1, const doubleV a2, 
                             const doubleV a3, const doubleV a4);
@@ -10,230 +10,905 @@
 **/
 
 #include "ShieldedCoulombForce.h"
+#include <algorithm>
 #include <cmath>
 
-#ifdef DISPATCH_QUEUES
-#define LOOP_END(num) num
-#else
-#define LOOP_END(num) num - 1
-#endif
-
 const double ShieldedCoulombForce::coulomb = 1.0/(4.0*M_PI*Cloud::epsilon0);
+const cloud_index ShieldedCoulombForce::tileSize;
 
-ShieldedCoulombForce::ShieldedCoulombForce(Cloud * const C, const double shieldingConstant)
-: Force(C), shielding(shieldingConstant) SEMAPHORES_MALLOC(C->n/DOUBLE_STRIDE) {
+ShieldedCoulombForce::ShieldedCoulombForce(Cloud * const C, const double shieldingConstant,
+                                           const PairSearch search, const double neighborSkin,
+                                           const ForceAccumulation accumulationMethod, const unsigned tableResolution,
+                                           const ForcePrecision pairPrecision)
+: Force(C), shielding(shieldingConstant),
+table(tableResolution ? new YukawaTable(shielding, tableResolution) : NULL),
+cells(search == CellListSearch ? new CellList(C->n) : NULL),
+cellCharge(search == CellListSearch ? new double[C->n + DOUBLE_STRIDE]() : NULL),
+neighbors(search == NeighborListSearch ? new NeighborList(C->n, neighborSkin) : NULL), numReorders(0),
+numTiles(search == TiledSearch ? (C->n + tileSize - 1)/tileSize : 0),
+tileBounds(numTiles ? new double[4*numTiles] : NULL),
+accumulation(accumulationMethod), precision(pairPrecision), pairBlocks(C->n),
+numBuffers(accumulation == PrivateAccumulation ? NUM_THREADS : 0),
+bufferX(numBuffers ? alignedNew<double>(numBuffers*C->n) : NULL),
+bufferY(numBuffers ? alignedNew<double>(numBuffers*C->n) : NULL)
+SEMAPHORES_MALLOC(C->n/DOUBLE_STRIDE) {
     SEMAPHORES_INIT(cloud->n/DOUBLE_STRIDE)
+    if (numBuffers) {
+        std::fill(bufferX, bufferX + numBuffers*cloud->n, 0.0);
+        std::fill(bufferY, bufferY + numBuffers*cloud->n, 0.0);
+    }
 }
 ShieldedCoulombForce::~ShieldedCoulombForce() {
+    delete table;
+    delete cells;
+    delete[] cellCharge;
+    delete neighbors;
+    delete[] tileBounds;
+    alignedDelete(bufferX);
+    alignedDelete(bufferY);
     SEMAPHORES_FREE(cloud->n/DOUBLE_STRIDE)
 }
 
-/**
-* @bug FIXME: When changing this over to AVX to simplify, change force methods to
-* 	   triangle and block forces. Triangle forces cover the outter loop force. Block
-*      covers the inner loop forces. AVX specific differences would go into that 
-*      section.
-**/
 void ShieldedCoulombForce::force1(const double currentTime) {
-#ifdef __AVX__
-#error "ShieldedCoulombForce::force1 does not fully support AVX."
-#endif
     (void)currentTime;
-    const cloud_index numParticles = cloud->n;
-    BEGIN_PARALLEL_FOR(currentParticle, e, LOOP_END(numParticles), DOUBLE_STRIDE, dynamic)
-        const doubleV vx1 = cloud->getx1_pd(currentParticle);
-        const doubleV vy1 = cloud->gety1_pd(currentParticle);
-        const doubleV vq1 = load_pd(cloud->charge + currentParticle);
-        double q1, q2;
-        _mm_storel_pd(&q1, vq1);
-        _mm_storeh_pd(&q2, vq1);
-                 
-        force(currentParticle, q1*q2, _mm_hsub_pd(vx1, vy1));
-        for (cloud_index i = currentParticle + DOUBLE_STRIDE; i < numParticles; i += DOUBLE_STRIDE) {
-			double * const c = cloud->charge + i;
-            force(currentParticle, i, mul_pd(vq1, load_pd(c)), sub_pd(vx1, cloud->getx1_pd(i)), sub_pd(vy1, cloud->gety1_pd(i)));
-            forcer(currentParticle, i, mul_pd(vq1, _mm_loadr_pd(c)), sub_pd(vx1, cloud->getx1r_pd(i)), sub_pd(vy1, cloud->gety1r_pd(i)));
-        }
-    END_PARALLEL_FOR
+    force(cloud->x, cloud->y);
 }
 
 void ShieldedCoulombForce::force2(const double currentTime) {
-#ifdef __AVX__
-#error "ShieldedCoulombForce::force2 does not fully support AVX."
-#endif
     (void)currentTime;
+    force((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void ShieldedCoulombForce::force3(const double currentTime) {
+    (void)currentTime;
+    force((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void ShieldedCoulombForce::force4(const double currentTime) {
+    (void)currentTime;
+    force((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+/**
+* @brief Computes the pair forces of one substep with the selected pair search
+*        and accumulation.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void ShieldedCoulombForce::force(const double * const x, const double * const y) {
+    if (cells) {
+        cellForce(x, y);
+        return;
+    }
+    if (neighbors) {
+        neighborForce(x, y);
+        return;
+    }
+    if (tileBounds) {
+        tiledForce(x, y);
+        return;
+    }
+    if (precision == MixedPrecision) {
+        mixedForce(x, y);
+        return;
+    }
+    if (accumulation == PrivateAccumulation) {
+        privateForce(x, y);
+        return;
+    }
+    if (accumulation == GatherAccumulation) {
+        gatherAllForce(x, y);
+        return;
+    }
+    lockForce(x, y);
+}
+
+/**
+* @brief Adds the force on the given particles only.
+*
+* @details Each given particle gathers the force of its partners like
+*          cellForce and neighborForce, from its neighboring cells or its
+*          neighbor list when these searches are used and from every particle
+*          otherwise. The cost is proportional to the number of given particles,
+*          apart from rebuilding the cells.
+*
+* @param[in] currentTime The current time of the simulation
+* @param[in] active      Indices of the particles
+* @param[in] numActive   Number of particles
+*
+* @return True
+**/
+bool ShieldedCoulombForce::activeForce(const double currentTime, const cloud_index * const active,
+                                       const cloud_index numActive) {
+	(void)currentTime;
+	const double * const x = cloud->x;
+	const double * const y = cloud->y;
+	const double * const charge = cloud->charge;
 	const cloud_index numParticles = cloud->n;
-    BEGIN_PARALLEL_FOR(currentParticle, e, LOOP_END(numParticles), DOUBLE_STRIDE, dynamic)
-		const doubleV vx1 = cloud->getx2_pd(currentParticle);
-		const doubleV vy1 = cloud->gety2_pd(currentParticle);
-		const doubleV vq1 = load_pd(cloud->charge + currentParticle);
-        double q1, q2;
-        _mm_storel_pd(&q1, vq1);
-        _mm_storeh_pd(&q2, vq1);
-    
-        force(currentParticle, q1*q2, _mm_hsub_pd(vx1, vy1));
-		for (cloud_index i = currentParticle + DOUBLE_STRIDE; i < numParticles; i += DOUBLE_STRIDE) {
-			double * const c = cloud->charge + i;
-			force(currentParticle, i, mul_pd(vq1, load_pd(c)), sub_pd(vx1, cloud->getx2_pd(i)), sub_pd(vy1, cloud->gety2_pd(i)));
-			forcer(currentParticle, i, mul_pd(vq1, _mm_loadr_pd(c)), sub_pd(vx1, cloud->getx2r_pd(i)), sub_pd(vy1, cloud->gety2r_pd(i)));
+	if (cells) {
+		cells->build(x, y, 10.0/shielding);
+		BEGIN_PARALLEL_FOR(p, e, numParticles, 1, static)
+			cellCharge[p] = charge[cells->particles[p]];
+		END_PARALLEL_FOR
+	} else if (neighbors) {
+		BEGIN_SERIAL
+			if (numReorders != cloud->numReorders) {
+				neighbors->invalidate();
+				numReorders = cloud->numReorders;
+			}
+		END_SERIAL
+		neighbors->update(x, y, 10.0/shielding);
+	}
+
+	const doubleV allLanes = cmplt_pd(laneIndex_pd(), (double)DOUBLE_STRIDE);
+	BEGIN_PARALLEL_FOR(a, e, numActive, 1, dynamic)
+		const cloud_index currentParticle = active[a];
+		const doubleV vx1 = set1_pd(x[currentParticle]);
+		const doubleV vy1 = set1_pd(y[currentParticle]);
+		doubleV forcevX = set0_pd(), forcevY = set0_pd();
+
+		if (cells) {
+			const cloud_index cell = cells->cell(x[currentParticle], y[currentParticle]);
+			const cloud_index cx = cell%cells->numCellsX, cy = cell/cells->numCellsX;
+			for (cloud_index row = cy ? cy - 1 : 0, lastRow = std::min(cy + 1, cells->numCellsY - 1); row <= lastRow; row++)
+				for (cloud_index j = cells->rowBegin(cx, row), end = cells->rowEnd(cx, row); j < end; j += DOUBLE_STRIDE)
+					gatherForce(vx1, vy1, loadu_pd(cells->sortedX + j), loadu_pd(cells->sortedY + j), loadu_pd(cellCharge + j),
+					            cmplt_pd(laneIndex_pd(), (double)(end - j)), forcevX, forcevY);
+		} else if (neighbors) {
+			const cloud_index * const list = neighbors->neighbors.data();
+			for (cloud_index j = neighbors->neighborStart[currentParticle], end = neighbors->neighborStart[currentParticle + 1];
+			     j < end; j += DOUBLE_STRIDE)
+				gatherForce(vx1, vy1, gather_pd(x, list + j), gather_pd(y, list + j), gather_pd(charge, list + j),
+				            cmplt_pd(laneIndex_pd(), (double)(end - j)), forcevX, forcevY);
+		} else {
+			for (cloud_index j = 0; j < numParticles; j += DOUBLE_STRIDE)
+				gatherForce(vx1, vy1, load_pd(x + j), load_pd(y + j), load_pd(charge + j), allLanes, forcevX, forcevY);
 		}
+
+		const double q1 = coulomb*charge[currentParticle];
+		targetX[currentParticle] += q1*sum_pd(forcevX);
+		targetY[currentParticle] += q1*sum_pd(forcevY);
 	END_PARALLEL_FOR
+	return true;
 }
 
-void ShieldedCoulombForce::force3(const double currentTime) {
-#ifdef __AVX__
-#error "ShieldedCoulombForce::force3 does not fully support AVX."
-#endif
-    (void)currentTime;
-    const cloud_index numParticles = cloud->n;
-    BEGIN_PARALLEL_FOR(currentParticle, e, LOOP_END(numParticles), DOUBLE_STRIDE, dynamic)
-		const doubleV vx1 = cloud->getx3_pd(currentParticle);
-		const doubleV vy1 = cloud->gety3_pd(currentParticle);
-		const doubleV vq1 = load_pd(cloud->charge + currentParticle);
-        double q1, q2;
-        _mm_storel_pd(&q1, vq1);
-        _mm_storeh_pd(&q2, vq1);
-    
-        force(currentParticle, q1*q2, _mm_hsub_pd(vx1, vy1));
-		for (cloud_index i = currentParticle + DOUBLE_STRIDE; i < numParticles; i += DOUBLE_STRIDE) {
-			double * const c = cloud->charge + i;
-			force(currentParticle, i, mul_pd(vq1, load_pd(c)), sub_pd(vx1, cloud->getx3_pd(i)), sub_pd(vy1, cloud->gety3_pd(i)));
-			forcer(currentParticle, i, mul_pd(vq1, _mm_loadr_pd(c)), sub_pd(vx1, cloud->getx3r_pd(i)), sub_pd(vy1, cloud->gety3r_pd(i)));
+/**
+* @brief Calculates the interaction of a vector of pairs with form
+*        F_i,j = e0*q_i*q_j/(|r_i - r_j|)^2*Exp(-s*|r_i - r_j|)*(1 + c*|r_i - r_j|)
+*
+* @param[in]  charges       Vector of products of the pair charges
+* @param[in]  displacementX Vector of x-direction displacements
+* @param[in]  displacementY Vector of y-direction displacements
+* @param[out] forcevX       x-force on the first particle of each pair
+* @param[out] forcevY       y-force on the first particle of each pair
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::pairForce(const doubleV charges, const doubleV displacementX, const doubleV displacementY,
+                                            doubleV &forcevX, doubleV &forcevY) const {
+	const doubleV displacement2 = add_pd(mul_pd(displacementX, displacementX), mul_pd(displacementY, displacementY));
+	if (table) {
+		const doubleV inRange = cmplt_pd(displacement2, table->cutoff2);
+		if (!movemask_pd(inRange))
+			return false;
+
+		const doubleV forceC = and_pd(inRange, mul_pd(mul_pd(set1_pd(coulomb), charges), table->lookup(inRange, displacement2)));
+		forcevX = mul_pd(forceC, displacementX);
+		forcevY = mul_pd(forceC, displacementY);
+		return true;
+	}
+
+	// Calculate displacement between particles.
+	const doubleV displacement = sqrt_pd(displacement2);
+	const doubleV valExp = mul_pd(displacement, shielding);
+
+	const doubleV inRange = cmplt_pd(valExp, 10.0);
+	if (!movemask_pd(inRange))
+		return false;
+
+	// calculate force
+	const doubleV forceC = div_pd(mul_pd(mul_pd(mul_pd(set1_pd(coulomb), charges), add_pd(set1_pd(1.0), valExp)), 
+	                                     exp_pd(inRange, sub_pd(set0_pd(), valExp))),
+	                              mul_pd(mul_pd(displacement, displacement), displacement));
+	forcevX = mul_pd(forceC, displacementX);
+	forcevY = mul_pd(forceC, displacementY);
+	return true;
+}
+
+/**
+* @brief Calculates the interactions between the particles of one vector.
+*
+* @details Lane i is paired with lane i + r for every rotation r of the vector.
+*          Every lane gets its own force, so each pair is computed twice and no
+*          equal and opposite force has to be added.
+*
+* @param[in]  vx1     x-positions of the particles
+* @param[in]  vy1     y-positions of the particles
+* @param[in]  vq1     Charges of the particles
+* @param[out] forcevX x-force on each particle
+* @param[out] forcevY y-force on each particle
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::triangleForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+                                                doubleV &forcevX, doubleV &forcevY) const {
+	bool interacting = false;
+	forcevX = forcevY = set0_pd();
+	doubleV vx2 = vx1, vy2 = vy1, vq2 = vq1;
+	for (int rotation = 1; rotation < DOUBLE_STRIDE; rotation++) {
+		vx2 = rotate_pd(vx2);
+		vy2 = rotate_pd(vy2);
+		vq2 = rotate_pd(vq2);
+
+		doubleV pairX, pairY;
+		if (pairForce(mul_pd(vq1, vq2), sub_pd(vx1, vx2), sub_pd(vy1, vy2), pairX, pairY)) {
+			forcevX = add_pd(forcevX, pairX);
+			forcevY = add_pd(forcevY, pairY);
+			interacting = true;
+		}
+	}
+	return interacting;
+}
+
+/**
+* @brief Calculates the interactions between the particles of two different 
+*        vectors.
+*
+* @details The second vector is rotated one lane at a time, which pairs every
+*          lane of the first vector with every lane of the second in 
+*          DOUBLE_STRIDE steps (direct and reversed for SSE, four rotations for
+*          AVX). The equal and opposite forces are rotated along, so they end up
+*          in the lane order of the second vector.
+*
+* @param[in]     vx1       x-positions of the first particles
+* @param[in]     vy1       y-positions of the first particles
+* @param[in]     vq1       Charges of the first particles
+* @param[in]     vx2       x-positions of the second particles
+* @param[in]     vy2       y-positions of the second particles
+* @param[in]     vq2       Charges of the second particles
+* @param[in,out] forcevX   Accumulated x-force on the first particles
+* @param[in,out] forcevY   Accumulated y-force on the first particles
+* @param[out]    reactionX x-force on the second particles
+* @param[out]    reactionY y-force on the second particles
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::blockForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+                                             doubleV vx2, doubleV vy2, doubleV vq2,
+                                             doubleV &forcevX, doubleV &forcevY,
+                                             doubleV &reactionX, doubleV &reactionY) const {
+	bool interacting = false;
+	reactionX = reactionY = set0_pd();
+	for (int rotation = 0; rotation < DOUBLE_STRIDE; rotation++) {
+		doubleV pairX, pairY;
+		if (pairForce(mul_pd(vq1, vq2), sub_pd(vx1, vx2), sub_pd(vy1, vy2), pairX, pairY)) {
+			forcevX = add_pd(forcevX, pairX);
+			forcevY = add_pd(forcevY, pairY);
+			// equal and opposite force:
+			reactionX = sub_pd(reactionX, pairX);
+			reactionY = sub_pd(reactionY, pairY);
+			interacting = true;
+		}
+
+		vx2 = rotate_pd(vx2);
+		vy2 = rotate_pd(vy2);
+		vq2 = rotate_pd(vq2);
+		reactionX = rotate_pd(reactionX);
+		reactionY = rotate_pd(reactionY);
+	}
+	return interacting;
+}
+
+/**
+* @brief Calculates the forces of the particles of a second vector on those of
+*        a first one, without the equal and opposite forces.
+*
+* @details Pairs the lanes like the other blockForce, for gatherAllForce, which
+*          visits every pair from both sides and has no use for the reactions.
+*
+* @param[in]     vx1     x-positions of the first particles
+* @param[in]     vy1     y-positions of the first particles
+* @param[in]     vq1     Charges of the first particles
+* @param[in]     vx2     x-positions of the second particles
+* @param[in]     vy2     y-positions of the second particles
+* @param[in]     vq2     Charges of the second particles
+* @param[in,out] forcevX Accumulated x-force on the first particles
+* @param[in,out] forcevY Accumulated y-force on the first particles
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::blockForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+                                             doubleV vx2, doubleV vy2, doubleV vq2,
+                                             doubleV &forcevX, doubleV &forcevY) const {
+	bool interacting = false;
+	for (int rotation = 0; rotation < DOUBLE_STRIDE; rotation++) {
+		doubleV pairX, pairY;
+		if (pairForce(mul_pd(vq1, vq2), sub_pd(vx1, vx2), sub_pd(vy1, vy2), pairX, pairY)) {
+			forcevX = add_pd(forcevX, pairX);
+			forcevY = add_pd(forcevY, pairY);
+			interacting = true;
+		}
+
+		vx2 = rotate_pd(vx2);
+		vy2 = rotate_pd(vy2);
+		vq2 = rotate_pd(vq2);
+	}
+	return interacting;
+}
+
+/**
+* @brief Computes all pair forces, locking each vector of particles while its
+*        forces are added.
+*
+* @details Every thread works through its own run of pair blocks from the 
+*          PairScheduler, which hold the same number of pairs for every thread.
+*          The forces of a row are added once per block.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void ShieldedCoulombForce::lockForce(const double * const x, const double * const y) {
+	const double * const charge = cloud->charge;
+	BEGIN_SERIAL
+		pairBlocks.startRun();
+	END_SERIAL
+	BEGIN_PARALLEL_FOR(thread, e, pairBlocks.numThreads, 1, static)
+		const PairScheduler::Clock::time_point start = PairScheduler::Clock::now();
+		for (cloud_index k = pairBlocks.threadStart[thread]; k < pairBlocks.threadStart[thread + 1]; k++) {
+			const PairScheduler::Block &block = pairBlocks.blocks[k];
+			for (cloud_index currentParticle = block.rowBegin; currentParticle < block.rowEnd; currentParticle += DOUBLE_STRIDE) {
+				const doubleV vx1 = load_pd(x + currentParticle);
+				const doubleV vy1 = load_pd(y + currentParticle);
+				const doubleV vq1 = load_pd(charge + currentParticle);
+				doubleV rowX = set0_pd(), rowY = set0_pd(), reactionX, reactionY;
+				bool interacting = false;
+
+				// Blocks on the diagonal start with the pairs within the row vector.
+				cloud_index i = block.columnBegin;
+				if (i <= currentParticle) {
+					interacting = triangleForce(vx1, vy1, vq1, rowX, rowY);
+					i = currentParticle + DOUBLE_STRIDE;
+				}
+
+				for (; i < block.columnEnd; i += DOUBLE_STRIDE)
+					if (blockForce(vx1, vy1, vq1, load_pd(x + i), load_pd(y + i), load_pd(charge + i),
+					               rowX, rowY, reactionX, reactionY)) {
+						interacting = true;
+						SEMAPHORE_WAIT(i/DOUBLE_STRIDE)
+						plusEqual_pd(targetX + i, reactionX);
+						plusEqual_pd(targetY + i, reactionY);
+						SEMAPHORE_SIGNAL(i/DOUBLE_STRIDE)
+					}
+
+				if (interacting) {
+					SEMAPHORE_WAIT(currentParticle/DOUBLE_STRIDE)
+					plusEqual_pd(targetX + currentParticle, rowX);
+					plusEqual_pd(targetY + currentParticle, rowY);
+					SEMAPHORE_SIGNAL(currentParticle/DOUBLE_STRIDE)
+				}
+			}
 		}
+		pairBlocks.addTime(thread, start);
 	END_PARALLEL_FOR
 }
 
-void ShieldedCoulombForce::force4(const double currentTime) {
-#ifdef __AVX__
-#error "ShieldedCoulombForce::force4 does not fully support AVX."
-#endif
-    (void)currentTime;
+/**
+* @brief Computes all pair forces without locks by giving every thread its own
+*        force buffer.
+*
+* @details The vectors of particles are dealt out to the buffers in turn, which
+*          spreads the rows of the triangular pair loop evenly. Each pair is
+*          visited once and both of its forces go to the buffer of the row, so no
+*          two threads write to the same memory. The buffers are summed by 
+*          reduceBuffers afterwards.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void ShieldedCoulombForce::privateForce(const double * const x, const double * const y) {
 	const cloud_index numParticles = cloud->n;
-    BEGIN_PARALLEL_FOR(currentParticle, e, LOOP_END(numParticles), DOUBLE_STRIDE, dynamic)
-		const doubleV vx1 = cloud->getx4_pd(currentParticle);
-		const doubleV vy1 = cloud->gety4_pd(currentParticle);
-		const doubleV vq1 = load_pd(cloud->charge + currentParticle);
-        double q1, q2;
-        _mm_storel_pd(&q1, vq1);
-        _mm_storeh_pd(&q2, vq1);
-    
-        force(currentParticle, q1*q2, _mm_hsub_pd(vx1, vy1));
-		for (cloud_index i = currentParticle + DOUBLE_STRIDE; i < numParticles; i += DOUBLE_STRIDE) {
-			double * const c = cloud->charge + i;
-			force(currentParticle, i, mul_pd(vq1, load_pd(c)), sub_pd(vx1, cloud->getx4_pd(i)), sub_pd(vy1, cloud->gety4_pd(i)));
-			forcer(currentParticle, i, mul_pd(vq1, _mm_loadr_pd(c)), sub_pd(vx1, cloud->getx4r_pd(i)), sub_pd(vy1, cloud->gety4r_pd(i)));
+	const double * const charge = cloud->charge;
+	BEGIN_PARALLEL_FOR(buffer, e, numBuffers, 1, static)
+		double * const forceX = bufferX + buffer*numParticles;
+		double * const forceY = bufferY + buffer*numParticles;
+		for (cloud_index currentParticle = buffer*DOUBLE_STRIDE; currentParticle < numParticles;
+		     currentParticle += numBuffers*DOUBLE_STRIDE) {
+			const doubleV vx1 = load_pd(x + currentParticle);
+			const doubleV vy1 = load_pd(y + currentParticle);
+			const doubleV vq1 = load_pd(charge + currentParticle);
+			doubleV rowX, rowY, reactionX, reactionY;
+			triangleForce(vx1, vy1, vq1, rowX, rowY);
+
+			for (cloud_index i = currentParticle + DOUBLE_STRIDE; i < numParticles; i += DOUBLE_STRIDE)
+				if (blockForce(vx1, vy1, vq1, load_pd(x + i), load_pd(y + i), load_pd(charge + i),
+				               rowX, rowY, reactionX, reactionY)) {
+					plusEqual_pd(forceX + i, reactionX);
+					plusEqual_pd(forceY + i, reactionY);
+				}
+
+			plusEqual_pd(forceX + currentParticle, rowX);
+			plusEqual_pd(forceY + currentParticle, rowY);
 		}
 	END_PARALLEL_FOR
+
+	reduceBuffers();
 }
 
+/**
+* @brief Adds the per-thread force buffers to the cloud forces and clears them.
+*
+* @details Buffers are summed pairwise in a tree of log2(numBuffers) levels. At
+*          each level every thread adds a slice of the particles, so the 
+*          reduction is as parallel as the force loop itself.
+**/
+void ShieldedCoulombForce::reduceBuffers() {
+	const cloud_index numParticles = cloud->n;
+	for (cloud_index stride = 1; stride < numBuffers; stride *= 2) {
+		BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static)
+			for (cloud_index buffer = 0; buffer + stride < numBuffers; buffer += 2*stride) {
+				double * const toX = bufferX + buffer*numParticles + i, * const fromX = toX + stride*numParticles;
+				double * const toY = bufferY + buffer*numParticles + i, * const fromY = toY + stride*numParticles;
+				plusEqual_pd(toX, load_pd(fromX));
+				plusEqual_pd(toY, load_pd(fromY));
+				store_pd(fromX, set0_pd());
+				store_pd(fromY, set0_pd());
+			}
+		END_PARALLEL_FOR
+	}
+
+	BEGIN_PARALLEL_FOR(i, e, numParticles, DOUBLE_STRIDE, static)
+		plusEqual_pd(targetX + i, load_pd(bufferX + i));
+		plusEqual_pd(targetY + i, load_pd(bufferY + i));
+		store_pd(bufferX + i, set0_pd());
+		store_pd(bufferY + i, set0_pd());
+	END_PARALLEL_FOR
+}
 
 /**
-* @brief Calculates inteaction between i and i+1 particles with form 
-*        F_i,i+1 = e0*q_i*q_i+1/(|r_i - r_i+1|)^2*Exp(-s*|r_i - r_i+1|)*(1 + c*|r_i - r_i+1|)
-* 
-* @param[in] currentParticle Particle whose force is being computed
-* @param[in] charges 		 Charge of particle
-* @param[in] displacementV   Displacement vector of particle
+* @brief Computes all pair forces without locks by visiting every pair from
+*        both sides.
+*
+* @details Each vector of particles loops over all other vectors and only 
+*          accumulates its own force, so threads never write to the same 
+*          memory. This does twice the arithmetic of the triangular loop but
+*          needs neither locks nor extra buffers.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
 **/
-inline void ShieldedCoulombForce::force(const cloud_index currentParticle,
-                                        const double charges, const doubleV displacementV) {
-	// Calculate displacement between particles.
-    double displacementX, displacementY;
-    _mm_storel_pd(&displacementX, displacementV);
-    _mm_storeh_pd(&displacementY, displacementV);
-	const double displacement = sqrt(displacementX*displacementX + displacementY*displacementY);
-	const double valExp = displacement*shielding;
-
-	if (valExp < 10.0) {// restrict to 10*(ion debye length)
-		// calculate force
-		const double forceC = coulomb*charges*(1.0 + valExp)
-            /(displacement*displacement*displacement*exp(valExp));
-
-        const double forceX = forceC*displacementX;
-        const double forceY = forceC*displacementY;
-        SEMAPHORE_WAIT(currentParticle/DOUBLE_STRIDE)
-		plusEqual_pd(cloud->forceX + currentParticle, _mm_set_pd(-forceX, forceX));
-        plusEqual_pd(cloud->forceY + currentParticle, _mm_set_pd(-forceY, forceY));
-        SEMAPHORE_SIGNAL(currentParticle/DOUBLE_STRIDE)
+void ShieldedCoulombForce::gatherAllForce(const double * const x, const double * const y) {
+	const cloud_index numParticles = cloud->n;
+	const double * const charge = cloud->charge;
+	BEGIN_PARALLEL_FOR(currentParticle, e, numParticles, DOUBLE_STRIDE, static)
+		const doubleV vx1 = load_pd(x + currentParticle);
+		const doubleV vy1 = load_pd(y + currentParticle);
+		const doubleV vq1 = load_pd(charge + currentParticle);
+		doubleV rowX, rowY;
+		triangleForce(vx1, vy1, vq1, rowX, rowY);
+
+		for (cloud_index i = 0; i < numParticles; i += DOUBLE_STRIDE)
+			if (i != currentParticle)
+				blockForce(vx1, vy1, vq1, load_pd(x + i), load_pd(y + i), load_pd(charge + i), rowX, rowY);
+
+		plusEqual_pd(targetX + currentParticle, rowX);
+		plusEqual_pd(targetY + currentParticle, rowY);
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Computes all pair forces like lockForce, but with single precision pair
+*        forces.
+*
+* @details Blocks are FLOAT_STRIDE particles wide. Positions stay in double 
+*          precision and only the displacements of the pairs are rounded to 
+*          float, so the precision does not depend on the size of the cloud. The
+*          forces of each block are widened and added up in double precision. 
+*          Since all blocks start at a multiple of FLOAT_STRIDE, the semaphore of
+*          the first DOUBLE_STRIDE particles locks the whole block. The pairs are
+*          scheduled like in lockForce.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void ShieldedCoulombForce::mixedForce(const double * const x, const double * const y) {
+	const double * const charge = cloud->charge;
+	BEGIN_SERIAL
+		pairBlocks.startRun();
+	END_SERIAL
+	BEGIN_PARALLEL_FOR(thread, e, pairBlocks.numThreads, 1, static)
+		const PairScheduler::Clock::time_point start = PairScheduler::Clock::now();
+		for (cloud_index k = pairBlocks.threadStart[thread]; k < pairBlocks.threadStart[thread + 1]; k++) {
+			const PairScheduler::Block &block = pairBlocks.blocks[k];
+			for (cloud_index currentParticle = block.rowBegin; currentParticle < block.rowEnd; currentParticle += FLOAT_STRIDE) {
+				const double * const x1 = x + currentParticle, * const y1 = y + currentParticle;
+				const floatV vq1 = narrow_ps(load_pd(charge + currentParticle), load_pd(charge + currentParticle + DOUBLE_STRIDE));
+				floatV blockX = set0_ps(), blockY = set0_ps(), reactionX, reactionY;
+				bool interacting = false;
+
+				// Blocks on the diagonal start with the pairs within the row vector.
+				cloud_index i = block.columnBegin;
+				if (i <= currentParticle) {
+					interacting = triangleForce(x1, y1, vq1, blockX, blockY);
+					i = currentParticle + FLOAT_STRIDE;
+				}
+				doubleV rowXLow = widenLow_pd(blockX), rowXHigh = widenHigh_pd(blockX);
+				doubleV rowYLow = widenLow_pd(blockY), rowYHigh = widenHigh_pd(blockY);
+
+				for (; i < block.columnEnd; i += FLOAT_STRIDE) {
+					blockX = blockY = set0_ps();
+					if (blockForce(x1, y1, vq1, x + i, y + i, narrow_ps(load_pd(charge + i), load_pd(charge + i + DOUBLE_STRIDE)),
+					               blockX, blockY, reactionX, reactionY)) {
+						interacting = true;
+						rowXLow = add_pd(rowXLow, widenLow_pd(blockX));
+						rowXHigh = add_pd(rowXHigh, widenHigh_pd(blockX));
+						rowYLow = add_pd(rowYLow, widenLow_pd(blockY));
+						rowYHigh = add_pd(rowYHigh, widenHigh_pd(blockY));
+						SEMAPHORE_WAIT(i/DOUBLE_STRIDE)
+						plusEqual_pd(targetX + i, widenLow_pd(reactionX));
+						plusEqual_pd(targetX + i + DOUBLE_STRIDE, widenHigh_pd(reactionX));
+						plusEqual_pd(targetY + i, widenLow_pd(reactionY));
+						plusEqual_pd(targetY + i + DOUBLE_STRIDE, widenHigh_pd(reactionY));
+						SEMAPHORE_SIGNAL(i/DOUBLE_STRIDE)
+					}
+				}
+
+				if (interacting) {
+					SEMAPHORE_WAIT(currentParticle/DOUBLE_STRIDE)
+					plusEqual_pd(targetX + currentParticle, rowXLow);
+					plusEqual_pd(targetX + currentParticle + DOUBLE_STRIDE, rowXHigh);
+					plusEqual_pd(targetY + currentParticle, rowYLow);
+					plusEqual_pd(targetY + currentParticle + DOUBLE_STRIDE, rowYHigh);
+					SEMAPHORE_SIGNAL(currentParticle/DOUBLE_STRIDE)
+				}
+			}
+		}
+		pairBlocks.addTime(thread, start);
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Single precision version of pairForce.
+*
+* @param[in]  charges       Vector of products of the pair charges
+* @param[in]  displacementX Vector of x-direction displacements
+* @param[in]  displacementY Vector of y-direction displacements
+* @param[out] forcevX       x-force on the first particle of each pair
+* @param[out] forcevY       y-force on the first particle of each pair
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::pairForce(const floatV charges, const floatV displacementX, const floatV displacementY,
+                                            floatV &forcevX, floatV &forcevY) const {
+	const floatV displacement2 = add_ps(mul_ps(displacementX, displacementX), mul_ps(displacementY, displacementY));
+	const floatV displacement = sqrt_ps(displacement2);
+	const floatV valExp = mul_ps(displacement, (float)shielding);
+
+	const floatV inRange = cmplt_ps(valExp, 10.0f);
+	if (!movemask_ps(inRange))
+		return false;
+
+	const floatV forceC = and_ps(inRange, div_ps(mul_ps(mul_ps(mul_ps(charges, (float)coulomb), add_ps(set1_ps(1.0f), valExp)),
+	                                                    exp_ps(sub_ps(set0_ps(), valExp))),
+	                                             mul_ps(displacement2, displacement)));
+	forcevX = mul_ps(forceC, displacementX);
+	forcevY = mul_ps(forceC, displacementY);
+	return true;
+}
+
+/**
+* @brief Single precision version of triangleForce for a block of FLOAT_STRIDE
+*        particles.
+*
+* @param[in]  x1      x-positions of the particles
+* @param[in]  y1      y-positions of the particles
+* @param[in]  vq1     Charges of the particles
+* @param[out] forcevX x-force on each particle
+* @param[out] forcevY y-force on each particle
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::triangleForce(const double * const x1, const double * const y1, const floatV vq1,
+                                                floatV &forcevX, floatV &forcevY) const {
+	bool interacting = false;
+	forcevX = forcevY = set0_ps();
+	const doubleV vx1Low = load_pd(x1), vx1High = load_pd(x1 + DOUBLE_STRIDE);
+	const doubleV vy1Low = load_pd(y1), vy1High = load_pd(y1 + DOUBLE_STRIDE);
+	doubleV vx2Low = vx1Low, vx2High = vx1High, vy2Low = vy1Low, vy2High = vy1High;
+	floatV vq2 = vq1;
+	for (int rotation = 1; rotation < FLOAT_STRIDE; rotation++) {
+		rotate_pd(vx2Low, vx2High);
+		rotate_pd(vy2Low, vy2High);
+		vq2 = rotate_ps(vq2);
+
+		floatV pairX, pairY;
+		if (pairForce(mul_ps(vq1, vq2), narrow_ps(sub_pd(vx1Low, vx2Low), sub_pd(vx1High, vx2High)),
+		              narrow_ps(sub_pd(vy1Low, vy2Low), sub_pd(vy1High, vy2High)), pairX, pairY)) {
+			forcevX = add_ps(forcevX, pairX);
+			forcevY = add_ps(forcevY, pairY);
+			interacting = true;
+		}
 	}
+	return interacting;
 }
 
+/**
+* @brief Single precision version of blockForce for two blocks of FLOAT_STRIDE
+*        particles.
+*
+* @param[in]     x1        x-positions of the first particles
+* @param[in]     y1        y-positions of the first particles
+* @param[in]     vq1       Charges of the first particles
+* @param[in]     x2        x-positions of the second particles
+* @param[in]     y2        y-positions of the second particles
+* @param[in]     vq2       Charges of the second particles
+* @param[in,out] forcevX   Accumulated x-force on the first particles
+* @param[in,out] forcevY   Accumulated y-force on the first particles
+* @param[out]    reactionX x-force on the second particles
+* @param[out]    reactionY y-force on the second particles
+*
+* @return False if no pair is within 10*(ion debye length)
+**/
+inline bool ShieldedCoulombForce::blockForce(const double * const x1, const double * const y1, const floatV vq1,
+                                             const double * const x2, const double * const y2, floatV vq2,
+                                             floatV &forcevX, floatV &forcevY,
+                                             floatV &reactionX, floatV &reactionY) const {
+	bool interacting = false;
+	reactionX = reactionY = set0_ps();
+	const doubleV vx1Low = load_pd(x1), vx1High = load_pd(x1 + DOUBLE_STRIDE);
+	const doubleV vy1Low = load_pd(y1), vy1High = load_pd(y1 + DOUBLE_STRIDE);
+	doubleV vx2Low = load_pd(x2), vx2High = load_pd(x2 + DOUBLE_STRIDE);
+	doubleV vy2Low = load_pd(y2), vy2High = load_pd(y2 + DOUBLE_STRIDE);
+	for (int rotation = 0; rotation < FLOAT_STRIDE; rotation++) {
+		floatV pairX, pairY;
+		if (pairForce(mul_ps(vq1, vq2), narrow_ps(sub_pd(vx1Low, vx2Low), sub_pd(vx1High, vx2High)),
+		              narrow_ps(sub_pd(vy1Low, vy2Low), sub_pd(vy1High, vy2High)), pairX, pairY)) {
+			forcevX = add_ps(forcevX, pairX);
+			forcevY = add_ps(forcevY, pairY);
+			// equal and opposite force:
+			reactionX = sub_ps(reactionX, pairX);
+			reactionY = sub_ps(reactionY, pairY);
+			interacting = true;
+		}
+
+		rotate_pd(vx2Low, vx2High);
+		rotate_pd(vy2Low, vy2High);
+		vq2 = rotate_ps(vq2);
+		reactionX = rotate_ps(reactionX);
+		reactionY = rotate_ps(reactionY);
+	}
+	return interacting;
+}
 
 /**
-* @brief Calculates inteaction between (i,i+1) and (j,j+1) particles with form
-*        F_i,j = e0*q_i*q_j/(|r_i - r_j|)^2*Exp(-s*|r_i - r_j|)*(1 + c*|r_i - r_j|)
-* 
-* @param[in] currentParticle Particle whose force is being computed
-* @param[in] iParticle		 The other particle
-* @param[in] charges 		 Vector of particle charges
-* @param[in] displacementX   Vector of x-direction displacements
-* @param[in] displacementY   Vector of y-direction displacements
+* @brief Computes all pair forces tile by tile, skipping pairs of tiles whose
+*        bounding boxes are farther apart than the cutoff.
+*
+* @details Tiles are tileSize consecutive particles, so the second tile of a
+*          pair stays in L1 cache while every vector of the first tile is
+*          paired with it. Forces are summed in per-tile buffers and only 
+*          added to the cloud once per pair of tiles, which also takes the
+*          locks far less often than lockForce. Culling works best when 
+*          consecutive particles are close together, like the rows of the 
+*          initial grid.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
 **/
-inline void ShieldedCoulombForce::force(const cloud_index currentParticle, const cloud_index iParticle, 
-                                        const doubleV charges, const doubleV displacementX, const doubleV displacementY) {
-	// Calculate displacement between particles.
-	const doubleV displacement = sqrt_pd(add_pd(displacementX*displacementX, displacementY*displacementY));
-	const doubleV valExp = displacement*set1_pd(shielding);
-	
-	const int mask = movemask_pd(_mm_cmplt_pd(valExp, set1_pd(10.0)));
-	if (!mask)
-		return;
-    
-    // calculate force
-	const doubleV forceC = set1_pd(coulomb)*charges*(set1_pd(1.0) + valExp)*exp_pd(mask, valExp)
-        				   /(displacement*displacement*displacement);
-    const doubleV forcevX = forceC*displacementX;
-	const doubleV forcevY = forceC*displacementY;
-
-	SEMAPHORE_WAIT(currentParticle/DOUBLE_STRIDE)
-	plusEqual_pd(cloud->forceX + currentParticle, forcevX);
-	plusEqual_pd(cloud->forceY + currentParticle, forcevY);
-    SEMAPHORE_SIGNAL(currentParticle/DOUBLE_STRIDE)
-
-    SEMAPHORE_WAIT(iParticle/DOUBLE_STRIDE)
-	// equal and opposite force:
-    minusEqual_pd(cloud->forceX + iParticle, forcevX);
-	minusEqual_pd(cloud->forceY + iParticle, forcevY);
-    SEMAPHORE_SIGNAL(iParticle/DOUBLE_STRIDE)
+void ShieldedCoulombForce::tiledForce(const double * const x, const double * const y) {
+	const cloud_index numParticles = cloud->n;
+	const double * const charge = cloud->charge;
+	BEGIN_PARALLEL_FOR(tile, e, numTiles, 1, static)
+		double * const bounds = tileBounds + 4*tile;
+		const cloud_index begin = tile*tileSize, end = std::min(begin + tileSize, numParticles);
+		bounds[0] = bounds[1] = x[begin];
+		bounds[2] = bounds[3] = y[begin];
+		for (cloud_index i = begin + 1; i < end; i++) {
+			bounds[0] = std::min(bounds[0], x[i]); bounds[1] = std::max(bounds[1], x[i]);
+			bounds[2] = std::min(bounds[2], y[i]); bounds[3] = std::max(bounds[3], y[i]);
+		}
+	END_PARALLEL_FOR
+
+	const double cutoff = table ? sqrt(table->cutoff2) : 10.0/shielding;
+	BEGIN_PARALLEL_FOR(tile1, e, numTiles, 1, dynamic)
+		const cloud_index begin1 = tile1*tileSize, end1 = std::min(begin1 + tileSize, numParticles);
+		alignas(32) double forceX1[tileSize], forceY1[tileSize], forceX2[tileSize], forceY2[tileSize];
+		std::fill(forceX1, forceX1 + tileSize, 0.0);
+		std::fill(forceY1, forceY1 + tileSize, 0.0);
+		std::fill(forceX2, forceX2 + tileSize, 0.0);
+		std::fill(forceY2, forceY2 + tileSize, 0.0);
+
+		for (cloud_index tile2 = tile1; tile2 < numTiles; tile2++) {
+			if (!tilesInRange(tile1, tile2, cutoff*cutoff))
+				continue;
+
+			const cloud_index begin2 = tile2*tileSize, end2 = std::min(begin2 + tileSize, numParticles);
+			bool interacting2 = false;
+			for (cloud_index currentParticle = begin1; currentParticle < end1; currentParticle += DOUBLE_STRIDE) {
+				const doubleV vx1 = load_pd(x + currentParticle);
+				const doubleV vy1 = load_pd(y + currentParticle);
+				const doubleV vq1 = load_pd(charge + currentParticle);
+				doubleV rowX, rowY, reactionX, reactionY;
+				cloud_index i = begin2;
+				if (tile2 == tile1) {
+					triangleForce(vx1, vy1, vq1, rowX, rowY);
+					i = currentParticle + DOUBLE_STRIDE;
+				} else
+					rowX = rowY = set0_pd();
+
+				// Within the same tile the reactions go to the first buffers.
+				double * const reactionBufferX = tile2 == tile1 ? forceX1 : forceX2;
+				double * const reactionBufferY = tile2 == tile1 ? forceY1 : forceY2;
+				for (; i < end2; i += DOUBLE_STRIDE)
+					if (blockForce(vx1, vy1, vq1, load_pd(x + i), load_pd(y + i), load_pd(charge + i),
+					               rowX, rowY, reactionX, reactionY)) {
+						interacting2 = true;
+						plusEqual_pd(reactionBufferX + i - begin2, reactionX);
+						plusEqual_pd(reactionBufferY + i - begin2, reactionY);
+					}
+
+				plusEqual_pd(forceX1 + currentParticle - begin1, rowX);
+				plusEqual_pd(forceY1 + currentParticle - begin1, rowY);
+			}
+
+			if (tile2 != tile1 && interacting2) {
+				for (cloud_index i = begin2; i < end2; i += DOUBLE_STRIDE) {
+					SEMAPHORE_WAIT(i/DOUBLE_STRIDE)
+					plusEqual_pd(targetX + i, load_pd(forceX2 + i - begin2));
+					plusEqual_pd(targetY + i, load_pd(forceY2 + i - begin2));
+					SEMAPHORE_SIGNAL(i/DOUBLE_STRIDE)
+				}
+				std::fill(forceX2, forceX2 + tileSize, 0.0);
+				std::fill(forceY2, forceY2 + tileSize, 0.0);
+			}
+		}
+
+		for (cloud_index i = begin1; i < end1; i += DOUBLE_STRIDE) {
+			SEMAPHORE_WAIT(i/DOUBLE_STRIDE)
+			plusEqual_pd(targetX + i, load_pd(forceX1 + i - begin1));
+			plusEqual_pd(targetY + i, load_pd(forceY1 + i - begin1));
+			SEMAPHORE_SIGNAL(i/DOUBLE_STRIDE)
+		}
+	END_PARALLEL_FOR
 }
 
+/**
+* @brief Checks if the bounding boxes of two tiles are within a distance.
+*
+* @param[in] tile1   The first tile
+* @param[in] tile2   The second tile
+* @param[in] cutoff2 Square of the distance
+*
+* @return True if some pair of the tiles could be closer than the distance
+**/
+inline bool ShieldedCoulombForce::tilesInRange(const cloud_index tile1, const cloud_index tile2, const double cutoff2) const {
+	const double * const bounds1 = tileBounds + 4*tile1, * const bounds2 = tileBounds + 4*tile2;
+	const double gapX = std::max(0.0, std::max(bounds2[0] - bounds1[1], bounds1[0] - bounds2[1]));
+	const double gapY = std::max(0.0, std::max(bounds2[2] - bounds1[3], bounds1[2] - bounds2[3]));
+	return gapX*gapX + gapY*gapY < cutoff2;
+}
 
 /**
-* @brief Calculates inteaction between (i,i+1) and (j+1,j) particles with form
-*        F_i,j = e0*q_i*q_j/(|r_i - r_j|)^2*Exp(-s*|r_i - r_j|)*(1 + c*|r_i - r_j|)
-* 
-* @param[in] currentParticle Particle whose force is being computed
-* @param[in] iParticle		 The other particle
-* @param[in] charges 		 Vector of particle charges
-* @param[in] displacementX   Vector of x-direction displacements
-* @param[in] displacementY   Vector of y-direction displacements
+* @brief Computes the force on each particle from the particles in its own and
+*        the eight surrounding cells.
+*
+* @details The cells are rebuilt from the positions of the current substep with
+*          a width of at least the 10*(ion debye length) cutoff, so no interacting
+*          pair is missed. Each particle only accumulates its own force. This 
+*          visits every pair twice but needs no locks.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
 **/
-inline void ShieldedCoulombForce::forcer(const cloud_index currentParticle, const cloud_index iParticle, 
-                                         const doubleV charges, const doubleV displacementX, const doubleV displacementY) {
-	// Calculate displacement between particles.
-	const doubleV displacement = sqrt_pd(add_pd(displacementX*displacementX, displacementY*displacementY));
-	const doubleV valExp = displacement*set1_pd(shielding);
-	
-	const int mask = movemask_pd(_mm_cmplt_pd(valExp, set1_pd(10.0)));
-	if (!mask)
+void ShieldedCoulombForce::cellForce(const double * const x, const double * const y) {
+	cells->build(x, y, 10.0/shielding);
+
+	const cloud_index numParticles = cloud->n;
+	BEGIN_PARALLEL_FOR(p, e, numParticles, 1, static)
+		cellCharge[p] = cloud->charge[cells->particles[p]];
+	END_PARALLEL_FOR
+
+	BEGIN_PARALLEL_FOR(p, e, numParticles, 1, static)
+		const cloud_index cx = cells->particleCell[p]%cells->numCellsX;
+		const cloud_index cy = cells->particleCell[p]/cells->numCellsX;
+		const doubleV vx1 = set1_pd(cells->sortedX[p]);
+		const doubleV vy1 = set1_pd(cells->sortedY[p]);
+		doubleV forcevX = set0_pd(), forcevY = set0_pd();
+
+		for (cloud_index row = cy ? cy - 1 : 0, lastRow = std::min(cy + 1, cells->numCellsY - 1); row <= lastRow; row++)
+			for (cloud_index j = cells->rowBegin(cx, row), end = cells->rowEnd(cx, row); j < end; j += DOUBLE_STRIDE)
+				gatherForce(vx1, vy1, loadu_pd(cells->sortedX + j), loadu_pd(cells->sortedY + j), loadu_pd(cellCharge + j),
+				            cmplt_pd(laneIndex_pd(), (double)(end - j)), forcevX, forcevY);
+
+		const cloud_index currentParticle = cells->particles[p];
+		const double q1 = coulomb*cellCharge[p];
+		targetX[currentParticle] += q1*sum_pd(forcevX);
+		targetY[currentParticle] += q1*sum_pd(forcevY);
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Computes the force on each particle from the particles in its 
+*        NeighborList.
+*
+* @details The list holds all partners within the cutoff plus a skin radius and
+*          is only rebuilt once a particle has moved more than half the skin,
+*          so it is reused across substeps and timesteps, unless the cloud
+*          reordered its particles in between. Each particle only accumulates
+*          its own force, so no locks are needed.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void ShieldedCoulombForce::neighborForce(const double * const x, const double * const y) {
+	BEGIN_SERIAL
+		if (numReorders != cloud->numReorders) {
+			neighbors->invalidate();
+			numReorders = cloud->numReorders;
+		}
+	END_SERIAL
+	neighbors->update(x, y, 10.0/shielding);
+
+	const cloud_index numParticles = cloud->n;
+	const cloud_index * const list = neighbors->neighbors.data();
+	BEGIN_PARALLEL_FOR(currentParticle, e, numParticles, 1, static)
+		const doubleV vx1 = set1_pd(x[currentParticle]);
+		const doubleV vy1 = set1_pd(y[currentParticle]);
+		doubleV forcevX = set0_pd(), forcevY = set0_pd();
+
+		for (cloud_index j = neighbors->neighborStart[currentParticle], end = neighbors->neighborStart[currentParticle + 1];
+		     j < end; j += DOUBLE_STRIDE)
+			gatherForce(vx1, vy1, gather_pd(x, list + j), gather_pd(y, list + j), gather_pd(cloud->charge, list + j),
+			            cmplt_pd(laneIndex_pd(), (double)(end - j)), forcevX, forcevY);
+
+		const double q1 = coulomb*cloud->charge[currentParticle];
+		targetX[currentParticle] += q1*sum_pd(forcevX);
+		targetY[currentParticle] += q1*sum_pd(forcevY);
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Adds the interaction of a particle with a vector of partners, without 
+*        the charge of the particle itself or the coulomb constant.
+*
+* @param[in]     vx1     x-position of the particle
+* @param[in]     vy1     y-position of the particle
+* @param[in]     vx2     x-positions of the partners
+* @param[in]     vy2     y-positions of the partners
+* @param[in]     vq2     Charges of the partners
+* @param[in]     lanes   Mask of the lanes that hold partners
+* @param[in,out] forcevX Accumulated x-force
+* @param[in,out] forcevY Accumulated y-force
+**/
+inline void ShieldedCoulombForce::gatherForce(const doubleV vx1, const doubleV vy1, const doubleV vx2, const doubleV vy2, 
+                                              const doubleV vq2, const doubleV lanes, doubleV &forcevX, doubleV &forcevY) const {
+	const doubleV displacementX = sub_pd(vx1, vx2);
+	const doubleV displacementY = sub_pd(vy1, vy2);
+	const doubleV displacement2 = add_pd(mul_pd(displacementX, displacementX), mul_pd(displacementY, displacementY));
+	if (table) {
+		// Drop empty lanes, the particle itself and pairs beyond 10*(ion debye length).
+		const doubleV valid = and_pd(and_pd(lanes, cmpgt_pd(displacement2, 0.0)), cmplt_pd(displacement2, table->cutoff2));
+		if (!movemask_pd(valid))
+			return;
+
+		const doubleV forceC = and_pd(valid, mul_pd(vq2, table->lookup(valid, displacement2)));
+		forcevX = fmadd_pd(forceC, displacementX, forcevX);
+		forcevY = fmadd_pd(forceC, displacementY, forcevY);
+		return;
+	}
+
+	const doubleV displacement = sqrt_pd(displacement2);
+	const doubleV valExp = mul_pd(displacement, shielding);
+
+	// Drop empty lanes, the particle itself and pairs beyond 10*(ion debye length).
+	const doubleV valid = and_pd(and_pd(lanes, cmpgt_pd(displacement2, 0.0)), cmplt_pd(valExp, 10.0));
+	if (!movemask_pd(valid))
 		return;
-    
-    // calculate force
-	const doubleV forceC = set1_pd(coulomb)*charges*(set1_pd(1.0) + valExp)*exp_pd(mask, valExp)
-        /(displacement*displacement*displacement);
-	const doubleV forcevX = forceC*displacementX;
-	const doubleV forcevY = forceC*displacementY;
-
-    SEMAPHORE_WAIT(currentParticle/DOUBLE_STRIDE)
-    plusEqual_pd(cloud->forceX + currentParticle, forcevX);
-	plusEqual_pd(cloud->forceY + currentParticle, forcevY);
-    SEMAPHORE_SIGNAL(currentParticle/DOUBLE_STRIDE)
-    
-    SEMAPHORE_WAIT(iParticle/DOUBLE_STRIDE)
-	// equal and opposite force:
-    minusEqualr_pd(cloud->forceX + iParticle, forcevX);
-	minusEqualr_pd(cloud->forceY + iParticle, forcevY);
-    SEMAPHORE_SIGNAL(iParticle/DOUBLE_STRIDE)
+
+	const doubleV forceC = and_pd(valid, div_pd(mul_pd(mul_pd(vq2, add_pd(set1_pd(1.0), valExp)),
+	                                                   exp_pd(valid, sub_pd(set0_pd(), valExp))), mul_pd(displacement2, displacement)));
+	forcevX = fmadd_pd(forceC, displacementX, forcevX);
+	forcevY = fmadd_pd(forceC, displacementY, forcevY);
 }
 
 void ShieldedCoulombForce::writeForce(fitsfile * const file, int * const error) const {
@@ -263,6 +938,16 @@ void ShieldedCoulombForce::writeForce(fitsfile * const file, int * const error)
 		// file, key name, value, precision (scientific format), comment
 		fits_write_key_dbl(file, const_cast<char *> ("shieldingConstant"), shielding, 
                            6, const_cast<char *> ("[m^-1] (ShieldedCoulombForce)"), error);
+
+	if (!*error)
+		// file, key name, value, comment
+		fits_write_key_lng(file, const_cast<char *> ("coulombTable"), table ? (long)table->bits : 0L,
+		                   const_cast<char *> ("[log2 per octave of r^2, 0 = exact] (ShieldedCoulombForce)"), error);
+
+	if (!*error)
+		// file, key name, value, comment
+		fits_write_key_log(file, const_cast<char *> ("coulombMixed"), precision == MixedPrecision,
+		                   const_cast<char *> ("single precision pair forces (ShieldedCoulombForce)"), error);
 }
 
 void ShieldedCoulombForce::readForce(fitsfile * const file, int * const error) {
@@ -274,27 +959,47 @@ void ShieldedCoulombForce::readForce(fitsfile * const file, int * const error) {
 	if (!*error)
 		// file, key name, value, don't read comment, error
 		fits_read_key_dbl(file, const_cast<char *> ("shieldingConstant"), &shielding, NULL, error);
-}
 
-inline doubleV ShieldedCoulombForce::exp_pd(const int mask, const doubleV a) {
-	double expl = 0.0, exph = 0.0;
-    if (mask & 1) {
-        double expVal;
-        _mm_storel_pd(&expVal, a);
-        expl = exp(-expVal);
-    }
-    if (mask & 2) {
-        double expVal;
-        _mm_storeh_pd(&expVal, a);
-        exph = exp(-expVal);
-    }
-	return _mm_set_pd(exph, expl);
-}
+	// Files written before the table was added have no coulombTable key.
+	long tableResolution = 0;
+	if (!*error) {
+		fits_read_key_lng(file, const_cast<char *> ("coulombTable"), &tableResolution, NULL, error);
+		if (*error == KEY_NO_EXIST)
+			*error = 0;
+	}
 
-inline void ShieldedCoulombForce::plusEqualr_pd(double * const a, const doubleV b) {
-	_mm_storer_pd(a, _mm_add_pd(_mm_loadr_pd(a), b));
+	// Files written before mixed precision was added have no coulombMixed key.
+	int mixed = 0;
+	if (!*error) {
+		fits_read_key_log(file, const_cast<char *> ("coulombMixed"), &mixed, NULL, error);
+		if (*error == KEY_NO_EXIST)
+			*error = 0;
+	}
+	// Mixed precision has only a locked all pairs version without a table that
+	// works in whole blocks of FLOAT_STRIDE particles, so it is kept only when
+	// this run and cloud select it.
+	if (!*error)
+		precision = mixed && !cells && !neighbors && !tileBounds && accumulation == LockAccumulation && !tableResolution
+		            && cloud->n%FLOAT_STRIDE == 0 ? MixedPrecision : DoublePrecision;
+
+	// The table depends on the shielding constant, so it is rebuilt.
+	if (!*error) {
+		delete table;
+		table = tableResolution ? new YukawaTable(shielding, (unsigned)tableResolution) : NULL;
+	}
 }
 
-inline void ShieldedCoulombForce::minusEqualr_pd(double * const a, const doubleV b) {
-	_mm_storer_pd(a, _mm_sub_pd(_mm_loadr_pd(a), b));
+/**
+* @brief Prints neighbor list statistics when NeighborListSearch is used, the
+*        balance of the threads when the locked all pairs search is used and 
+*        the accuracy of the force table when it is used.
+*
+* @param[in] out Stream to print to
+**/
+void ShieldedCoulombForce::printStatistics(std::ostream &out) const {
+	pairBlocks.printStatistics(out, "Coulomb");
+	if (neighbors)
+		neighbors->printStatistics(out);
+	if (table)
+		table->printStatistics(out);
 }
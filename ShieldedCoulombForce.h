@@ -10,37 +10,97 @@
 #define SHIELDEDCOULOMBFORCE_H
 
 #include "Force.h"
+#include "NeighborList.h"
+#include "PairScheduler.h"
 #include "VectorCompatibility.h"
+#include "YukawaTable.h"
+
+//!< Methods used by ShieldedCoulombForce to find interacting pairs:
+enum PairSearch : int {
+	AllPairsSearch,    //!< Visit every pair of particles
+	CellListSearch,    //!< Only visit pairs in neighboring cells of a CellList
+	NeighborListSearch, //!< Only visit pairs in a NeighborList that is reused across substeps
+	TiledSearch         //!< Visit pairs of tiles of consecutive particles whose bounding boxes are within the cutoff
+};
+
+//!< Ways ShieldedCoulombForce adds up the pair forces of AllPairsSearch:
+enum ForceAccumulation : int {
+	LockAccumulation,    //!< Lock both particles of a pair while adding its force
+	PrivateAccumulation, //!< Add pair forces to per-thread buffers that are summed afterwards
+	GatherAccumulation   //!< Visit every pair twice so each particle only adds its own force
+};
+
+//!< Floating point precision of the ShieldedCoulombForce pair forces:
+enum ForcePrecision : int {
+	DoublePrecision, //!< Compute everything in double precision
+	MixedPrecision   //!< Compute pair forces in single precision from double displacements and sum them in double
+};
 
 class ShieldedCoulombForce : public Force {
 public:
-	ShieldedCoulombForce(Cloud * const C, const double shieldingConstant);
+	ShieldedCoulombForce(Cloud * const C, const double shieldingConstant,
+	                     const PairSearch search, const double neighborSkin,
+	                     const ForceAccumulation accumulationMethod, const unsigned tableResolution,
+	                     const ForcePrecision pairPrecision);
 	~ShieldedCoulombForce();
 
 	void force1(const double currentTime); //rk substep 1
 	void force2(const double currentTime); //rk substep 2
 	void force3(const double currentTime); //rk substep 3
 	void force4(const double currentTime); //rk substep 4
+	bool activeForce(const double currentTime, const cloud_index * const active, const cloud_index numActive);
 
 	void writeForce(fitsfile * const file, int * const error) const;
 	void readForce(fitsfile * const file, int * const error);
+	void printStatistics(std::ostream &out) const;
 
 private:
 	double shielding; //<! Inverse of shielding distance [m^-1]
+	YukawaTable *table; //<! Tabulated force used instead of sqrt and exp, otherwise NULL
+	CellList * const cells; //<! Cell list used by CellListSearch, otherwise NULL
+	double * const cellCharge; //<! Particle charges sorted by cell
+	NeighborList * const neighbors; //<! Neighbor list used by NeighborListSearch, otherwise NULL
+	unsigned long numReorders; //<! Number of cloud reorders the neighbor list was built after
+	const cloud_index numTiles; //<! Number of tiles used by TiledSearch, otherwise 0
+	double * const tileBounds; //<! Bounding box (minX, maxX, minY, maxY) of each tile, otherwise NULL
+	const ForceAccumulation accumulation; //<! How AllPairsSearch adds up pair forces
+	ForcePrecision precision; //<! Precision of the pair forces of the locked all pairs search
+	PairScheduler pairBlocks; //<! Deals out the pairs of the locked all pairs search to the threads
+	const cloud_index numBuffers; //<! Number of per-thread force buffers
+	double * const bufferX, * const bufferY; //<! Per-thread forces used by PrivateAccumulation, otherwise NULL
     SEMAPHORES
 	
 	static const double coulomb; //<! Coulomb constant: 8.987551787 [m/F]
+	static const cloud_index tileSize = 256; //<! Particles per tile, so a pair of tiles fits in L1 cache
 
-	void force(const cloud_index currentParticle,
-	           const double charges, const doubleV displacementV);
-	void force(const cloud_index currentParticle, const cloud_index iParticle, 
-	           const doubleV charges, const doubleV displacementX, const doubleV displacementY);
-	void forcer(const cloud_index currentParticle, const cloud_index iParticle,
-	            const doubleV charges, const doubleV displacementX, const doubleV displacementY);
-    
-	static doubleV exp_pd(const int mask, const doubleV a);
-    static void plusEqualr_pd(double * const a, const doubleV b);
-    static void minusEqualr_pd(double * const a, const doubleV b);
+	void force(const double * const x, const double * const y);
+	void lockForce(const double * const x, const double * const y);
+	void privateForce(const double * const x, const double * const y);
+	void gatherAllForce(const double * const x, const double * const y);
+	void reduceBuffers();
+	bool pairForce(const doubleV charges, const doubleV displacementX, const doubleV displacementY,
+	               doubleV &forcevX, doubleV &forcevY) const;
+	bool triangleForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+	                   doubleV &forcevX, doubleV &forcevY) const;
+	bool blockForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+	                doubleV vx2, doubleV vy2, doubleV vq2, doubleV &forcevX, doubleV &forcevY,
+	                doubleV &reactionX, doubleV &reactionY) const;
+	bool blockForce(const doubleV vx1, const doubleV vy1, const doubleV vq1,
+	                doubleV vx2, doubleV vy2, doubleV vq2, doubleV &forcevX, doubleV &forcevY) const;
+	void mixedForce(const double * const x, const double * const y);
+	bool pairForce(const floatV charges, const floatV displacementX, const floatV displacementY,
+	               floatV &forcevX, floatV &forcevY) const;
+	bool triangleForce(const double * const x1, const double * const y1, const floatV vq1,
+	                   floatV &forcevX, floatV &forcevY) const;
+	bool blockForce(const double * const x1, const double * const y1, const floatV vq1,
+	                const double * const x2, const double * const y2, floatV vq2,
+	                floatV &forcevX, floatV &forcevY, floatV &reactionX, floatV &reactionY) const;
+	void tiledForce(const double * const x, const double * const y);
+	bool tilesInRange(const cloud_index tile1, const cloud_index tile2, const double cutoff2) const;
+	void cellForce(const double * const x, const double * const y);
+	void neighborForce(const double * const x, const double * const y);
+	void gatherForce(const doubleV vx1, const doubleV vy1, const doubleV vx2, const doubleV vy2, 
+	                 const doubleV vq2, const doubleV lanes, doubleV &forcevX, doubleV &forcevY) const;
 };
 
 #endif // SHIELDEDCOULOMBFORCE_H
@@ -12,99 +12,48 @@
 #include <cmath>
 
 ThermalForce::ThermalForce(Cloud * const C, const double redFactor) 
-: Force(C), evenRandCache(new RandCache[C->n/DOUBLE_STRIDE]), oddRandCache(new RandCache[C->n/DOUBLE_STRIDE]),
-#ifdef DISPATCH_QUEUES
-evenRandGroup(dispatch_group_create()), oddRandGroup(dispatch_group_create()),
-randQueue(dispatch_queue_create("com.DEMON.ThermalForce", NULL)),
-#endif
-heatVal(redFactor) {
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(oddRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        oddRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-#endif
-}
-
-ThermalForce::~ThermalForce() {
-    delete[] evenRandCache;
-    delete[] oddRandCache;
+: Force(C), stream(C->rands.newStream()), substep(C->rands.getFirstSubstep()), heatVal(redFactor) {}
 
-#ifdef DISPATCH_QUEUES
-    dispatch_release(evenRandGroup);
-	dispatch_release(oddRandGroup);
-	dispatch_release(randQueue);
-#endif
-}
+ThermalForce::~ThermalForce() {}
 
 void ThermalForce::force1(const double currentTime) {
     (void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(evenRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        evenRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(oddRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-		force(currentParticle, oddRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle);
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForce::force2(const double currentTime) {
     (void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(oddRandGroup, randQueue, ^{
-#endif
-	for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        oddRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(evenRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-        force(currentParticle, evenRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle);
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForce::force3(const double currentTime) {
     (void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(evenRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        evenRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(oddRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-		force(currentParticle, oddRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle);
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForce::force4(const double currentTime) {
     (void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(oddRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        oddRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(evenRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-		force(currentParticle, evenRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle);
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 /**
@@ -113,30 +62,15 @@ void ThermalForce::force4(const double currentTime) {
 *        random direction.
 *
 * @param[in] currentParticle The particle whose force is being computed
-* @param[in] RC              RandCache struct from RandomNumbers.h
 **/
-inline void ThermalForce::force(const cloud_index currentParticle, const RandCache &RC) {
-    const doubleV thermV = mul_pd(RC.r, heatVal);
-	plusEqual_pd(cloud->forceX + currentParticle, thermV*randomCos(RC));
-	plusEqual_pd(cloud->forceY + currentParticle, thermV*randomSin(RC));
-}
-
-
-
-inline const doubleV ThermalForce::randomCos(const RandCache &RC) {
-#ifdef __AVX__
-    return _mm256_set_pd(cos(RC.r4), cos(RC.r3), cos(RC.r2), cos(RC.r1));
-#else
-    return _mm_set_pd(cos(RC.r2), cos(RC.r1));
-#endif
-}
-
-inline const doubleV ThermalForce::randomSin(const RandCache &RC) {
-#ifdef __AVX__
-    return _mm256_set_pd(sin(RC.r4), sin(RC.r3), sin(RC.r2), sin(RC.r1));
-#else
-    return _mm_set_pd(sin(RC.r2), sin(RC.r1));
-#endif 
+inline void ThermalForce::force(const cloud_index currentParticle) {
+	doubleV magnitude, angle;
+	cloud->rands.uniform_pd(stream, loadWide_epi64(cloud->id + currentParticle), substep, magnitude, angle);
+    const doubleV thermV = mul_pd(magnitude, heatVal);
+	doubleV directionX, directionY;
+	RandomNumbers::direction_pd(angle, directionX, directionY);
+	plusEqual_pd(targetX + currentParticle, mul_pd(thermV, directionX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(thermV, directionY));
 }
 
 void ThermalForce::writeForce(fitsfile * const file, int * const error) const {
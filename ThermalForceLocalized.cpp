@@ -15,97 +15,48 @@
 ThermalForceLocalized::ThermalForceLocalized(Cloud * const C, const double thermRed1, 
                                              const double thermRed2, const double specifiedRadius) 
 : Force(C), heatingRadius(specifiedRadius), heatVal1(thermRed1), heatVal2(thermRed2), 
-evenRandCache(new RandCache[C->n/DOUBLE_STRIDE]), oddRandCache(new RandCache[C->n/DOUBLE_STRIDE])
-#ifdef DISPATCH_QUEUES
-, evenRandGroup(dispatch_group_create()), oddRandGroup(dispatch_group_create()),
-randQueue(dispatch_queue_create("com.DEMON.ThermalForceLocalized", NULL))
-#endif
-{
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        oddRandCache[i] = RandCache(cloud->rands);
-}
+stream(C->rands.newStream()), substep(C->rands.getFirstSubstep()) {}
 
-ThermalForceLocalized::~ThermalForceLocalized() {
-    delete[] evenRandCache;
-	delete[] oddRandCache;
-    
-#ifdef DISPATCH_QUEUES
-	dispatch_release(evenRandGroup);
-	dispatch_release(oddRandGroup);
-	dispatch_release(randQueue);
-#endif
-}
+ThermalForceLocalized::~ThermalForceLocalized() {}
 
 void ThermalForceLocalized::force1(const double currentTime) {
-    (void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(evenRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        evenRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(oddRandGroup, DISPATCH_TIME_FOREVER);
-#endif   
-
-	BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static)
-		force(currentParticle, cloud->getx1_pd(currentParticle), cloud->gety1_pd(currentParticle), 
-              oddRandCache[currentParticle/DOUBLE_STRIDE]);
+	(void)currentTime;
+    BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
+		force(currentParticle, cloud->getx1_pd(currentParticle), cloud->gety1_pd(currentParticle));
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForceLocalized::force2(const double currentTime) {
 	(void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(oddRandGroup, randQueue, ^{
-#endif
-    for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-        oddRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-	});
-	dispatch_group_wait(evenRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-		force(currentParticle, cloud->getx2_pd(currentParticle), cloud->gety2_pd(currentParticle), 
-              evenRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle, cloud->getx2_pd(currentParticle), cloud->gety2_pd(currentParticle));
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForceLocalized::force3(const double currentTime) {
 	(void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(evenRandGroup, randQueue, ^{
-#endif
-        for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-            evenRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-    });
-	dispatch_group_wait(oddRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-    force(currentParticle, cloud->getx3_pd(currentParticle), cloud->gety3_pd(currentParticle), 
-          oddRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle, cloud->getx3_pd(currentParticle), cloud->gety3_pd(currentParticle));
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 void ThermalForceLocalized::force4(const double currentTime) {
 	(void)currentTime;
-#ifdef DISPATCH_QUEUES
-    dispatch_group_async(oddRandGroup, randQueue, ^{
-#endif
-        for (cloud_index i = 0, e = cloud->n/DOUBLE_STRIDE; i < e; i++)
-            oddRandCache[i] = RandCache(cloud->rands);
-#ifdef DISPATCH_QUEUES
-	});
-	dispatch_group_wait(evenRandGroup, DISPATCH_TIME_FOREVER);
-#endif
-    
     BEGIN_PARALLEL_FOR(currentParticle, numParticles, cloud->n, DOUBLE_STRIDE, static) 
-    force(currentParticle, cloud->getx4_pd(currentParticle), cloud->gety4_pd(currentParticle), 
-          evenRandCache[currentParticle/DOUBLE_STRIDE]);
+		force(currentParticle, cloud->getx4_pd(currentParticle), cloud->gety4_pd(currentParticle));
     END_PARALLEL_FOR
+    BEGIN_SERIAL
+        ++substep;
+    END_SERIAL
 }
 
 // F = c1*L : if r > h_r 
@@ -119,33 +70,22 @@ void ThermalForceLocalized::force4(const double currentTime) {
 *        random direction.
 *
 * @param[in] currentParticle The particle whose force is being computed
-* @param[in] RC              RandCache struct from RandomNumbers.h
+* @param[in] displacementX   x-positions of the particles
+* @param[in] displacementY   y-positions of the particles
 **/
 inline void ThermalForceLocalized::force(const cloud_index currentParticle, const doubleV displacementX, 
-                                         const doubleV displacementY, const RandCache &RC) {
-	const doubleV radiusV = _mm_sqrt_pd(displacementX*displacementX + displacementY*displacementY);
+                                         const doubleV displacementY) {
+	const doubleV radiusV = sqrt_pd(displacementX*displacementX + displacementY*displacementY);
 	
+	doubleV magnitude, angle;
+	cloud->rands.uniform_pd(stream, loadWide_epi64(cloud->id + currentParticle), substep, magnitude, angle);
 	const int mask = movemask_pd(cmplt_pd(radiusV, heatingRadius));
-    const doubleV thermV = mul_pd(select_pd(mask, heatVal1, heatVal2), RC.r);
+    const doubleV thermV = mul_pd(select_pd(mask, heatVal1, heatVal2), magnitude);
 	
-	plusEqual_pd(cloud->forceX + currentParticle, thermV*randomCos(RC)); // _mm_set_pd() is backwards
-	plusEqual_pd(cloud->forceY + currentParticle, thermV*randomSin(RC));
-}
-
-inline const doubleV ThermalForceLocalized::randomCos(const RandCache &RC) {
-#ifdef __AVX__
-    return _mm256_set_pd(cos(RC.r4), cos(RC.r3), cos(RC.r2), cos(RC.r1));
-#else
-    return _mm_set_pd(cos(RC.r2), cos(RC.r1));
-#endif
-}
-
-inline const doubleV ThermalForceLocalized::randomSin(const RandCache &RC) {
-#ifdef __AVX__
-    return _mm256_set_pd(sin(RC.r4), sin(RC.r3), sin(RC.r2), sin(RC.r1));
-#else
-    return _mm_set_pd(sin(RC.r2), sin(RC.r1));
-#endif 
+	doubleV directionX, directionY;
+	RandomNumbers::direction_pd(angle, directionX, directionY);
+	plusEqual_pd(targetX + currentParticle, mul_pd(thermV, directionX));
+	plusEqual_pd(targetY + currentParticle, mul_pd(thermV, directionY));
 }
 
 void ThermalForceLocalized::writeForce(fitsfile * const file, int * const error) const {
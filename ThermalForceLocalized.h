@@ -30,16 +30,10 @@ private:
 	double heatVal1;	  //<! Strength of thermal force inside heatingRadius [N]
 	double heatVal2; 	  //<! Strength of thermal force outside heatingRadius [N]
 
-    RandCache *evenRandCache, *oddRandCache;
-#ifdef DISPATCH_QUEUES
-	dispatch_group_t evenRandGroup, oddRandGroup;
-	dispatch_queue_t randQueue;
-#endif
-
-	void force(const cloud_index currentParticle, const doubleV displacementX, const doubleV displacementY, 
-               const RandCache &RC);
-    static const doubleV randomCos(const RandCache &RC);
-    static const doubleV randomSin(const RandCache &RC);
+	const uint32_t stream; //<! Stream of the random numbers of this force
+	uint64_t substep;      //<! Substeps computed, counted from the first substep of the run, which key their random numbers
+
+	void force(const cloud_index currentParticle, const doubleV displacementX, const doubleV displacementY);
 };
 
 #endif // THERMALFORCELOCALIZED_H
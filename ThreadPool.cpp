@@ -0,0 +1,156 @@
+/**
+* @file  ThreadPool.cpp
+* @class ThreadPool ThreadPool.h
+*
+* @brief Work-stealing pool of std::threads, which runs the parallel loops and
+*        tasks where neither OpenMP nor libDispatch is available
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "Parallel.h"
+
+#ifdef THREAD_POOL
+#include <cstdlib>
+
+thread_local cloud_index ThreadPool::threadIndex = 0;
+
+/**
+* @brief Returns the pool, which is started on first use.
+*
+* @details The pool has one thread per processor, or DEMON_NUM_THREADS if that
+*          is set, including the calling thread.
+*
+* @return The pool
+**/
+ThreadPool &ThreadPool::instance() {
+	static ThreadPool pool([]() {
+		const char * const setting = std::getenv("DEMON_NUM_THREADS");
+		const cloud_index numThreads = setting ? (cloud_index)std::atoi(setting) : (cloud_index)std::thread::hardware_concurrency();
+		return std::max(numThreads, (cloud_index)1);
+	}());
+	return pool;
+}
+
+/**
+* @brief Constructor for the ThreadPool class
+* @param[in] numThreads Number of threads, including the calling thread
+**/
+ThreadPool::ThreadPool(const cloud_index numThreads)
+: numQueues(numThreads), queues(new Queue[numThreads]), numQueued(0), numSleeping(0), stopping(false) {
+	for (cloud_index index = 1; index < numQueues; index++)
+		workers.emplace_back(&ThreadPool::work, this, index);
+}
+
+/**
+* @brief Destructor for the ThreadPool class
+**/
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+/**
+* @brief Queues a task on the queue of the calling thread and wakes a worker
+*        if one sleeps.
+*
+* @param[in] task Task to run
+**/
+void ThreadPool::submit(Task task) {
+	Queue &queue = queues[threadIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.tasks.push_back(std::move(task));
+	}
+	numQueued.fetch_add(1);
+
+	// A worker counts itself as sleeping before it checks numQueued, so either
+	// it sees the task or it is woken here.
+	if (numSleeping.load()) {
+		{
+			std::lock_guard<std::mutex> lock(sleepLock);
+		}
+		wakeUp.notify_one();
+	}
+}
+
+/**
+* @brief Runs the newest task of the own queue, or else steals the oldest
+*        task of another queue.
+*
+* @param[in] self Queue of the calling thread
+*
+* @return True if a task ran
+**/
+bool ThreadPool::tryRun(const cloud_index self) {
+	Task task;
+	for (cloud_index k = 0; k < numQueues && !task; k++) {
+		Queue &queue = queues[(self + k)%numQueues];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (queue.tasks.empty())
+			continue;
+		if (k) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		} else {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+	}
+	if (!task)
+		return false;
+
+	numQueued.fetch_sub(1);
+	task();
+	return true;
+}
+
+/**
+* @brief Runs queued tasks until no more of the given ones are pending.
+*
+* @details The waiting thread works on whatever tasks are queued, so waits
+*          inside tasks never leave a thread idle or block the pool.
+*
+* @param[in] pending Number of tasks not done yet, which they count down
+**/
+void ThreadPool::wait(const std::atomic<cloud_index> &pending) {
+	const cloud_index self = threadIndex;
+	while (pending.load(std::memory_order_acquire))
+		if (!tryRun(self))
+			std::this_thread::yield();
+}
+
+/**
+* @brief Runs the tasks of a worker thread until the pool ends.
+*
+* @details Workers keep looking for tasks for a while before they sleep, since
+*          the next parallel loop usually follows soon.
+*
+* @param[in] index Queue of the worker
+**/
+void ThreadPool::work(const cloud_index index) {
+	threadIndex = index;
+	while (true) {
+		bool ran = false;
+		for (unsigned spin = 0; spin < 256 && !ran; spin++)
+			if (!(ran = tryRun(index)))
+				std::this_thread::yield();
+		if (ran)
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		numSleeping.fetch_add(1);
+		wakeUp.wait(lock, [this]() { return stopping || numQueued.load() > 0; });
+		numSleeping.fetch_sub(1);
+		if (stopping)
+			return;
+	}
+}
+
+#endif // THREAD_POOL
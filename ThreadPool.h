@@ -0,0 +1,140 @@
+/**
+* @file  ThreadPool.h
+* @brief Defines the data and methods of the ThreadPool and TaskGroup classes
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Included by Parallel.h, which defines cloud_index first.
+class ThreadPool {
+public:
+	typedef std::function<void()> Task;
+
+	//!< Chunks of a parallel loop per thread, by the kind of the loop:
+	enum Chunks : cloud_index {
+		staticChunks = 1, //!< One chunk per thread, for loops whose iterations cost the same
+		dynamicChunks = 8 //!< Smaller chunks that idle threads steal, for uneven iterations
+	};
+
+	static ThreadPool &instance();
+
+	cloud_index numThreads() const { return numQueues; } //!< Worker threads plus the calling thread
+
+	template <typename Body>
+	void parallelFor(const cloud_index num, const cloud_index step, const cloud_index chunksPerThread,
+	                 const Body &body);
+	void submit(Task task);
+	void wait(const std::atomic<cloud_index> &pending);
+
+private:
+	//!< Tasks of one thread, which it takes from the back and others steal from the front:
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	static thread_local cloud_index threadIndex; //!< Queue of the current thread, 0 for threads outside the pool
+
+	const cloud_index numQueues;          //!< Number of queues, one per worker and one for the calling thread
+	std::unique_ptr<Queue[]> queues;      //!< Queue of each thread
+	std::vector<std::thread> workers;     //!< Worker threads
+	std::atomic<cloud_index> numQueued;   //!< Number of tasks in all queues
+	std::atomic<cloud_index> numSleeping; //!< Number of workers waiting for tasks
+	std::mutex sleepLock;                 //!< Guards sleeping and waking the workers
+	std::condition_variable wakeUp;       //!< Signals new tasks or the end to sleeping workers
+	bool stopping;                        //!< True once the workers should end
+
+	ThreadPool(const cloud_index numThreads);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	bool tryRun(const cloud_index self);
+	void work(const cloud_index index);
+};
+
+/**
+* @brief Runs a loop body for every step of [0, num).
+*
+* @details The steps are split into consecutive chunks, all but the first of
+*          which are queued for the pool, while the calling thread runs the
+*          first and then helps with the others until all are done. Loops
+*          inside the body split the same way, so they nest without blocking
+*          a thread.
+*
+* @param[in] num             End of the loop
+* @param[in] step            Step of the loop
+* @param[in] chunksPerThread Chunks of the loop per thread
+* @param[in] body            Body of the loop, called with each step
+**/
+template <typename Body>
+void ThreadPool::parallelFor(const cloud_index num, const cloud_index step, const cloud_index chunksPerThread,
+                             const Body &body) {
+	const long long numSteps = num > 0 ? (num + step - 1)/step : 0;
+	const long long numChunks = std::min(numSteps, (long long)numQueues*chunksPerThread);
+	if (numChunks < 2) {
+		for (cloud_index i = 0; i < num; i += step)
+			body(i);
+		return;
+	}
+
+	std::atomic<cloud_index> pending((cloud_index)numChunks - 1);
+	const auto chunk = [&body, numSteps, numChunks, step](const long long c) {
+		for (cloud_index i = (cloud_index)(c*numSteps/numChunks*step), end = (cloud_index)((c + 1)*numSteps/numChunks*step);
+		     i < end; i += step)
+			body(i);
+	};
+	for (long long c = numChunks - 1; c > 0; c--)
+		submit([&chunk, &pending, c]() {
+			chunk(c);
+			pending.fetch_sub(1, std::memory_order_release);
+		});
+	chunk(0);
+	wait(pending);
+}
+
+/**
+* @brief Group of tasks that run concurrently on the ThreadPool until the
+*        group waits for them.
+**/
+class TaskGroup {
+public:
+	TaskGroup() : pending(0) {}
+	~TaskGroup() { wait(); }
+
+	/**
+	* @brief Queues a task of the group.
+	* @param[in] task Task to run
+	**/
+	void run(const ThreadPool::Task &task) {
+		pending.fetch_add(1, std::memory_order_relaxed);
+		ThreadPool::instance().submit([this, task]() {
+			task();
+			pending.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	/**
+	* @brief Helps with the queued tasks until those of the group are done.
+	**/
+	void wait() { ThreadPool::instance().wait(pending); }
+
+private:
+	std::atomic<cloud_index> pending; //!< Tasks of the group that have not finished
+};
+
+#endif // THREADPOOL_H
@@ -11,22 +11,30 @@
 #include "TimeVaryingDragForce.h"
 
 void TimeVaryingDragForce::force1(const double currentTime) {
-	dragConst = calculateGamma(currentTime);
+	BEGIN_SERIAL
+		dragConst = calculateGamma(currentTime);
+	END_SERIAL
 	DragForce::force1(currentTime);
 }
 
 void TimeVaryingDragForce::force2(const double currentTime) {
-	dragConst = calculateGamma(currentTime);
+	BEGIN_SERIAL
+		dragConst = calculateGamma(currentTime);
+	END_SERIAL
 	DragForce::force2(currentTime);
 }
 
 void TimeVaryingDragForce::force3(const double currentTime) {
-	dragConst = calculateGamma(currentTime);
+	BEGIN_SERIAL
+		dragConst = calculateGamma(currentTime);
+	END_SERIAL
 	DragForce::force3(currentTime);
 }
 
 void TimeVaryingDragForce::force4(const double currentTime) {
-	dragConst = calculateGamma(currentTime);
+	BEGIN_SERIAL
+		dragConst = calculateGamma(currentTime);
+	END_SERIAL
 	DragForce::force4(currentTime);
 }
 
@@ -39,6 +47,22 @@ inline const double TimeVaryingDragForce::calculateGamma(const double currentTim
 	return -(scaleConst*currentTime + offsetConst);
 }
 
+/**
+* @brief Adds the drag rate at the given time, which ExponentialVerlet solves
+*        exactly.
+*
+* @param[in]     currentTime The current time of the simulation
+* @param[in,out] drag        Drag rate [Hz]
+* @param[in,out] field       Magnetic field in the z-direction [T]
+*
+* @return True
+**/
+bool TimeVaryingDragForce::linearVelocityTerms(const double currentTime, double &drag, double &field) const {
+	(void)field;
+	drag -= calculateGamma(currentTime);
+	return true;
+}
+
 void TimeVaryingDragForce::writeForce(fitsfile * const file, int * const error) const {
 	DragForce::writeForce(file, error);
 	
@@ -24,6 +24,7 @@ public:
 	
 	void writeForce(fitsfile *file, int *error) const;
 	void readForce(fitsfile *file, int *error);
+	bool linearVelocityTerms(const double currentTime, double &drag, double &field) const;
 
 private:
 	double scaleConst;
@@ -12,22 +12,30 @@
 #include "TimeVaryingThermalForce.h"
 
 void TimeVaryingThermalForce::force1(const double currentTime) {
-	heatVal = calculateHeatVal(currentTime);
+	BEGIN_SERIAL
+		heatVal = calculateHeatVal(currentTime);
+	END_SERIAL
 	ThermalForce::force1(currentTime);
 }
 
 void TimeVaryingThermalForce::force2(const double currentTime) {
-	heatVal = calculateHeatVal(currentTime);
+	BEGIN_SERIAL
+		heatVal = calculateHeatVal(currentTime);
+	END_SERIAL
 	ThermalForce::force2(currentTime);
 }
 
 void TimeVaryingThermalForce::force3(const double currentTime) {
-	heatVal = calculateHeatVal(currentTime);
+	BEGIN_SERIAL
+		heatVal = calculateHeatVal(currentTime);
+	END_SERIAL
 	ThermalForce::force3(currentTime);
 }
 
 void TimeVaryingThermalForce::force4(const double currentTime) {
-	heatVal = calculateHeatVal(currentTime);
+	BEGIN_SERIAL
+		heatVal = calculateHeatVal(currentTime);
+	END_SERIAL
 	ThermalForce::force4(currentTime);
 }
 
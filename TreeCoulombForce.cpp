@@ -0,0 +1,229 @@
+/**
+* @file  TreeCoulombForce.cpp
+* @class TreeCoulombForce TreeCoulombForce.h
+*
+* @brief Models the shielded coulomb interaction with a Barnes-Hut tree, for
+*        clouds that are not much wider than the shielding distance
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "TreeCoulombForce.h"
+#include <cmath>
+
+const double TreeCoulombForce::coulomb = 1.0/(4.0*M_PI*Cloud::epsilon0);
+
+TreeCoulombForce::TreeCoulombForce(Cloud * const C, const double shieldingConstant, const double theta)
+: Force(C), shielding(shieldingConstant), openingAngle(theta), tree(C->n),
+numBuilds(0), totalNodes(0.0), totalLevels(0.0) {}
+
+void TreeCoulombForce::force1(const double currentTime) {
+    (void)currentTime;
+    treeForce(cloud->x, cloud->y);
+}
+
+void TreeCoulombForce::force2(const double currentTime) {
+    (void)currentTime;
+    treeForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void TreeCoulombForce::force3(const double currentTime) {
+    (void)currentTime;
+    treeForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+void TreeCoulombForce::force4(const double currentTime) {
+    (void)currentTime;
+    treeForce((const double *)cloud->xCache, (const double *)cloud->yCache);
+}
+
+/**
+* @brief Computes the force on every particle by walking the tree.
+*
+* @details A cell is expanded into its moments when the particle is farther
+*          from the expansion center than side/openingAngle plus the distance
+*          from the middle of the cell to the expansion center. This keeps the
+*          particle outside the cell for an opening angle up to 1. Cells that
+*          are entirely beyond 10*(ion debye length) are skipped and leaves that
+*          are too close are summed directly. The particles are visited in tree
+*          order, so neighboring particles walk similar paths, and each particle
+*          only accumulates its own force.
+*
+* @param[in] x Particle x-positions for the current substep
+* @param[in] y Particle y-positions for the current substep
+**/
+void TreeCoulombForce::treeForce(const double * const x, const double * const y) {
+	tree.build(x, y, cloud->charge);
+	BEGIN_SERIAL
+		++numBuilds;
+		totalNodes += (double)tree.nodes.size();
+		totalLevels += (double)tree.numLevels;
+	END_SERIAL
+
+	const double cutoff = 10.0/shielding;
+	const QuadTree::Node * const nodes = tree.nodes.data();
+	BEGIN_PARALLEL_FOR(p, e, tree.n, 1, static)
+		const double x1 = tree.sortedX[p], y1 = tree.sortedY[p];
+		const doubleV vx1 = set1_pd(x1), vy1 = set1_pd(y1);
+		doubleV forcevX = set0_pd(), forcevY = set0_pd();
+		double forceX = 0.0, forceY = 0.0;
+
+		// Depth first walk, at most three siblings per level wait on the stack.
+		cloud_index stack[3*QuadTree::maxDepth + 4];
+		unsigned top = 0;
+		stack[top++] = 0;
+		while (top) {
+			const QuadTree::Node &node = nodes[stack[--top]];
+			const double displacementX = x1 - node.centerX, displacementY = y1 - node.centerY;
+			const double displacement2 = displacementX*displacementX + displacementY*displacementY;
+
+			const double reach = cutoff + node.offset + M_SQRT1_2*node.side;
+			if (displacement2 >= reach*reach)
+				continue;
+
+			const double open = node.side/openingAngle + node.offset;
+			if (displacement2 > open*open)
+				multipoleForce(node, displacementX, displacementY, forceX, forceY);
+			else if (!node.numChildren)
+				leafForce(vx1, vy1, node, forcevX, forcevY);
+			else
+				for (cloud_index child = 0; child < node.numChildren; child++)
+					stack[top++] = node.firstChild + child;
+		}
+
+		const cloud_index currentParticle = tree.particles[p];
+		const double q1 = coulomb*tree.sortedCharge[p];
+		targetX[currentParticle] += q1*(forceX + sum_pd(forcevX));
+		targetY[currentParticle] += q1*(forceY + sum_pd(forcevY));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Adds the force of the moments of a cell, without the charge of the
+*        particle or the coulomb constant.
+*
+* @details The potential exp(-s*r)/r of the cell is expanded to second order
+*          about its expansion center. With g_n the n-th application of
+*          (1/r)d/dr to the potential, its derivatives along the displacement
+*          d are sums of g_n times products of d and unit tensors, which gives
+*          F = -(Q*g1*d - g1*D - g2*(D.d)*d + g2*tr(M)*d/2 + g2*M.d + g3*(d.M.d)*d/2)
+*          for monopole Q, dipole D and second moment M.
+*
+* @param[in]     node          The cell
+* @param[in]     displacementX x-displacement from the expansion center
+* @param[in]     displacementY y-displacement from the expansion center
+* @param[in,out] forceX        Accumulated x-force
+* @param[in,out] forceY        Accumulated y-force
+**/
+inline void TreeCoulombForce::multipoleForce(const QuadTree::Node &node, const double displacementX,
+                                             const double displacementY, double &forceX, double &forceY) const {
+	const double displacement2 = displacementX*displacementX + displacementY*displacementY;
+	const double displacement = sqrt(displacement2);
+	const double valExp = displacement*shielding;
+	const double expTerm = exp(-valExp);
+	const double displacement3 = displacement2*displacement;
+	const double g1 = -expTerm*(1.0 + valExp)/displacement3;
+	const double g2 = expTerm*(3.0 + valExp*(3.0 + valExp))/(displacement3*displacement2);
+	const double g3 = -expTerm*(15.0 + valExp*(15.0 + valExp*(6.0 + valExp)))/(displacement3*displacement2*displacement2);
+
+	const double dipoleD = node.dipoleX*displacementX + node.dipoleY*displacementY;
+	const double quadDX = node.quadXX*displacementX + node.quadXY*displacementY;
+	const double quadDY = node.quadXY*displacementX + node.quadYY*displacementY;
+	const double radial = node.charge*g1 - g2*dipoleD + 0.5*g2*(node.quadXX + node.quadYY)
+	                      + 0.5*g3*(displacementX*quadDX + displacementY*quadDY);
+	forceX -= radial*displacementX - g1*node.dipoleX + g2*quadDX;
+	forceY -= radial*displacementY - g1*node.dipoleY + g2*quadDY;
+}
+
+/**
+* @brief Adds the pair forces of the particles of a leaf, without the charge of
+*        the particle or the coulomb constant.
+*
+* @param[in]     vx1     x-position of the particle
+* @param[in]     vy1     y-position of the particle
+* @param[in]     node    The leaf
+* @param[in,out] forcevX Accumulated x-force
+* @param[in,out] forcevY Accumulated y-force
+**/
+inline void TreeCoulombForce::leafForce(const doubleV vx1, const doubleV vy1, const QuadTree::Node &node,
+                                        doubleV &forcevX, doubleV &forcevY) const {
+	for (cloud_index j = node.begin; j < node.end; j += DOUBLE_STRIDE) {
+		const doubleV displacementX = sub_pd(vx1, loadu_pd(tree.sortedX + j));
+		const doubleV displacementY = sub_pd(vy1, loadu_pd(tree.sortedY + j));
+		const doubleV displacement2 = add_pd(mul_pd(displacementX, displacementX), mul_pd(displacementY, displacementY));
+		const doubleV displacement = sqrt_pd(displacement2);
+		const doubleV valExp = mul_pd(displacement, shielding);
+
+		// Drop lanes past the leaf, the particle itself and pairs beyond 10*(ion debye length).
+		const doubleV valid = and_pd(and_pd(cmplt_pd(laneIndex_pd(), (double)(node.end - j)), cmpgt_pd(displacement2, 0.0)),
+		                             cmplt_pd(valExp, 10.0));
+		if (!movemask_pd(valid))
+			continue;
+
+		const doubleV forceC = and_pd(valid, div_pd(mul_pd(mul_pd(loadu_pd(tree.sortedCharge + j), add_pd(set1_pd(1.0), valExp)),
+		                                                   exp_pd(valid, sub_pd(set0_pd(), valExp))), mul_pd(displacement2, displacement)));
+		forcevX = fmadd_pd(forceC, displacementX, forcevX);
+		forcevY = fmadd_pd(forceC, displacementY, forcevY);
+	}
+}
+
+void TreeCoulombForce::writeForce(fitsfile * const file, int * const error) const {
+	// move to primary HDU:
+	if (!*error)
+		// file, # indicating primary HDU, HDU type, error
+ 		fits_movabs_hdu(file, 1, IMAGE_HDU, error);
+
+	// add flag indicating that the tree coulomb force is used:
+	if (!*error) {
+		long forceFlags = 0;
+		fits_read_key_lng(file, const_cast<char *> ("FORCES"), &forceFlags, NULL, error);
+
+		// add TreeCoulombForce bit:
+		forceFlags |= TreeCoulombForceFlag;
+
+		if (*error == KEY_NO_EXIST || *error == VALUE_UNDEFINED)
+			*error = 0; // clear above error.
+
+		// add or update keyword.
+		if (!*error)
+			fits_update_key(file, TLONG, const_cast<char *> ("FORCES"), &forceFlags,
+                            const_cast<char *> ("Force configuration."), error);
+	}
+
+	if (!*error)
+		// file, key name, value, precision (scientific format), comment
+		fits_write_key_dbl(file, const_cast<char *> ("shieldingConstant"), shielding,
+                           6, const_cast<char *> ("[m^-1] (TreeCoulombForce)"), error);
+
+	if (!*error)
+		// file, key name, value, precision (scientific format), comment
+		fits_write_key_dbl(file, const_cast<char *> ("openingAngle"), openingAngle,
+                           6, const_cast<char *> ("(TreeCoulombForce)"), error);
+}
+
+void TreeCoulombForce::readForce(fitsfile * const file, int * const error) {
+	// move to primary HDU:
+	if (!*error)
+		// file, # indicating primary HDU, HDU type, error
+ 		fits_movabs_hdu(file, 1, IMAGE_HDU, error);
+
+	if (!*error)
+		// file, key name, value, don't read comment, error
+		fits_read_key_dbl(file, const_cast<char *> ("shieldingConstant"), &shielding, NULL, error);
+
+	if (!*error)
+		// file, key name, value, don't read comment, error
+		fits_read_key_dbl(file, const_cast<char *> ("openingAngle"), &openingAngle, NULL, error);
+}
+
+/**
+* @brief Prints the average size of the tree.
+*
+* @param[in] out Stream to print to
+**/
+void TreeCoulombForce::printStatistics(std::ostream &out) const {
+	out << "Coulomb tree: " << numBuilds << " builds with " << (numBuilds ? totalNodes/numBuilds : 0.0)
+	<< " cells in " << (numBuilds ? totalLevels/numBuilds : 0.0) << " levels on average (opening angle "
+	<< openingAngle << ")." << std::endl;
+}
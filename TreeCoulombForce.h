@@ -0,0 +1,47 @@
+/**
+* @file  TreeCoulombForce.h
+* @brief Defines the data and methods of the TreeCoulombForce class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef TREECOULOMBFORCE_H
+#define TREECOULOMBFORCE_H
+
+#include "Force.h"
+#include "QuadTree.h"
+#include "VectorCompatibility.h"
+
+class TreeCoulombForce : public Force {
+public:
+	TreeCoulombForce(Cloud * const C, const double shieldingConstant, const double theta);
+	~TreeCoulombForce() {}
+
+	void force1(const double currentTime); //rk substep 1
+	void force2(const double currentTime); //rk substep 2
+	void force3(const double currentTime); //rk substep 3
+	void force4(const double currentTime); //rk substep 4
+
+	void writeForce(fitsfile * const file, int * const error) const;
+	void readForce(fitsfile * const file, int * const error);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	double shielding;    //<! Inverse of shielding distance [m^-1]
+	double openingAngle; //<! Cells narrower than openingAngle times their distance are expanded
+	QuadTree tree;       //<! Tree rebuilt from the positions of every substep
+	unsigned long numBuilds;  //<! Number of tree builds
+	double totalNodes;        //<! Sum of the number of cells over all builds
+	double totalLevels;       //<! Sum of the number of levels over all builds
+
+	static const double coulomb; //<! Coulomb constant: 8.987551787 [m/F]
+
+	void treeForce(const double * const x, const double * const y);
+	void multipoleForce(const QuadTree::Node &node, const double displacementX, const double displacementY,
+	                    double &forceX, double &forceY) const;
+	void leafForce(const doubleV vx1, const doubleV vy1, const QuadTree::Node &node,
+	               doubleV &forcevX, doubleV &forcevY) const;
+};
+
+#endif // TREECOULOMBFORCE_H
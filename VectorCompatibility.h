@@ -9,6 +9,7 @@
 #ifndef VECTORCOMPATIBILITY_H
 #define VECTORCOMPATIBILITY_H
 
+#include <cmath>
 #include <immintrin.h>
 
 #ifndef __SSE4_2__
@@ -16,13 +17,13 @@
 #endif
 
 #ifdef __AVX__
-#error AVX support is incomplete.
 
 #define FLOAT_STRIDE  8
 #define DOUBLE_STRIDE 4
 
 typedef __m256d doubleV;
 typedef __m256 floatV;
+typedef __m256i indexV; //!< 64 bit integer per doubleV lane
 
 #else
 
@@ -31,9 +32,67 @@ typedef __m256 floatV;
 
 typedef __m128d doubleV;
 typedef __m128 floatV;
+typedef __m128i indexV; //!< 64 bit integer per doubleV lane
 
 #endif
 
+/*===- Memory -------------------------------------------------------------===*/
+
+// new[] only guarantees 16 byte alignment, which is not enough for AVX vectors.
+// Arrays that are accessed with load_pd or store_pd are allocated with these.
+template <typename T>
+static inline T * const alignedNew(const size_t num) {
+    return (T *)_mm_malloc(num*sizeof(T), sizeof(doubleV));
+}
+
+template <typename T>
+static inline void alignedDelete(T * const a) {
+    _mm_free(a);
+}
+
+/*===- Permute ------------------------------------------------------------===*/
+
+// Returns the lanes of a in reverse order.
+static inline const doubleV reverse_pd(const doubleV a) {
+#ifdef __AVX__
+    return _mm256_permute_pd(_mm256_permute2f128_pd(a, a, 1), 5);
+#else
+    return _mm_shuffle_pd(a, a, _MM_SHUFFLE2(0, 1));
+#endif
+}
+
+// Rotates the lanes of a by one, so that lane i holds lane i + 1 and the last
+// lane holds lane 0. DOUBLE_STRIDE rotations pair every lane with every other.
+static inline const doubleV rotate_pd(const doubleV a) {
+#ifdef __AVX__
+    return _mm256_shuffle_pd(a, _mm256_permute2f128_pd(a, a, 1), 5);
+#else
+    return _mm_shuffle_pd(a, a, _MM_SHUFFLE2(0, 1));
+#endif
+}
+
+static inline const floatV rotate_ps(const floatV a) {
+#ifdef __AVX__
+    const floatV b = _mm256_permute_ps(a, _MM_SHUFFLE(0, 3, 2, 1));
+    return _mm256_blend_ps(b, _mm256_permute2f128_ps(b, b, 1), 0x88);
+#else
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 3, 2, 1));
+#endif
+}
+
+// Rotates the lanes of low and high as one vector of 2*DOUBLE_STRIDE lanes, the
+// same way rotate_ps rotates the floatV made of them by narrow_ps.
+static inline void rotate_pd(doubleV &low, doubleV &high) {
+    const doubleV rotatedLow = rotate_pd(low), rotatedHigh = rotate_pd(high);
+#ifdef __AVX__
+    low = _mm256_blend_pd(rotatedLow, rotatedHigh, 8);
+    high = _mm256_blend_pd(rotatedHigh, rotatedLow, 8);
+#else
+    low = _mm_blend_pd(rotatedLow, rotatedHigh, 2);
+    high = _mm_blend_pd(rotatedHigh, rotatedLow, 2);
+#endif
+}
+
 /*===- Load/Store ---------------------------------------------------------===*/
 
 static inline void store_pd(double * const a, const doubleV b) {
@@ -44,7 +103,7 @@ static inline void store_pd(double * const a, const doubleV b) {
 #endif
 }
 
-static inline const doubleV load_pd(double * const a) {
+static inline const doubleV load_pd(const double * const a) {
 #ifdef __AVX__
     return _mm256_load_pd(a);
 #else
@@ -52,6 +111,53 @@ static inline const doubleV load_pd(double * const a) {
 #endif
 }
 
+static inline const floatV load_ps(const float * const a) {
+#ifdef __AVX__
+    return _mm256_load_ps(a);
+#else
+    return _mm_load_ps(a);
+#endif
+}
+
+static inline const doubleV loadu_pd(const double * const a) {
+#ifdef __AVX__
+    return _mm256_loadu_pd(a);
+#else
+    return _mm_loadu_pd(a);
+#endif
+}
+
+static inline const doubleV loadr_pd(const double * const a) {
+#ifdef __AVX__
+    return reverse_pd(_mm256_load_pd(a));
+#else
+    return _mm_loadr_pd(a);
+#endif
+}
+
+template <typename T>
+static inline const doubleV gather_pd(const double * const a, const T * const index) {
+#ifdef __AVX__
+    return _mm256_set_pd(a[index[3]], a[index[2]], a[index[1]], a[index[0]]);
+#else
+    return _mm_set_pd(a[index[1]], a[index[0]]);
+#endif
+}
+
+static inline const doubleV gather_pd(const double * const a, const indexV index) {
+#if defined(__AVX2__)
+    return _mm256_i64gather_pd(a, index, sizeof(double));
+#else
+    alignas(indexV) long long i[DOUBLE_STRIDE];
+#ifdef __AVX__
+    _mm256_store_si256((indexV *)i, index);
+#else
+    _mm_store_si128((indexV *)i, index);
+#endif
+    return gather_pd(a, i);
+#endif
+}
+
 /*===- Set ----------------------------------------------------------------===*/
 
 static inline const doubleV set1_pd(const double a) {
@@ -78,6 +184,43 @@ static inline const doubleV set0_pd() {
 #endif
 }
 
+static inline const floatV set0_ps() {
+#ifdef __AVX__
+    return _mm256_setzero_ps();
+#else
+    return _mm_setzero_ps();
+#endif
+}
+
+/*===- Conversion ---------------------------------------------------------===*/
+
+// Rounds two double vectors to one float vector, low in the first lanes.
+static inline const floatV narrow_ps(const doubleV low, const doubleV high) {
+#ifdef __AVX__
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+#else
+    return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+#endif
+}
+
+// Returns the first DOUBLE_STRIDE lanes of a as doubles.
+static inline const doubleV widenLow_pd(const floatV a) {
+#ifdef __AVX__
+    return _mm256_cvtps_pd(_mm256_castps256_ps128(a));
+#else
+    return _mm_cvtps_pd(a);
+#endif
+}
+
+// Returns the last DOUBLE_STRIDE lanes of a as doubles.
+static inline const doubleV widenHigh_pd(const floatV a) {
+#ifdef __AVX__
+    return _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+#else
+    return _mm_cvtps_pd(_mm_movehl_ps(a, a));
+#endif
+}
+
 /*===- Arithmatic ---------------------------------------------------------===*/
 
 static inline void plusEqual_pd(double * const a, const doubleV b) {
@@ -97,13 +240,25 @@ static inline void minusEqual_pd(double * const a, const doubleV b) {
 }
 
 static inline const doubleV fmadd_pd(const doubleV a, const doubleV b, const doubleV c) {
-#ifdef __AVX__
+#if defined(__AVX__) && defined(__FMA__)
     return _mm256_fmadd_pd(a, b, c);
+#elif defined(__AVX__)
+    return _mm256_add_pd(_mm256_mul_pd(a, b), c);
 #else
     return _mm_add_pd(_mm_mul_pd(a, b), c);
 #endif
 }
 
+static inline const floatV fmadd_ps(const floatV a, const floatV b, const floatV c) {
+#if defined(__AVX__) && defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#elif defined(__AVX__)
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
 static inline const doubleV add_pd(const doubleV a, const doubleV b) {
 #ifdef __AVX__
     return _mm256_add_pd(a, b);
@@ -168,6 +323,14 @@ static inline const floatV mul_ps(const floatV a, const floatV b) {
 #endif
 }
 
+static inline const floatV mul_ps(const floatV a, const float b) {
+#ifdef __AVX__
+    return _mm256_mul_ps(a, _mm256_set1_ps(b));
+#else
+    return _mm_mul_ps(a, _mm_set1_ps(b));
+#endif
+}
+
 static inline const doubleV div_pd(const doubleV a, const doubleV b) {
 #ifdef __AVX__
     return _mm256_div_pd(a, b);
@@ -184,6 +347,14 @@ static inline const doubleV div_pd(const doubleV a, const double b) {
 #endif
 }
 
+static inline const floatV div_ps(const floatV a, const floatV b) {
+#ifdef __AVX__
+    return _mm256_div_ps(a, b);
+#else
+    return _mm_div_ps(a, b);
+#endif
+}
+
 static inline const doubleV sqrt_pd(const doubleV a) {
 #ifdef __AVX__
     return _mm256_sqrt_pd(a);
@@ -200,6 +371,66 @@ static inline const floatV sqrt_ps(const floatV a) {
 #endif
 }
 
+static inline const doubleV round_pd(const doubleV a) {
+#ifdef __AVX__
+    return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#else
+    return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#endif
+}
+
+static inline const doubleV floor_pd(const doubleV a) {
+#ifdef __AVX__
+    return _mm256_floor_pd(a);
+#else
+    return _mm_floor_pd(a);
+#endif
+}
+
+static inline const floatV round_ps(const floatV a) {
+#ifdef __AVX__
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#else
+    return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#endif
+}
+
+// Returns b in lanes where either argument is NaN.
+static inline const doubleV min_pd(const doubleV a, const doubleV b) {
+#ifdef __AVX__
+    return _mm256_min_pd(a, b);
+#else
+    return _mm_min_pd(a, b);
+#endif
+}
+
+// Returns b in lanes where either argument is NaN.
+static inline const doubleV max_pd(const doubleV a, const doubleV b) {
+#ifdef __AVX__
+    return _mm256_max_pd(a, b);
+#else
+    return _mm_max_pd(a, b);
+#endif
+}
+
+// Returns b in lanes where either argument is NaN.
+static inline const floatV min_ps(const floatV a, const floatV b) {
+#ifdef __AVX__
+    return _mm256_min_ps(a, b);
+#else
+    return _mm_min_ps(a, b);
+#endif
+}
+
+// Returns b in lanes where either argument is NaN.
+static inline const floatV max_ps(const floatV a, const floatV b) {
+#ifdef __AVX__
+    return _mm256_max_ps(a, b);
+#else
+    return _mm_max_ps(a, b);
+#endif
+}
+
 /*===- Comparison ---------------------------------------------------------===*/
 
 static inline const int movemask_pd(const doubleV a) {
@@ -220,23 +451,55 @@ static inline const int movemask_ps(const floatV a) {
 
 static inline const floatV cmple_ps(const floatV a, const floatV b) {
 #ifdef __AVX__
-    return _mm256_cmp_ps(a, b, LE_OS);
+    return _mm256_cmp_ps(a, b, _CMP_LE_OS);
 #else
     return _mm_cmple_ps(a, b);
 #endif
 }
 
+static inline const floatV cmplt_ps(const floatV a, const float b) {
+#ifdef __AVX__
+    return _mm256_cmp_ps(a, _mm256_set1_ps(b), _CMP_LT_OS);
+#else
+    return _mm_cmplt_ps(a, _mm_set1_ps(b));
+#endif
+}
+
 static inline const doubleV cmpgt_pd(const doubleV a, const double b) {
 #ifdef __AVX__
-    return _mm256_cmp_pd(a, _mm256_set1_pd(b), LT_OS);
+    return _mm256_cmp_pd(a, _mm256_set1_pd(b), _CMP_GT_OS);
 #else
     return _mm_cmpgt_pd(a, _mm_set1_pd(b));
 #endif
 }
 
+static inline const doubleV cmpgt_pd(const doubleV a, const doubleV b) {
+#ifdef __AVX__
+    return _mm256_cmp_pd(a, b, _CMP_GT_OS);
+#else
+    return _mm_cmpgt_pd(a, b);
+#endif
+}
+
+static inline const doubleV cmplt_pd(const doubleV a, const doubleV b) {
+#ifdef __AVX__
+    return _mm256_cmp_pd(a, b, _CMP_LT_OS);
+#else
+    return _mm_cmplt_pd(a, b);
+#endif
+}
+
+static inline const doubleV cmpeq_pd(const doubleV a, const double b) {
+#ifdef __AVX__
+    return _mm256_cmp_pd(a, _mm256_set1_pd(b), _CMP_EQ_OQ);
+#else
+    return _mm_cmpeq_pd(a, _mm_set1_pd(b));
+#endif
+}
+
 static inline const doubleV cmplt_pd(const doubleV a, const double b) {
 #ifdef __AVX__
-    return _mm256_cmp_pd(a, _mm256_set1_pd(b), GT_OS);
+    return _mm256_cmp_pd(a, _mm256_set1_pd(b), _CMP_LT_OS);
 #else
     return _mm_cmplt_pd(a, _mm_set1_pd(b));
 #endif
@@ -252,45 +515,406 @@ static inline const doubleV and_pd(const doubleV a, const doubleV b) {
 #endif
 }
 
-/*===- math functions -----------------------------------------------------===*/
+static inline const doubleV or_pd(const doubleV a, const doubleV b) {
+#ifdef __AVX__
+    return _mm256_or_pd(a, b);
+#else
+    return _mm_or_pd(a, b);
+#endif
+}
 
-static inline const doubleV exp_pd(const doubleV a) {
-    double b[DOUBLE_STRIDE];
-    store_pd(b, a);
-    
+static inline const doubleV xor_pd(const doubleV a, const doubleV b) {
 #ifdef __AVX__
-    return _mm256_set_pd(exp(b[3]), exp(b[2]), exp(b[1]), exp(b[0]));
+    return _mm256_xor_pd(a, b);
 #else
-    return _mm_set_pd(exp(b[1]), exp(b[0]));
+    return _mm_xor_pd(a, b);
 #endif
 }
 
-static inline const doubleV sin_pd(const doubleV a) {
-    double b[DOUBLE_STRIDE];
-    store_pd(b, a);
-    
+static inline const floatV and_ps(const floatV a, const floatV b) {
 #ifdef __AVX__
-    return _mm256_set_pd(sin(b[3]), sin(b[2]), sin(b[1]), sin(b[0]));
+    return _mm256_and_ps(a, b);
 #else
-    return _mm_set_pd(sin(b[1]), sin(b[0]));
+    return _mm_and_ps(a, b);
 #endif
 }
 
-static inline const doubleV cos_pd(const doubleV a) {
-    double b[DOUBLE_STRIDE];
-    store_pd(b, a);
-    
+// Returns b in the lanes where mask is set and a elsewhere.
+static inline const doubleV blendv_pd(const doubleV a, const doubleV b, const doubleV mask) {
+#ifdef __AVX__
+    return _mm256_blendv_pd(a, b, mask);
+#else
+    return _mm_blendv_pd(a, b, mask);
+#endif
+}
+
+// Returns a vector with the bit pattern bits in every lane.
+static inline const doubleV setBits_pd(const long long bits) {
+#ifdef __AVX__
+    return _mm256_castsi256_pd(_mm256_set1_epi64x(bits));
+#else
+    return _mm_castsi128_pd(_mm_set1_epi64x(bits));
+#endif
+}
+
+// Returns (bits of a >> shift) - offset as a 64 bit integer per lane.
+static inline const indexV bitIndex_pd(const doubleV a, const int shift, const long long offset) {
+#if defined(__AVX2__)
+    return _mm256_sub_epi64(_mm256_srli_epi64(_mm256_castpd_si256(a), shift), _mm256_set1_epi64x(offset));
+#elif defined(__AVX__)
+    // AVX has no 256 bit integer instructions, so each half is shifted with SSE.
+    const __m128i o = _mm_set1_epi64x(offset);
+    const __m128i low = _mm_sub_epi64(_mm_srli_epi64(_mm_castpd_si128(_mm256_castpd256_pd128(a)), shift), o);
+    const __m128i high = _mm_sub_epi64(_mm_srli_epi64(_mm_castpd_si128(_mm256_extractf128_pd(a, 1)), shift), o);
+    return _mm256_insertf128_si256(_mm256_castsi128_si256(low), high, 1);
+#else
+    return _mm_sub_epi64(_mm_srli_epi64(_mm_castpd_si128(a), shift), _mm_set1_epi64x(offset));
+#endif
+}
+
+/*===- 64 bit integer lanes -----------------------------------------------===*/
+
+#if defined(__AVX__) && !defined(__AVX2__)
+// AVX has no 256 bit integer instructions, so these apply an SSE operation to
+// each half.
+template <typename Op>
+static inline const indexV halves_epi64(const indexV a, const indexV b, const Op op) {
+    const __m128i low = op(_mm256_castsi256_si128(a), _mm256_castsi256_si128(b));
+    const __m128i high = op(_mm256_extractf128_si256(a, 1), _mm256_extractf128_si256(b, 1));
+    return _mm256_insertf128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+#endif
+
+static inline const indexV set1_epi64(const long long a) {
+#ifdef __AVX__
+    return _mm256_set1_epi64x(a);
+#else
+    return _mm_set1_epi64x(a);
+#endif
+}
+
+// Loads DOUBLE_STRIDE unsigned 32 bit integers, one into each lane.
+template <typename T>
+static inline const indexV loadWide_epi64(const T * const a) {
+#if defined(__AVX2__)
+    return _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)a));
+#elif defined(__AVX__)
+    const __m128i b = _mm_loadu_si128((const __m128i *)a);
+    return _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_cvtepu32_epi64(b)),
+                                   _mm_cvtepu32_epi64(_mm_unpackhi_epi64(b, b)), 1);
+#else
+    return _mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i *)a));
+#endif
+}
+
+static inline const indexV or_epi64(const indexV a, const indexV b) {
+#if defined(__AVX2__)
+    return _mm256_or_si256(a, b);
+#elif defined(__AVX__)
+    return halves_epi64(a, b, [](const __m128i x, const __m128i y) { return _mm_or_si128(x, y); });
+#else
+    return _mm_or_si128(a, b);
+#endif
+}
+
+static inline const indexV xor_epi64(const indexV a, const indexV b) {
+#if defined(__AVX2__)
+    return _mm256_xor_si256(a, b);
+#elif defined(__AVX__)
+    return halves_epi64(a, b, [](const __m128i x, const __m128i y) { return _mm_xor_si128(x, y); });
+#else
+    return _mm_xor_si128(a, b);
+#endif
+}
+
+static inline const indexV slli_epi64(const indexV a, const int shift) {
+#if defined(__AVX2__)
+    return _mm256_slli_epi64(a, shift);
+#elif defined(__AVX__)
+    return halves_epi64(a, a, [shift](const __m128i x, const __m128i) { return _mm_slli_epi64(x, shift); });
+#else
+    return _mm_slli_epi64(a, shift);
+#endif
+}
+
+static inline const indexV srli_epi64(const indexV a, const int shift) {
+#if defined(__AVX2__)
+    return _mm256_srli_epi64(a, shift);
+#elif defined(__AVX__)
+    return halves_epi64(a, a, [shift](const __m128i x, const __m128i) { return _mm_srli_epi64(x, shift); });
+#else
+    return _mm_srli_epi64(a, shift);
+#endif
+}
+
+// Returns the 64 bit products of the low 32 bits of the lanes of a and b.
+static inline const indexV mulWide_epu32(const indexV a, const indexV b) {
+#if defined(__AVX2__)
+    return _mm256_mul_epu32(a, b);
+#elif defined(__AVX__)
+    return halves_epi64(a, b, [](const __m128i x, const __m128i y) { return _mm_mul_epu32(x, y); });
+#else
+    return _mm_mul_epu32(a, b);
+#endif
+}
+
+// Returns integers in [0, 2^52) as doubles, by writing them into the mantissa
+// of 2^52.
+static inline const doubleV smallInt_pd(const indexV a) {
+#ifdef __AVX__
+    const doubleV b = or_pd(_mm256_castsi256_pd(a), setBits_pd(0x4330000000000000ll));
+#else
+    const doubleV b = or_pd(_mm_castsi128_pd(a), setBits_pd(0x4330000000000000ll));
+#endif
+    return sub_pd(b, set1_pd(4503599627370496.0));
+}
+
+// Returns the upper 52 bits of each lane as a double in [0, 1), by writing
+// them into the mantissa of 1.
+static inline const doubleV unitInterval_pd(const indexV bits) {
+    const indexV mantissa = or_epi64(srli_epi64(bits, 12), set1_epi64(0x3FF0000000000000ll));
 #ifdef __AVX__
-    return _mm256_set_pd(cos(b[3]), cos(b[2]), cos(b[1]), cos(b[0]));
+    return sub_pd(_mm256_castsi256_pd(mantissa), set1_pd(1.0));
+#else
+    return sub_pd(_mm_castsi128_pd(mantissa), set1_pd(1.0));
+#endif
+}
+
+/*===- math functions -----------------------------------------------------===*/
+
+// Vectorized exp, log, sin and cos. The error bounds below are the largest
+// errors found by "Benchmark math" against long double libm over 1E7 random
+// arguments per function. The masked variants return 0 in the lanes where mask
+// is clear.
+
+// Returns 2^n for integral n in [-1022, 1023] by writing the exponent bits.
+static inline const doubleV pow2n_pd(const doubleV n) {
+#if defined(__AVX2__)
+    const __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52));
+#elif defined(__AVX__)
+    // AVX has no 256 bit integer instructions, so each half is built with SSE.
+    const __m128i e = _mm256_cvtpd_epi32(n);
+    const __m128i bias = _mm_set1_epi64x(1023);
+    const __m128i low = _mm_slli_epi64(_mm_add_epi64(_mm_cvtepi32_epi64(e), bias), 52);
+    const __m128i high = _mm_slli_epi64(_mm_add_epi64(_mm_cvtepi32_epi64(_mm_unpackhi_epi64(e, e)), bias), 52);
+    return _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_castsi128_pd(low)), _mm_castsi128_pd(high), 1);
 #else
-    return _mm_set_pd(cos(b[1]), cos(b[0]));
+    const __m128i e = _mm_cvtepi32_epi64(_mm_cvtpd_epi32(n));
+    return _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(e, _mm_set1_epi64x(1023)), 52));
 #endif
 }
 
+// exp(a) with at most 1 ULP of error. Underflows to 0 below -745.13 and
+// overflows to infinity above 709.78.
+static inline const doubleV exp_pd(const doubleV a) {
+    // exp(a) = 2^n*exp(r) with n = round(a/ln(2)) and |r| <= ln(2)/2. ln(2) is
+    // split in two so that r1 = a - n*ln2Head is exact and the rounding of
+    // r = r1 - rTail can be deferred to the final sum.
+    const doubleV x = min_pd(set1_pd(710.0), max_pd(set1_pd(-746.0), a));
+    const doubleV n = round_pd(mul_pd(x, 1.4426950408889634074));
+    const doubleV r1 = sub_pd(x, mul_pd(n, 6.93145751953125E-1));
+    const doubleV rTail = mul_pd(n, 1.42860682030941723212E-6);
+    const doubleV r = sub_pd(r1, rTail);
+
+    // Taylor series of (exp(r) - 1 - r)/r^2 to r^11, truncated well below 1 ULP.
+    // Evaluated with Estrin's scheme, which has a shorter dependency chain than
+    // Horner's.
+    const doubleV r2 = mul_pd(r, r);
+    const doubleV r4 = mul_pd(r2, r2);
+    const doubleV p01 = fmadd_pd(set1_pd(1.0/6.0), r, set1_pd(1.0/2.0));
+    const doubleV p23 = fmadd_pd(set1_pd(1.0/120.0), r, set1_pd(1.0/24.0));
+    const doubleV p45 = fmadd_pd(set1_pd(1.0/5040.0), r, set1_pd(1.0/720.0));
+    const doubleV p67 = fmadd_pd(set1_pd(1.0/362880.0), r, set1_pd(1.0/40320.0));
+    const doubleV p89 = fmadd_pd(set1_pd(1.0/39916800.0), r, set1_pd(1.0/3628800.0));
+    const doubleV p1011 = fmadd_pd(set1_pd(1.0/6227020800.0), r, set1_pd(1.0/479001600.0));
+    const doubleV poly = fmadd_pd(fmadd_pd(fmadd_pd(p1011, r2, p89), r4, fmadd_pd(p67, r2, p45)), r4,
+                                  fmadd_pd(p23, r2, p01));
+
+    // exp(r) = (1 + r1) + (r^2*poly - rTail) with the rounding error of 1 + r1
+    // added back.
+    const doubleV head = add_pd(set1_pd(1.0), r1);
+    const doubleV headTail = sub_pd(r1, sub_pd(head, set1_pd(1.0)));
+    const doubleV expr = add_pd(head, add_pd(headTail, fmadd_pd(r2, poly, sub_pd(set0_pd(), rTail))));
+
+    // 2^n is applied in two factors so that results near the limits of the
+    // exponent range neither overflow nor underflow early.
+    const doubleV n1 = round_pd(mul_pd(n, 0.5));
+    return mul_pd(mul_pd(expr, pow2n_pd(n1)), pow2n_pd(sub_pd(n, n1)));
+}
+
+static inline const doubleV exp_pd(const doubleV mask, const doubleV a) {
+    return and_pd(mask, exp_pd(a));
+}
+
+// log(a) with at most 1 ULP of error for positive normal a.
+static inline const doubleV log_pd(const doubleV a) {
+    // a = 2^k*m with m in [sqrt(2)/2, sqrt(2)), so f = m - 1 is small.
+    const doubleV m1 = or_pd(and_pd(a, setBits_pd(0x000FFFFFFFFFFFFFll)), setBits_pd(0x3FF0000000000000ll));
+    const doubleV k1 = smallInt_pd(bitIndex_pd(a, 52, 0));
+    const doubleV halve = cmpgt_pd(m1, 1.41421356237309504880);
+    const doubleV m = blendv_pd(m1, mul_pd(m1, 0.5), halve);
+    const doubleV k = sub_pd(add_pd(k1, and_pd(halve, set1_pd(1.0))), set1_pd(1023.0));
+    const doubleV f = sub_pd(m, set1_pd(1.0));
+
+    // log(1 + f) = f - f^2/2 + s*(f^2/2 + R(s^2)) with s = f/(2 + f) and the
+    // minimax polynomial R of fdlibm. ln(2) is split in two so that k*ln2Head
+    // is exact.
+    const doubleV s = div_pd(f, add_pd(set1_pd(2.0), f));
+    const doubleV z = mul_pd(s, s);
+    const doubleV w = mul_pd(z, z);
+    const doubleV t1 = mul_pd(w, fmadd_pd(fmadd_pd(set1_pd(1.531383769920937332E-1), w,
+                                                   set1_pd(2.222219843214978396E-1)), w,
+                                          set1_pd(3.999999999940941908E-1)));
+    const doubleV t2 = mul_pd(z, fmadd_pd(fmadd_pd(fmadd_pd(set1_pd(1.479819860511658591E-1), w,
+                                                            set1_pd(1.818357216161805012E-1)), w,
+                                                   set1_pd(2.857142874366239149E-1)), w,
+                                          set1_pd(6.666666666666735130E-1)));
+    const doubleV halfF2 = mul_pd(mul_pd(f, f), 0.5);
+    const doubleV tail = fmadd_pd(s, add_pd(halfF2, add_pd(t1, t2)), mul_pd(k, 1.90821492927058770002E-10));
+    return fmadd_pd(k, set1_pd(6.93147180369123816490E-1), sub_pd(f, sub_pd(halfF2, tail)));
+}
+
+// sin(a) and cos(a) with at most 1 ULP of error for |a| < 1E6, except for
+// results within 1E-15 of zero at multiples of pi/2, whose absolute error stays
+// below 1E-30. Beyond 1E6 the reduction by pi/2 loses accuracy.
+static inline void sincos_pd(const doubleV a, doubleV &sinA, doubleV &cosA) {
+    // a = q*pi/2 + r + rTail with |r| <= pi/4. pi/2 is split in three parts 
+    // of 33 bits, so q times the first two is exact for |q| < 2^20. The rounding
+    // error of r is kept in rTail.
+    const doubleV q = round_pd(mul_pd(a, 6.36619772367581382433E-1));
+    const doubleV r1 = sub_pd(a, mul_pd(q, 1.57079632673412561417E0));
+    const doubleV r2 = mul_pd(q, 6.07710050630396597660E-11);
+    const doubleV r3 = mul_pd(q, 2.02226624871116645580E-21);
+    const doubleV r12 = sub_pd(r1, r2);
+    const doubleV r12Round = sub_pd(r12, r1);
+    const doubleV r12Tail = sub_pd(sub_pd(r1, sub_pd(r12, r12Round)), add_pd(r2, r12Round));
+    const doubleV r = sub_pd(r12, r3);
+    const doubleV rTail = sub_pd(add_pd(sub_pd(r12, r), r12Tail), r3);
+
+    // Minimax polynomials on [-pi/4, pi/4] from fdlibm.
+    const doubleV z = mul_pd(r, r);
+    const doubleV sinPoly = fmadd_pd(fmadd_pd(fmadd_pd(fmadd_pd(fmadd_pd(set1_pd(1.58969099521155010221E-10), z,
+                                                                         set1_pd(-2.50507602534068634195E-8)), z,
+                                                                set1_pd(2.75573137070700676789E-6)), z,
+                                                       set1_pd(-1.98412698298579493134E-4)), z,
+                                              set1_pd(8.33333333332248946124E-3)), z,
+                                     set1_pd(-1.66666666666666324348E-1));
+    const doubleV halfZ = mul_pd(z, 0.5);
+    // sin(r + rTail) = sin(r) + rTail*(1 - r^2/2) to the precision needed.
+    const doubleV sinR = add_pd(r, fmadd_pd(mul_pd(z, r), sinPoly, sub_pd(rTail, mul_pd(rTail, halfZ))));
+
+    const doubleV cosPoly = fmadd_pd(fmadd_pd(fmadd_pd(fmadd_pd(fmadd_pd(set1_pd(-1.13596475577881948265E-11), z,
+                                                                         set1_pd(2.08757232129817482790E-9)), z,
+                                                                set1_pd(-2.75573143513906633035E-7)), z,
+                                                       set1_pd(2.48015872894767294178E-5)), z,
+                                              set1_pd(-1.38888888888741095749E-3)), z,
+                                     set1_pd(4.16666666666666019037E-2));
+    // cos(r + rTail) = w + ((1 - w) - z/2 + z^2*P(z) - r*rTail) with w = 1 - z/2
+    // keeps the rounding error of 1 - z/2.
+    const doubleV w = sub_pd(set1_pd(1.0), halfZ);
+    const doubleV cosR = add_pd(w, fmadd_pd(mul_pd(z, z), cosPoly, sub_pd(sub_pd(sub_pd(set1_pd(1.0), w), halfZ),
+                                                                          mul_pd(r, rTail))));
+
+    // Quadrant q mod 4 as the fraction of q/4: 0, 0.25, 0.5 or 0.75.
+    const doubleV quarter = mul_pd(q, 0.25);
+    const doubleV quadrant = sub_pd(quarter, floor_pd(quarter));
+    const doubleV odd = or_pd(cmpeq_pd(quadrant, 0.25), cmpeq_pd(quadrant, 0.75));
+    const doubleV signBit = set1_pd(-0.0);
+    const doubleV sinNegative = and_pd(cmpgt_pd(quadrant, 0.375), signBit);
+    const doubleV cosNegative = and_pd(and_pd(cmpgt_pd(quadrant, 0.125), cmplt_pd(quadrant, 0.625)), signBit);
+
+    sinA = xor_pd(blendv_pd(sinR, cosR, odd), sinNegative);
+    cosA = xor_pd(blendv_pd(cosR, sinR, odd), cosNegative);
+}
+
+static inline void sincos_pd(const doubleV mask, const doubleV a, doubleV &sinA, doubleV &cosA) {
+    sincos_pd(a, sinA, cosA);
+    sinA = and_pd(mask, sinA);
+    cosA = and_pd(mask, cosA);
+}
+
+static inline const doubleV sin_pd(const doubleV a) {
+    doubleV sinA, cosA;
+    sincos_pd(a, sinA, cosA);
+    return sinA;
+}
+
+static inline const doubleV sin_pd(const doubleV mask, const doubleV a) {
+    return and_pd(mask, sin_pd(a));
+}
+
+static inline const doubleV cos_pd(const doubleV a) {
+    doubleV sinA, cosA;
+    sincos_pd(a, sinA, cosA);
+    return cosA;
+}
+
+static inline const doubleV cos_pd(const doubleV mask, const doubleV a) {
+    return and_pd(mask, cos_pd(a));
+}
+
+// Returns 2^n for integral n in [-126, 127] by writing the exponent bits.
+static inline const floatV pow2n_ps(const floatV n) {
+#if defined(__AVX2__)
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+#elif defined(__AVX__)
+    // AVX has no 256 bit integer instructions, so each half is built with SSE.
+    const __m256i e = _mm256_cvtps_epi32(n);
+    const __m128i bias = _mm_set1_epi32(127);
+    const __m128i low = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(e), bias), 23);
+    const __m128i high = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(e, 1), bias), 23);
+    return _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(low), high, 1));
+#else
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+#endif
+}
+
+// exp(a) in single precision with about 1 ULP of error. Underflows to 0 below
+// -103.3 and overflows to infinity above 88.72.
+static inline const floatV exp_ps(const floatV a) {
+    const floatV x = min_ps(set1_ps(89.0f), max_ps(set1_ps(-104.0f), a));
+    const floatV n = round_ps(mul_ps(x, 1.44269504088896341f));
+    const floatV r = sub_ps(sub_ps(x, mul_ps(n, 0.693359375f)), mul_ps(n, -2.12194440e-4f));
+
+    // Polynomial approximation of exp(r) on [-ln(2)/2, ln(2)/2] from Cephes.
+    const floatV poly = fmadd_ps(fmadd_ps(fmadd_ps(fmadd_ps(fmadd_ps(set1_ps(1.9875691500E-4f), r,
+                                                                     set1_ps(1.3981999507E-3f)), r,
+                                                            set1_ps(8.3334519073E-3f)), r,
+                                                   set1_ps(4.1665795894E-2f)), r,
+                                          set1_ps(1.6666665459E-1f)), r,
+                                 set1_ps(5.0000001201E-1f));
+    const floatV expr = add_ps(fmadd_ps(mul_ps(r, r), poly, r), set1_ps(1.0f));
+
+    // 2^n is applied in two factors like in exp_pd.
+    const floatV n1 = round_ps(mul_ps(n, 0.5f));
+    return mul_ps(mul_ps(expr, pow2n_ps(n1)), pow2n_ps(sub_ps(n, n1)));
+}
+
 static inline const doubleV length_pd(const doubleV a, const doubleV b) {
     return sqrt_pd(add_pd(mul_pd(a, a), mul_pd(b, b)));
 }
 
+/*===- Reduction ----------------------------------------------------------===*/
+
+static inline const double sum_pd(const doubleV a) {
+#ifdef __AVX__
+    const __m128d b = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_hadd_pd(b, b));
+#else
+    return _mm_cvtsd_f64(_mm_hadd_pd(a, a));
+#endif
+}
+
+static inline const double max_pd(const doubleV a) {
+#ifdef __AVX__
+    const __m128d b = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(b, _mm_unpackhi_pd(b, b)));
+#else
+    return _mm_cvtsd_f64(_mm_max_sd(a, _mm_unpackhi_pd(a, a)));
+#endif
+}
+
 /*===- Misc ---------------------------------------------------------------===*/
 
 static inline const doubleV select_pd(const int mask, const double trueValue, const double falseValue) {
@@ -305,4 +929,13 @@ static inline const doubleV select_pd(const int mask, const double trueValue, co
 #endif
 }
 
+// Returns the lane numbers (0, 1, ...) of a vector.
+static inline const doubleV laneIndex_pd() {
+#ifdef __AVX__
+    return _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+#else
+    return _mm_set_pd(1.0, 0.0);
+#endif
+}
+
 #endif // VECTORCOMPATIBILITY_H
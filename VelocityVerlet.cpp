@@ -0,0 +1,500 @@
+/**
+* @file  VelocityVerlet.cpp
+* @class VelocityVerlet VelocityVerlet.h
+*
+* @brief Implementation of the symplectic velocity Verlet method and its 4th
+*        order Yoshida composition, which evaluate the position dependent forces
+*        once per substep, optionally sub-cycling the coulomb force of close
+*        pairs
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "VelocityVerlet.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const double coulomb = 1.0/(4.0*M_PI*Cloud::epsilon0);
+const cloud_index VelocityVerlet::maxSubsteps;
+
+/**
+* @brief Constructor for the VelocityVerlet class
+*
+* @details Order 4 composes three Verlet substeps of w1, w0 and w1 times the
+*          timestep, with w1 = 1/(2 - 2^(1/3)) and w0 = 1 - 2*w1 (Yoshida,
+*          Forest and Ruth). The implicit velocity kick gains one order in
+*          h*gamma per fixed point iteration, so the iterations match the order.
+*          With a sub-cycling radius, close pairs replace the global timestep
+*          reduction of modifyTimeStep.
+*
+* @param[in] C                 Cloud object
+* @param[in] FA                Array of forces
+* @param[in] timeStep          Simulation time step
+* @param[in] startTime         Simulation start time
+* @param[in] order             2 for velocity Verlet, 4 for the Yoshida composition
+* @param[in] subcycleRadius    Pairs that come this close within a step are sub-cycled, 0 for none [m]
+* @param[in] shieldingConstant Inverse of shielding distance of the coulomb force [m^-1]
+**/
+VelocityVerlet::VelocityVerlet(Cloud * const C, const ForceArray &FA, const double timeStep,
+                               const double startTime, const cloud_index order,
+                               const double subcycleRadius, const double shieldingConstant)
+: Integrator(C, FA, timeStep, startTime), numSubsteps(order == 4 ? 3 : 1), numCorrections(order),
+substepWeights{order == 4 ? 1.0/(2.0 - cbrt(2.0)) : 1.0,
+               order == 4 ? 1.0 - 2.0/(2.0 - cbrt(2.0)) : 0.0,
+               order == 4 ? 1.0/(2.0 - cbrt(2.0)) : 0.0},
+accelerationsCurrent(false), oddPositionSubstep(true), oddVelocitySubstep(true), numReorders(0),
+numPositionEvaluations(0), numVelocityEvaluations(0), pairRadius(subcycleRadius), shielding(shieldingConstant),
+numPairSearches(0), numSubcycledSteps(0), numClosePairs(0), numPairSubsteps(0), numLegacyEvaluations(0) {
+	C->allocateSlopes(3);
+	for (Force * const F : FA)
+		(F->velocityDependent() ? velocityForces : positionForces).push_back(F);
+}
+
+/**
+* @brief Moves particles forward with velocity Verlet steps, or compositions of
+*        three of them for order 4.
+*
+* @param[in] endTime Final time of the simulation
+**/
+void VelocityVerlet::moveParticles(const double endTime) {
+	while (currentTime < endTime) {
+		const double dt = pairRadius > 0.0 ? init_dt
+		                : modifyTimeStep(1.0e-4f, init_dt); // implement dynamic timstep (if necessary):
+
+		// Reordering the cloud moves the particles out from under their
+		// accelerations.
+		if (!accelerationsCurrent || numReorders != cloud->numReorders) {
+			closePairs.clear();
+			evaluate(positionForces, currentTime, oddPositionSubstep, cloud->k1, cloud->m1);
+			evaluate(velocityForces, currentTime, oddVelocitySubstep, cloud->k2, cloud->m2);
+			++numPositionEvaluations;
+			if (!velocityForces.empty())
+				++numVelocityEvaluations;
+			numReorders = cloud->numReorders;
+			accelerationsCurrent = true;
+		}
+
+		double time = currentTime;
+		for (cloud_index substep = 0; substep < numSubsteps; substep++) {
+			step(time, substepWeights[substep]*dt);
+			time += substepWeights[substep]*dt;
+		}
+		currentTime += dt;
+	}
+}
+
+/**
+* @brief Takes one velocity Verlet substep.
+*
+* @details The accelerations of the position forces are kept in k1 and m1,
+*          those of the velocity forces in k2 and m2, so the first half kick
+*          reuses the accelerations at the end of the previous substep. The
+*          second half kick depends on the final velocities through drag and
+*          magnetic forces. It is solved by fixed point iteration from the half
+*          step velocities in k3 and m3, starting with the velocity forces of
+*          the previous substep. This keeps the substep time reversible, which
+*          the composition needs for order 4. The velocity forces are cheap, so
+*          iterating them costs little next to one coulomb evaluation. Close
+*          pairs have their coulomb force taken out of k1 and m1 and move
+*          with it in substeps of their own instead of drifting.
+*
+* @param[in] time Start time of the substep
+* @param[in] h    Length of the substep
+**/
+void VelocityVerlet::step(const double time, const double h) {
+	if (pairRadius > 0.0)
+		findClosePairs(h);
+	kickDrift(h);
+	if (!closePairs.empty())
+		subcycle(h);
+	evaluate(positionForces, time + h, oddPositionSubstep, cloud->k1, cloud->m1);
+	++numPositionEvaluations;
+	if (!closePairs.empty())
+		addPairAccelerations(-1.0);
+	kick(h);
+
+	if (velocityForces.empty())
+		return;
+	for (cloud_index correction = 0; correction < numCorrections; correction++) {
+		evaluate(velocityForces, time + h, oddVelocitySubstep, cloud->k2, cloud->m2);
+		++numVelocityEvaluations;
+		kick(h);
+	}
+}
+
+/**
+* @brief Computes the accelerations of one group of forces at the current
+*        positions and velocities.
+*
+* @param[in]     level         Forces to evaluate
+* @param[in]     time          Time of the positions
+* @param[in,out] oddSubstep    Substep parity of the group
+* @param[out]    accelerationX x-accelerations
+* @param[out]    accelerationY y-accelerations
+**/
+void VelocityVerlet::evaluate(const ForceArray &level, const double time, bool &oddSubstep,
+                              double * const accelerationX, double * const accelerationY) const {
+	evaluateForces(level, time, oddSubstep);
+
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV vmass = load_pd(cloud->mass + i);
+		double * const pFx = cloud->forceX + i;
+		double * const pFy = cloud->forceY + i;
+		store_pd(accelerationX + i, div_pd(load_pd(pFx), vmass));
+		store_pd(accelerationY + i, div_pd(load_pd(pFy), vmass));
+
+		// reset forces to zero:
+		store_pd(pFx, set0_pd());
+		store_pd(pFy, set0_pd());
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Changes the velocities by all accelerations over h/2, keeps them in k3
+*        and m3, then moves the particles with them over h.
+*
+* @param[in] h Length of the substep
+**/
+void VelocityVerlet::kickDrift(const double h) const {
+	const doubleV vh = set1_pd(h), halfh = set1_pd(0.5*h);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV ax = add_pd(load_pd(cloud->k1 + i), load_pd(cloud->k2 + i));
+		const doubleV ay = add_pd(load_pd(cloud->m1 + i), load_pd(cloud->m2 + i));
+		const doubleV vx = fmadd_pd(halfh, ax, load_pd(cloud->Vx + i));
+		const doubleV vy = fmadd_pd(halfh, ay, load_pd(cloud->Vy + i));
+		store_pd(cloud->k3 + i, vx);
+		store_pd(cloud->m3 + i, vy);
+		store_pd(cloud->Vx + i, vx);
+		store_pd(cloud->Vy + i, vy);
+		plusEqual_pd(cloud->x + i, mul_pd(vh, vx));
+		plusEqual_pd(cloud->y + i, mul_pd(vh, vy));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Sets the velocities to the half step velocities plus all
+*        accelerations over h/2.
+*
+* @param[in] h Length of the substep
+**/
+void VelocityVerlet::kick(const double h) const {
+	const doubleV halfh = set1_pd(0.5*h);
+	BEGIN_PARALLEL_FOR(i, e, cloud->n, DOUBLE_STRIDE, static)
+		const doubleV ax = add_pd(load_pd(cloud->k1 + i), load_pd(cloud->k2 + i));
+		const doubleV ay = add_pd(load_pd(cloud->m1 + i), load_pd(cloud->m2 + i));
+		store_pd(cloud->Vx + i, fmadd_pd(halfh, ax, load_pd(cloud->k3 + i)));
+		store_pd(cloud->Vy + i, fmadd_pd(halfh, ay, load_pd(cloud->m3 + i)));
+	END_PARALLEL_FOR
+}
+
+/**
+* @brief Finds the pairs that come within pairRadius during the next step and
+*        takes their coulomb accelerations out of k1 and m1.
+*
+* @details Particles slower than pairRadius/(2h) can only come that close to
+*          each other from within twice the radius, so they are paired through
+*          cells of that width. The few faster particles, like a Mach cone
+*          bullet, are checked against every particle, so they do not widen the
+*          cells. The accelerations of the pairs of the last step are added back
+*          first. Also counts the force evaluations the global timestep
+*          reduction would have made.
+*
+* @param[in] h Length of the step
+**/
+void VelocityVerlet::findClosePairs(const double h) {
+	if (!closePairs.empty())
+		addPairAccelerations(1.0);
+	closePairs.clear();
+	++numPairSearches;
+
+	const cloud_index numParticles = cloud->n;
+	const double * const Vx = cloud->Vx, * const Vy = cloud->Vy;
+	const double fastSpeed2 = 0.25*pairRadius*pairRadius/(h*h);
+	fast.assign(numParticles, false);
+	std::vector<cloud_index> fastParticles;
+	for (cloud_index i = 0; i < numParticles; i++)
+		if (Vx[i]*Vx[i] + Vy[i]*Vy[i] > fastSpeed2) {
+			fast[i] = true;
+			fastParticles.push_back(i);
+		}
+
+	double nearest2 = std::numeric_limits<double>::max();
+	const double reach2 = 4.0*pairRadius*pairRadius;
+	cells.build(cloud->x, cloud->y, 2.0*pairRadius);
+	for (cloud_index p = 0; p < numParticles; p++) {
+		const cloud_index cx = cells.particleCell[p]%cells.numCellsX;
+		const cloud_index cy = cells.particleCell[p]/cells.numCellsX;
+		const double x1 = cells.sortedX[p], y1 = cells.sortedY[p];
+		for (cloud_index row = cy ? cy - 1 : 0; row <= cy + 1 && row < cells.numCellsY; row++)
+			for (cloud_index q = std::max(cells.rowBegin(cx, row), p + 1), last = cells.rowEnd(cx, row); q < last; q++) {
+				const double dx = x1 - cells.sortedX[q], dy = y1 - cells.sortedY[q];
+				if (dx*dx + dy*dy < reach2 && !fast[cells.particles[p]] && !fast[cells.particles[q]])
+					addIfClose(cells.particles[p], cells.particles[q], h, nearest2);
+			}
+	}
+	// Pairs of two fast particles are checked once, by the first of them.
+	for (const cloud_index i : fastParticles)
+		for (cloud_index j = 0; j < numParticles; j++)
+			if (!fast[j] || j > i)
+				addIfClose(i, j, h, nearest2);
+
+	// The reduction of modifyTimeStep for the same radius:
+	const float separation = (float)std::sqrt(nearest2);
+	unsigned long factor = 1;
+	for (float distance = (float)pairRadius; separation <= distance && factor < maxSubsteps; distance /= 10.0f)
+		factor *= 10;
+	numLegacyEvaluations += factor;
+
+	if (closePairs.empty())
+		return;
+	++numSubcycledSteps;
+	numClosePairs += closePairs.size();
+	buildClusters();
+	addPairAccelerations(-1.0);
+}
+
+/**
+* @brief Adds a pair to closePairs if the straight paths of its particles come
+*        within pairRadius during the next step, so pairs about to collide are
+*        found before they are close.
+*
+* @details A pair takes the substeps modifyTimeStep would have given the whole
+*          cloud, 10 per factor of 10 its separation is below the radius, and
+*          at least 10 per time to contact.
+*
+* @param[in]     i        First particle
+* @param[in]     j        Second particle
+* @param[in]     h        Length of the step
+* @param[in,out] nearest2 Smallest squared separation so far [m^2]
+**/
+void VelocityVerlet::addIfClose(const cloud_index i, const cloud_index j, const double h, double &nearest2) {
+	const double dx = cloud->x[i] - cloud->x[j], dy = cloud->y[i] - cloud->y[j];
+	const double d2 = dx*dx + dy*dy;
+	nearest2 = std::min(nearest2, d2);
+
+	// Closest approach of the straight paths within the step, which runs
+	// backwards in the middle substep of order 4:
+	const double dVx = cloud->Vx[i] - cloud->Vx[j], dVy = cloud->Vy[i] - cloud->Vy[j];
+	const double v2 = dVx*dVx + dVy*dVy;
+	const double approach = -(dx*dVx + dy*dVy); // separation times closing speed
+	const double t = v2 > 0.0 ? std::min(std::max(h, 0.0), std::max(std::min(h, 0.0), approach/v2)) : 0.0;
+	const double ex = dx + t*dVx, ey = dy + t*dVy;
+	if (ex*ex + ey*ey >= pairRadius*pairRadius)
+		return;
+
+	cloud_index steps = 1;
+	for (double r = pairRadius; d2 <= r*r && steps < maxSubsteps; r /= 10.0)
+		steps *= 10;
+	if (h*approach > 0.0)
+		steps = std::max(steps, (cloud_index)std::min((double)maxSubsteps, std::ceil(10.0*h*approach/d2)));
+	const ClosePair pair = {i, j, std::min(steps, maxSubsteps), 0, 0, 0};
+	closePairs.push_back(pair);
+}
+
+/**
+* @brief Groups the close pairs into clusters of pairs that share particles,
+*        which have to be sub-cycled together, and keeps the start positions of
+*        their particles.
+**/
+void VelocityVerlet::buildClusters() {
+	clusterParticles.clear();
+	for (const ClosePair &pair : closePairs) {
+		clusterParticles.push_back(pair.first);
+		clusterParticles.push_back(pair.second);
+	}
+	std::sort(clusterParticles.begin(), clusterParticles.end());
+	clusterParticles.erase(std::unique(clusterParticles.begin(), clusterParticles.end()), clusterParticles.end());
+	const cloud_index numParticles = (cloud_index)clusterParticles.size();
+
+	// Union-find of the particles, joined by the pairs:
+	std::vector<cloud_index> parent(numParticles);
+	for (cloud_index a = 0; a < numParticles; a++)
+		parent[a] = a;
+	const auto root = [&parent](cloud_index a) {
+		while (parent[a] != a)
+			a = parent[a] = parent[parent[a]];
+		return a;
+	};
+	for (ClosePair &pair : closePairs) {
+		pair.localFirst = (cloud_index)(std::lower_bound(clusterParticles.begin(), clusterParticles.end(), pair.first)
+		                                - clusterParticles.begin());
+		pair.localSecond = (cloud_index)(std::lower_bound(clusterParticles.begin(), clusterParticles.end(), pair.second)
+		                                 - clusterParticles.begin());
+		parent[root(pair.localFirst)] = root(pair.localSecond);
+	}
+
+	// Number the clusters and sort the particles by cluster.
+	const cloud_index none = numParticles;
+	std::vector<cloud_index> clusterOfRoot(numParticles, none), cluster(numParticles);
+	cloud_index numClusters = 0;
+	for (cloud_index a = 0; a < numParticles; a++) {
+		const cloud_index r = root(a);
+		if (clusterOfRoot[r] == none)
+			clusterOfRoot[r] = numClusters++;
+		cluster[a] = clusterOfRoot[r];
+	}
+	clusterStart.assign(numClusters + 1, 0);
+	for (cloud_index a = 0; a < numParticles; a++)
+		clusterStart[cluster[a] + 1]++;
+	for (cloud_index c = 0; c < numClusters; c++)
+		clusterStart[c + 1] += clusterStart[c];
+	std::vector<cloud_index> cursor(clusterStart.begin(), clusterStart.end() - 1), position(numParticles);
+	std::vector<cloud_index> sorted(numParticles);
+	for (cloud_index a = 0; a < numParticles; a++) {
+		position[a] = cursor[cluster[a]]++;
+		sorted[position[a]] = clusterParticles[a];
+	}
+	clusterParticles.swap(sorted);
+
+	for (ClosePair &pair : closePairs) {
+		pair.cluster = cluster[pair.localFirst];
+		pair.localFirst = position[pair.localFirst];
+		pair.localSecond = position[pair.localSecond];
+	}
+	std::sort(closePairs.begin(), closePairs.end(),
+	          [](const ClosePair &a, const ClosePair &b) { return a.cluster < b.cluster; });
+	pairStart.assign(numClusters + 1, 0);
+	for (const ClosePair &pair : closePairs)
+		pairStart[pair.cluster + 1]++;
+	for (cloud_index c = 0; c < numClusters; c++)
+		pairStart[c + 1] += pairStart[c];
+
+	startX.resize(numParticles);
+	startY.resize(numParticles);
+	pairAccelerationX.resize(numParticles);
+	pairAccelerationY.resize(numParticles);
+	for (cloud_index a = 0; a < numParticles; a++) {
+		startX[a] = cloud->x[clusterParticles[a]];
+		startY[a] = cloud->y[clusterParticles[a]];
+	}
+}
+
+/**
+* @brief Adds or subtracts the coulomb accelerations of the close pairs at the
+*        current positions to or from k1 and m1.
+*
+* @param[in] sign 1 to add, -1 to subtract
+**/
+void VelocityVerlet::addPairAccelerations(const double sign) {
+	for (const ClosePair &pair : closePairs) {
+		double forceX, forceY;
+		pairForce(pair.first, pair.second, cloud->x[pair.first] - cloud->x[pair.second],
+		          cloud->y[pair.first] - cloud->y[pair.second], forceX, forceY);
+		cloud->k1[pair.first] += sign*forceX/cloud->mass[pair.first];
+		cloud->m1[pair.first] += sign*forceY/cloud->mass[pair.first];
+		cloud->k1[pair.second] -= sign*forceX/cloud->mass[pair.second];
+		cloud->m1[pair.second] -= sign*forceY/cloud->mass[pair.second];
+	}
+}
+
+/**
+* @brief Computes the shielded coulomb force of a pair on its first particle,
+*        like ShieldedCoulombForce.
+*
+* @param[in]  i             First particle
+* @param[in]  j             Second particle
+* @param[in]  displacementX x-displacement of the first from the second particle [m]
+* @param[in]  displacementY y-displacement of the first from the second particle [m]
+* @param[out] forceX        x-force on the first particle [N]
+* @param[out] forceY        y-force on the first particle [N]
+**/
+void VelocityVerlet::pairForce(const cloud_index i, const cloud_index j, const double displacementX,
+                               const double displacementY, double &forceX, double &forceY) const {
+	const double displacement2 = displacementX*displacementX + displacementY*displacementY;
+	const double displacement = sqrt(displacement2);
+	const double valExp = displacement*shielding;
+	forceX = forceY = 0.0;
+	if (valExp >= 10.0)
+		return;
+
+	const double forceC = coulomb*cloud->charge[i]*cloud->charge[j]*(1.0 + valExp)*exp(-valExp)
+	                      /(displacement2*displacement);
+	forceX = forceC*displacementX;
+	forceY = forceC*displacementY;
+}
+
+/**
+* @brief Computes the accelerations of the particles of a cluster by its pairs.
+*
+* @param[in] cluster Cluster to compute
+**/
+void VelocityVerlet::clusterAccelerations(const cloud_index cluster) {
+	for (cloud_index a = clusterStart[cluster]; a < clusterStart[cluster + 1]; a++)
+		pairAccelerationX[a] = pairAccelerationY[a] = 0.0;
+	for (cloud_index p = pairStart[cluster]; p < pairStart[cluster + 1]; p++) {
+		const ClosePair &pair = closePairs[p];
+		double forceX, forceY;
+		pairForce(pair.first, pair.second, cloud->x[pair.first] - cloud->x[pair.second],
+		          cloud->y[pair.first] - cloud->y[pair.second], forceX, forceY);
+		pairAccelerationX[pair.localFirst] += forceX/cloud->mass[pair.first];
+		pairAccelerationY[pair.localFirst] += forceY/cloud->mass[pair.first];
+		pairAccelerationX[pair.localSecond] -= forceX/cloud->mass[pair.second];
+		pairAccelerationY[pair.localSecond] -= forceY/cloud->mass[pair.second];
+	}
+}
+
+/**
+* @brief Replaces the drift of the particles of close pairs over h by velocity
+*        Verlet substeps of their pair forces, starting from the half step
+*        velocities kept in k3 and m3.
+*
+* @details Each cluster takes the largest number of substeps of its pairs. The
+*          other forces on its particles act through the kicks of the full step
+*          around it, as in RESPA.
+*
+* @param[in] h Length of the step
+**/
+void VelocityVerlet::subcycle(const double h) {
+	const cloud_index numClusters = (cloud_index)clusterStart.size() - 1;
+	for (cloud_index c = 0; c < numClusters; c++) {
+		cloud_index steps = 1;
+		for (cloud_index p = pairStart[c]; p < pairStart[c + 1]; p++)
+			steps = std::max(steps, closePairs[p].numSubsteps);
+		numPairSubsteps += steps;
+		const double delta = h/(double)steps, halfDelta = 0.5*delta;
+
+		for (cloud_index a = clusterStart[c]; a < clusterStart[c + 1]; a++) {
+			cloud->x[clusterParticles[a]] = startX[a];
+			cloud->y[clusterParticles[a]] = startY[a];
+		}
+		clusterAccelerations(c);
+		for (cloud_index s = 0; s < steps; s++) {
+			for (cloud_index a = clusterStart[c]; a < clusterStart[c + 1]; a++) {
+				const cloud_index i = clusterParticles[a];
+				cloud->Vx[i] += halfDelta*pairAccelerationX[a];
+				cloud->Vy[i] += halfDelta*pairAccelerationY[a];
+				cloud->x[i] += delta*cloud->Vx[i];
+				cloud->y[i] += delta*cloud->Vy[i];
+			}
+			clusterAccelerations(c);
+			for (cloud_index a = clusterStart[c]; a < clusterStart[c + 1]; a++) {
+				const cloud_index i = clusterParticles[a];
+				cloud->Vx[i] += halfDelta*pairAccelerationX[a];
+				cloud->Vy[i] += halfDelta*pairAccelerationY[a];
+			}
+		}
+
+		for (cloud_index a = clusterStart[c]; a < clusterStart[c + 1]; a++) {
+			const cloud_index i = clusterParticles[a];
+			cloud->k3[i] = cloud->Vx[i];
+			cloud->m3[i] = cloud->Vy[i];
+		}
+	}
+}
+
+/**
+* @brief Prints the number of force evaluations of each group.
+*
+* @param[in] out Stream to print to
+**/
+void VelocityVerlet::printStatistics(std::ostream &out) const {
+	Integrator::printStatistics(out);
+	out << "Velocity Verlet: " << numPositionEvaluations << " position and " << numVelocityEvaluations
+	<< " velocity force evaluations (" << numSubsteps << " substeps per timestep)." << std::endl;
+	if (pairRadius > 0.0)
+		out << "Close pairs: sub-cycled in " << numSubcycledSteps << " of " << numPairSearches << " substeps, "
+		<< numClosePairs << " pairs, " << numPairSubsteps << " cluster substeps. The global timestep reduction "
+		<< "would have made " << numLegacyEvaluations << " position force evaluations." << std::endl;
+}
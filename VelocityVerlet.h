@@ -0,0 +1,78 @@
+/**
+* @file  VelocityVerlet.h
+* @brief Defines the data and methods of the VelocityVerlet class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef VELOCITYVERLET_H
+#define VELOCITYVERLET_H
+
+#include "Integrator.h"
+#include <vector>
+
+class VelocityVerlet : public Integrator {
+public:
+	VelocityVerlet(Cloud * const C, const ForceArray &FA, const double timeStep,
+	               const double startTime, const cloud_index order,
+	               const double subcycleRadius, const double shieldingConstant);
+	~VelocityVerlet() {}
+
+	void moveParticles(const double endTime);
+	void printStatistics(std::ostream &out) const;
+
+private:
+	//!< A pair whose coulomb interaction is sub-cycled:
+	struct ClosePair {
+		cloud_index first, second;   //!< Particles of the pair
+		cloud_index numSubsteps;     //!< Substeps the pair needs per step
+		cloud_index cluster;         //!< Cluster of pairs sharing particles
+		cloud_index localFirst, localSecond; //!< Positions of the particles in clusterParticles
+	};
+
+	static const cloud_index maxSubsteps = 10000; // most substeps of a close pair per step
+
+	ForceArray positionForces;     // forces that only depend on the positions and time
+	ForceArray velocityForces;     // forces that depend on the velocities
+	const cloud_index numSubsteps; // Verlet substeps per timestep
+	const cloud_index numCorrections; // fixed point iterations of the implicit velocity kick
+	const double substepWeights[3]; // lengths of the substeps as fractions of the timestep
+	bool accelerationsCurrent;     // true if k1/m1 and k2/m2 belong to the current state
+	bool oddPositionSubstep;       // substep parity of the position forces
+	bool oddVelocitySubstep;       // substep parity of the velocity forces
+	unsigned long numReorders;     // cloud reorders the accelerations belong to
+	unsigned long numPositionEvaluations; // number of position force evaluations
+	unsigned long numVelocityEvaluations; // number of velocity force evaluations
+
+	const double pairRadius;       // pairs that come this close within a step are sub-cycled, 0 for none [m]
+	const double shielding;        // inverse of shielding distance of the sub-cycled coulomb force [m^-1]
+	std::vector<bool> fast;        // particles that may move more than half pairRadius in a step
+	std::vector<ClosePair> closePairs; // sub-cycled pairs of the current step, sorted by cluster
+	std::vector<cloud_index> clusterParticles; // particles of the pairs, sorted by cluster
+	std::vector<cloud_index> clusterStart; // first of clusterParticles of each cluster, plus the end
+	std::vector<cloud_index> pairStart; // first of closePairs of each cluster, plus the end
+	std::vector<double> startX, startY; // positions of clusterParticles at the start of the step
+	std::vector<double> pairAccelerationX, pairAccelerationY; // accelerations of clusterParticles by their pairs
+	unsigned long numPairSearches; // number of searches for close pairs
+	unsigned long numSubcycledSteps; // number of searches that found close pairs
+	unsigned long numClosePairs;   // sum of the close pairs of all steps
+	unsigned long numPairSubsteps; // sum of the substeps of all clusters
+	unsigned long numLegacyEvaluations; // force evaluations the global timestep reduction would have made
+
+	void step(const double time, const double h);
+	void evaluate(const ForceArray &level, const double time, bool &oddSubstep,
+	              double * const accelerationX, double * const accelerationY) const;
+	void kickDrift(const double h) const;
+	void kick(const double h) const;
+	void findClosePairs(const double h);
+	void addIfClose(const cloud_index i, const cloud_index j, const double h, double &nearest2);
+	void addPairAccelerations(const double sign);
+	void pairForce(const cloud_index i, const cloud_index j, const double displacementX, const double displacementY,
+	               double &forceX, double &forceY) const;
+	void buildClusters();
+	void clusterAccelerations(const cloud_index cluster);
+	void subcycle(const double h);
+};
+
+#endif // VELOCITYVERLET_H
@@ -49,7 +49,7 @@ inline void VertElectricForce::force(const cloud_index currentParticle, const do
 	const doubleV cV = mul_pd(load_pd(cloud->charge + currentParticle), vertElectric);
 	const doubleV eV = mul_pd(cV, exp_pd(div_pd(currentPositionY,vertDec)));
 	
-	plusEqual_pd(cloud->forceY + currentParticle, eV);
+	plusEqual_pd(targetY + currentParticle, eV);
 }
 
 void VertElectricForce::writeForce(fitsfile * const file, int * const error) const {
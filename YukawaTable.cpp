@@ -0,0 +1,114 @@
+/**
+* @file  YukawaTable.cpp
+* @class YukawaTable YukawaTable.h
+*
+* @brief Tabulates the radial factor (1 + shielding*r)*exp(-shielding*r)/r^3 of
+*        the shielded Coulomb force as piecewise cubic polynomials in r^2
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#include "YukawaTable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const unsigned YukawaTable::numOctaves;
+const unsigned YukawaTable::maxBits;
+
+/**
+* @brief Constructor for the YukawaTable class
+*
+* @details The table spans numOctaves powers of two of r^2 up to the first power
+*          of two above the cutoff, so it reaches down to 1/4096 of the cutoff
+*          distance. Each interval holds the cubic Hermite interpolant of the
+*          exact values and derivatives at its ends.
+*
+* @param[in] shieldingConstant Inverse of shielding distance [m^-1]
+* @param[in] resolution        The table has 2^resolution intervals per octave of r^2
+**/
+YukawaTable::YukawaTable(const double shieldingConstant, const unsigned resolution)
+: shielding(shieldingConstant), bits(resolution), cutoff2(100.0/(shielding*shielding)),
+numIntervals(numOctaves << bits), c0(new double[numIntervals]), c1(new double[numIntervals]),
+c2(new double[numIntervals]), c3(new double[numIntervals]), maxRelativeError(0.0) {
+	int exponent;
+	frexp(cutoff2, &exponent);
+	const double endR2 = ldexp(1.0, exponent); // cutoff2 < endR2 <= 2*cutoff2
+	firstR2 = ldexp(endR2, -(int)numOctaves);
+	lastR2 = nextafter(endR2, 0.0);
+	fractionMask = (1LL << (52 - bits)) - 1;
+	long long firstBits;
+	memcpy(&firstBits, &firstR2, sizeof(double));
+	offset = firstBits >> (52 - bits);
+
+	for (unsigned i = 0; i < numIntervals; i++) {
+		// Interval i starts at firstR2*2^octave*(1 + step/2^bits).
+		const long double width = ldexpl(firstR2, (int)(i >> bits) - (int)bits);
+		const long double start = ldexpl(firstR2, (int)(i >> bits)) + width*(long double)(i & ((1 << bits) - 1));
+		const long double f0 = exactValue(start), f1 = exactValue(start + width);
+		const long double d0 = width*exactDerivative(start), d1 = width*exactDerivative(start + width);
+		c0[i] = (double)f0;
+		c1[i] = (double)d0;
+		c2[i] = (double)(3.0L*(f1 - f0) - 2.0L*d0 - d1);
+		c3[i] = (double)(2.0L*(f0 - f1) + d0 + d1);
+
+		// The error of a cubic Hermite interpolant peaks inside the interval.
+		for (int k = 1; k < 8; k++) {
+			const double t = k/8.0;
+			const long double exact = exactValue(start + width*t);
+			maxRelativeError = std::max(maxRelativeError, (double)fabsl((interpolate(i, t) - exact)/exact));
+		}
+	}
+}
+
+/**
+* @brief Destructor for the YukawaTable class
+**/
+YukawaTable::~YukawaTable() {
+	delete[] c0; delete[] c1;
+	delete[] c2; delete[] c3;
+}
+
+/**
+* @brief Evaluates interval i at position t in [0, 1) the same way lookup does.
+**/
+double YukawaTable::interpolate(const unsigned i, const double t) const {
+	return ((c3[i]*t + c2[i])*t + c1[i])*t + c0[i];
+}
+
+/**
+* @brief Returns (1 + shielding*r)*exp(-shielding*r)/r^3 for each lane of r2.
+**/
+const doubleV YukawaTable::exactValue(const doubleV r2) const {
+	const doubleV r = sqrt_pd(r2);
+	const doubleV shieldedR = mul_pd(r, shielding);
+	return div_pd(mul_pd(add_pd(set1_pd(1.0), shieldedR), exp_pd(sub_pd(set0_pd(), shieldedR))), mul_pd(r2, r));
+}
+
+/**
+* @brief Returns (1 + shielding*r)*exp(-shielding*r)/r^3.
+**/
+long double YukawaTable::exactValue(const long double r2) const {
+	const long double r = sqrtl(r2);
+	return (1.0L + shielding*r)*expl(-shielding*r)/(r2*r);
+}
+
+/**
+* @brief Returns the derivative of exactValue with respect to r^2.
+**/
+long double YukawaTable::exactDerivative(const long double r2) const {
+	const long double r = sqrtl(r2);
+	const long double shieldedR = shielding*r;
+	return -(3.0L + 3.0L*shieldedR + shieldedR*shieldedR)*expl(-shieldedR)/(2.0L*r2*r2*r);
+}
+
+/**
+* @brief Prints the size and accuracy of the table.
+*
+* @param[in] out Stream to print to
+**/
+void YukawaTable::printStatistics(std::ostream &out) const {
+	out << "Coulomb force table: " << numIntervals << " intervals (" << (1 << bits)
+	<< " per octave of r^2), maximum relative pair force error " << maxRelativeError << "." << std::endl;
+}
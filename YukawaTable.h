@@ -0,0 +1,70 @@
+/**
+* @file  YukawaTable.h
+* @brief Defines the data and methods of the YukawaTable class
+*
+* @license This file is distributed under the BSD Open Source License.
+*          See LICENSE.TXT for details.
+**/
+
+#ifndef YUKAWATABLE_H
+#define YUKAWATABLE_H
+
+#include "VectorCompatibility.h"
+#include <ostream>
+
+class YukawaTable {
+public:
+	YukawaTable(const double shieldingConstant, const unsigned resolution);
+	~YukawaTable();
+
+	const double shielding;  //!< Inverse of shielding distance [m^-1]
+	const unsigned bits;     //!< The table has 2^bits intervals per octave of r^2
+	const double cutoff2;    //!< Square of the cutoff 10/shielding [m^2]
+
+	static const unsigned numOctaves = 24; //!< Octaves of r^2 below the cutoff covered by the table
+	static const unsigned maxBits = 16;    //!< Largest supported resolution
+
+	/**
+	* @brief Returns (1 + shielding*r)*exp(-shielding*r)/r^3 for the squared
+	*        distances r2, without a sqrt or exp.
+	*
+	* @details The table is indexed by the exponent and leading mantissa bits of
+	*          r2, so the intervals are equally wide relative to r2. Lanes beyond
+	*          the cutoff return arbitrary finite values.
+	*
+	* @param[in] lanes Mask of the lanes that are used
+	* @param[in] r2    Squared distances [m^2]
+	**/
+	const doubleV lookup(const doubleV lanes, const doubleV r2) const {
+		// Clamped so no lane indexes outside the table. NaN becomes firstR2.
+		const doubleV s = min_pd(max_pd(r2, set1_pd(firstR2)), set1_pd(lastR2));
+		const indexV index = bitIndex_pd(s, 52 - bits, offset);
+		// Position within the interval from the remaining mantissa bits.
+		const doubleV t = mul_pd(sub_pd(or_pd(and_pd(s, setBits_pd(fractionMask)), set1_pd(1.0)), set1_pd(1.0)),
+		                         (double)(1 << bits));
+		const doubleV value = fmadd_pd(fmadd_pd(fmadd_pd(gather_pd(c3, index), t, gather_pd(c2, index)), t,
+		                                        gather_pd(c1, index)), t, gather_pd(c0, index));
+
+		// Pairs closer than the table covers are rare and computed exactly.
+		const doubleV close = and_pd(lanes, cmplt_pd(r2, firstR2));
+		return movemask_pd(close) ? blendv_pd(value, exactValue(r2), close) : value;
+	}
+
+	void printStatistics(std::ostream &out) const;
+
+private:
+	double firstR2;           //!< Smallest tabulated r^2, a power of two [m^2]
+	double lastR2;            //!< Largest tabulated r^2 [m^2]
+	long long offset;         //!< Index bits of firstR2
+	long long fractionMask;   //!< Mantissa bits below the index bits
+	const unsigned numIntervals; //!< Number of table intervals
+	double * const c0, * const c1, * const c2, * const c3; //!< Cubic coefficients of each interval
+	double maxRelativeError;  //!< Largest relative error found between the nodes
+
+	const doubleV exactValue(const doubleV r2) const;
+	long double exactValue(const long double r2) const;
+	long double exactDerivative(const long double r2) const;
+	double interpolate(const unsigned interval, const double t) const;
+};
+
+#endif // YUKAWATABLE_H
@@ -6,16 +6,24 @@
 *          See LICENSE.TXT for details. 
 **/
 
+#include "BlockTimestep.h"
+#include "CarpenterKennedy.h"
 #include "ConfinementForceVoid.h"
+#include "DormandPrince.h"
 #include "DrivingForce.h"
+#include "ExponentialVerlet.h"
+#include "Fire.h"
 #include "MagneticForce.h"
 #include "RectConfinementForce.h"
+#include "Respa.h"
 #include "RotationalForce.h"
 #include "Runge_Kutta4.h"
 #include "ShieldedCoulombForce.h"
 #include "ThermalForceLocalized.h"
 #include "TimeVaryingDragForce.h"
 #include "TimeVaryingThermalForce.h"
+#include "TreeCoulombForce.h"
+#include "VelocityVerlet.h"
 #include "ElectricForce.h"
 #include "GravitationalForce.h"
 #include "VertElectricForce.h"
@@ -25,6 +33,7 @@
 #include <cassert>
 #include <cmath>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <string>
 
@@ -44,6 +53,10 @@ void deleteFitsFile(char * const filename, int &error);
 void fitsFileExists(char * const filename, int &error);
 void fitsFileCreate(fitsfile **file, char * const fileName, int &error);
 void setParticleRows();
+PairSearch pairSearchMethod(const char *name);
+ForceAccumulation accumulationMethod(const char *name);
+force_flags slowForceFlags(const char *letters);
+void addForce(ForceArray &forces, ForceArray &slowForces, const force_flags flag, Force * const F);
 
 using namespace std;
 using namespace chrono;
@@ -56,6 +69,9 @@ enum clFlagType : int {
 	CI, //!< cloud_index
 	D,  //!< double
 	F,  //!< file_index
+	S,  //!< string
+	U,  //!< unsigned
+	L,  //!< uint64_t
 };
 
 typedef int file_index;             //!< Used to keep track of file input arguments
@@ -76,6 +92,7 @@ double confinementConstX = 100;     //!< Strength of RectConfinementForce in x-d
 double confinementConstY = 1000;    //!< Strength of RectConfinementForce in y-direction [V/m^2]
 double shieldingConstant = 2E4;     //!< Defines inverse of distance where ShieldedCoulombForce kicks in [m^-1]
 									//!< corresponds to 10*(ion debye length) [m^-1]
+double openingAngle = 0.5;          //!< Opening angle of the Barnes-Hut TreeCoulombForce
 double dragGamma = 10.0;            //!< Dust drag frequency [Hz]
 double thermRed = 1E-14;            //!< Thermal reduction factor [N]
 double thermRed1 = thermRed;        //!< Outer reduction factor (-L) [N]
@@ -109,6 +126,35 @@ double massDensity = 2200;          //!< Density of cloud particles [kg/m^3]
 double velocityX = 0.0;             //!< Initial x-velocity of cloud [m/s]
 double velocityY = 0.0;             //!< Initial y-velocity of cloud [m/s]
 
+const char *pairSearchName = "all"; //!< Method used to find interacting pairs in ShieldedCoulombForce
+PairSearch pairSearch = AllPairsSearch;
+double neighborSkin = 1E-4;         //!< Skin radius of the neighbor list used by -N verlet [m]
+const char *accumulationName = "lock"; //!< Method used to add up pair forces of -N all
+ForceAccumulation accumulation = LockAccumulation;
+unsigned coulombTable = 0;          //!< Coulomb force table has 2^coulombTable intervals per octave of r^2, 0 for none
+bool mixedPrecision = false;        //!< Compute coulomb pair forces in single precision
+cloud_index reorderInterval = 0;    //!< Reorder particles along a Hilbert curve every this many outputs, 0 for never
+cloud_index fastSteps = 0;          //!< Fast timesteps per slow timestep of the Respa integrator, 0 for Runge-Kutta
+const char *slowForceLetters = "c"; //!< Option letters of the forces on the slow level of the Respa integrator
+force_flags slowForceMask = 
+	ShieldedCoulombForceFlag | 
+	TreeCoulombForceFlag;           //!< Forces on the slow level of the Respa integrator
+double splitRadius = 0.0;           //!< Coulomb pairs closer than this are on the fast level of the Respa integrator [m]
+bool adaptive = false;              //!< Use the adaptive Dormand-Prince integrator
+double relativeTolerance = 1E-6;    //!< Allowed local error of the Dormand-Prince integrator relative to each coordinate
+double absoluteTolerance = 1E-9;    //!< Allowed local error of the Dormand-Prince integrator near zero [m, m/s]
+cloud_index verletOrder = 0;        //!< Order of the symplectic velocity Verlet integrator (2 or 4), 0 for Runge-Kutta
+double subcycleRadius = 0.0;        //!< Coulomb pairs closer than this are sub-cycled by velocity Verlet, 0 for none [m]
+bool lowStorage = false;            //!< Use the low-storage Carpenter-Kennedy Runge-Kutta integrator
+bool exponential = false;           //!< Use the exponential velocity Verlet integrator
+bool blockTimesteps = false;        //!< Use per-particle block timesteps
+double blockAccuracy = 0.2;         //!< Fraction of the closest separation a particle may move in one block timestep
+unsigned blockLevels = 8;           //!< Deepest block timestep level, with a timestep of -t/2^blockLevels
+bool relax = false;                 //!< Relax to a ground state with FIRE instead of simulating
+double relaxTolerance = 1E-16;      //!< Largest force on any particle of a relaxed cloud [N]
+cloud_index relaxIterations = 100000; //!< Iterations after which FIRE gives up
+uint64_t randomSeed = 0;            //!< Seed of the random numbers, 0 for the current time
+
 force_flags usedForces = 0;         //!< Bitpacked forces
 cloud_index numParticles = 4;		//!< Number of dust particles
 cloud_index row_x_particles = 4;	//!< Number of rows in the x-direction
@@ -138,6 +184,10 @@ void help() {
           << "                                      DEMON" << endl
           << "        Dynamic Exploration of Microparticle clouds Optimized Numerically" << endl << endl
           << "Options:" << endl << endl
+          << " -a 1E-6 1E-9           use adaptive Dormand-Prince integrator; set relative," << endl
+          << "                        absolute local error tolerance [m, m/s]" << endl
+          << " -A lock                set coulomb force accumulation (lock, private, gather)" << endl
+          << " -b 0.5                 use TreeCoulombForce; set Barnes-Hut opening angle" << endl
           << " -B 1.0                 set magnitude of B-field in z-direction [T]" << endl
           << " -c noDefault.fits      continue run from file" << endl
           << " -C 100.0               set confinementConst [V/m^2]" << endl
@@ -150,43 +200,125 @@ void help() {
           << " -g 10.0                set dragGamma (magnitute of drag constant) [Hz]" << endl
 	      << " -G 0.0                 set Gravitational field strength [m/s^2]" << endl
           << " -h                     display Help (instead of running)" << endl
+          << " -H 0                   reorder particles every n data time steps (0 = never)" << endl
           << " -I                     use 2nd order Runge-Kutta integrator" << endl
           << " -k 0 0                 kick the particles in the x;y directions [m/s]" << endl
+          << " -K 1E-4                set neighbor list skin radius [m]" << endl
           << " -i 0.003               set initial inter-particle spacing [m]" << endl
+          << " -j 0.2 8               use per-particle block timesteps; set accuracy," << endl
+          << "                        deepest level" << endl
+          << " -l 2                   use symplectic velocity Verlet integrator; set order" << endl
+          << "                        (2 or 4)" << endl
           << " -L 0.001 1E-14 1E-14   use ThermalForceLocalized; set radius [m], in,out" << endl
           << "                        thermal values [N]" << endl
+          << " -m                     use single precision coulomb pair forces" << endl
           << " -M 0.2 100             create Mach Cone; set bullet velocity [m/s], mass factor" << endl
           << " -n 8                   set number of particles" << endl
+          << " -N all                 set coulomb pair search (all, cell, verlet, tiled)" << endl
           << " -o 0.01                set the data Output time step [s]" << endl
           << " -O data.fits           set the name of the output file" << endl
           << " -P Parameters.cfg      Read parameters from file" << endl
           << " -p 0 0                 set initial x;y positions [m] of cloud" << endl
           << " -q 6000.0 100.0        set charge mean and sigma [c]" << endl
+          << " -Q 0                   set random seed (0 = current time)" << endl
           << " -R 100.0 1000.0        use RectConfinementForce; set confineConstX,Y [V/m^2]" << endl
           << " -r 1.45E-6 0.0         set mean particle radius and sigma [m]" << endl
           << " -s 2E4                 set coulomb shielding constant [m^-1]" << endl
           << " -S 1E-15 0.005 0.007   use RotationalForce; set strength [N], rmin, rmax [m]" << endl
           << " -t 0.0001              set the simulation time step [s]" << endl
           << " -T 1E-14               use ThermalForce; set thermal reduction factor [N]" << endl
+          << " -u 4 c 0               use RESPA integrator; set fast steps per slow step," << endl
+          << "                        slow forces, coulomb split radius [m]" << endl
           << " -v 1E-14 0.0           use TimeVaryingThermalForce; set scale [N/s]" << endl
           << "                        and offset [N]" << endl
           << " -V 0.4                 use ConfinementForceVoid; set void decay constant [m^-1]" << endl
           << " -w 1E-13 0.007 0.00001 use DrivingForce; set amplitude [N], shift [m]," << endl
-          << "                        driveConst [m^-2]" << endl << endl
+          << "                        driveConst [m^-2]" << endl
+          << " -W                     use low-storage 4th order Runge-Kutta integrator" << endl
+          << " -x                     use exponential velocity Verlet integrator" << endl
+          << " -y 1E-4                sub-cycle close pairs with -l; set radius [m]" << endl
+          << " -Y 0                   set coulomb force table resolution (0 = exact, 1-16)" << endl
+          << " -z 1E-16 100000        relax to a ground state with FIRE; set force" << endl
+          << "                        tolerance [N], maximum iterations" << endl << endl
 
           << "Notes: " << endl << endl
           << " Parameters specified above represent the default values and accepted type," << endl
           << "    with the exception of -c and -f, for which there are no default values." << endl
+          << " -b replaces the pair searches of -N with a Barnes-Hut quadtree that is" << endl
+          << "    rebuilt every substep. Cells narrower than the opening angle (0 to 1)" << endl
+          << "    times their distance act through their monopole, dipole and" << endl
+          << "    quadrupole moments. Use it when the cloud is not much wider than" << endl
+          << "    10 shielding lengths, where the pair searches are O(N^2)." << endl
           << " -c appends to file; ignores all force flags (use -f to run with different" << endl
           << "    forces). -c overrides -f if both are specified" << endl
           << " -D uses strengthening drag if scale > 0, weakening drag if scale < 0." << endl
+          << " -H n sorts the particles in memory along a Hilbert curve every n data" << endl
+          << "    time steps, which keeps the pair searches cache friendly once the" << endl
+          << "    cloud has mixed. Output files keep the original particle order." << endl
+          << " -a picks the longest steps that keep the local error of every position" << endl
+          << "    and velocity below absolute + relative*|value|, starting with the -t" << endl
+          << "    timestep. The states at the -o output times are interpolated, so" << endl
+          << "    the output rate does not limit the step. Thermal forces are random" << endl
+          << "    every substep and have no local error, so -a does not work with -L," << endl
+          << "    -T or -v, nor with -c on a file that uses them." << endl
+          << " -A private adds pair forces to per-thread buffers that are summed in a" << endl
+          << "    tree; -A gather visits every pair twice so no thread writes to the" << endl
+          << "    force of another particle. Both avoid locks. Only used with -N all." << endl
+          << " -m computes the coulomb pair forces in single precision from double" << endl
+          << "    precision displacements and adds them up in double precision. Only" << endl
+          << "    used with -N all -A lock and without -Y, and the number of particles" << endl
+          << "    must be a multiple of " << FLOAT_STRIDE << ". Benchmark precision compares the" << endl
+          << "    trajectories and energy drift with double precision." << endl
+          << " -l evaluates the forces once per timestep, or three times for order 4." << endl
+          << "    Energy does not drift in long runs without drag or heat. Drag and" << endl
+          << "    magnetic forces are solved implicitly, which costs a few cheap extra" << endl
+          << "    evaluations of them." << endl
+          << " -y keeps the -l timestep when particles come closer than the radius," << endl
+          << "    instead of cutting it by 10 for the whole cloud per factor of 10." << endl
+          << "    Pairs whose paths come within the radius during a step move under" << endl
+          << "    their coulomb force in substeps of their own; the other forces act" << endl
+          << "    on them once per step. How often this happened, and how many force" << endl
+          << "    evaluations the global reduction would have made, is printed." << endl
+          << " -Q seeds the charges, masses and thermal forces, and is written to the" << endl
+          << "    output file. -c continues with the seed of the file." << endl
           << " -M is best used by loading up a previous cloud that has reached equilibrium." << endl
           << " -n expects even number, else will add 1 (required for SIMD)." << endl
+          << " -j gives each particle a timestep of -t/2^l, with l up to the deepest" << endl
+          << "    level, so that it moves at most accuracy times the distance to its" << endl
+          << "    closest neighbor per step. Only particles whose step ends are moved" << endl
+          << "    with new coulomb forces, so close pairs and fast particles (-M) do" << endl
+          << "    not shorten the timestep of the whole cloud." << endl
+          << " -N cell bins particles into cells of 10 shielding lengths and only" << endl
+          << "    checks neighboring cells. Fastest when the cloud is much wider than" << endl
+          << "    the shielding length." << endl
+          << " -N tiled pairs tiles of 256 consecutive particles and skips pairs of" << endl
+          << "    tiles whose bounding boxes are farther apart than the cutoff." << endl
+          << " -N verlet keeps a list of partners within the cutoff plus the -K skin" << endl
+          << "    and rebuilds it once a particle moved more than half the skin." << endl
           << " -S creates a shear layer between rmin = cloudsize/2 and" << endl
           << "    rmax = rmin + cloudsize/5." << endl
           << " -T runs with heat; otherwise, runs cold." << endl
+          << " -u integrates the slow forces with a velocity Verlet step of n times the" << endl
+          << "    -t timestep, around n velocity Verlet steps of the other forces." << endl
+          << "    Slow forces are given by their option letters, with c for coulomb," << endl
+          << "    C for confinement and g for drag. Velocity dependent and thermal" << endl
+          << "    forces should stay fast. A split radius moves the coulomb force of" << endl
+          << "    closer pairs to the fast level." << endl
           << " -v uses increases temp if scale > 0, decreasing temp if scale < 0." << endl
           << " -w creates acoustic waves along the x-axis (best with -R)." << endl 
+          << " -W evaluates the forces five times per timestep instead of four, but" << endl
+          << "    keeps 12 instead of 18 doubles per particle, for the largest clouds." << endl
+          << " -x solves the drag and magnetic forces exactly and integrates the others" << endl
+          << "    with velocity Verlet steps, so strong drag or fields do not limit -t." << endl
+          << " -Y n looks the coulomb force up in a table with 2^n intervals per octave" << endl
+          << "    of r^2 instead of computing a sqrt and exp for every pair. The largest" << endl
+          << "    relative pair force error is printed at the end of the run." << endl
+          << " -z moves the particles downhill under the forces that do not depend on" << endl
+          << "    the velocities until no force exceeds the tolerance, starting with" << endl
+          << "    the -t timestep. The relaxed cloud, at rest, is written as the last" << endl
+          << "    time step of the output file, so -f can start experiments from it." << endl
+          << "    The coulomb force jumps to zero 10 shielding lengths out, by about" << endl
+          << "    2E-17 N for the default charges, so smaller tolerances are not reached." << endl
           << " -E is set to 0 0 initially. If you would like to run DEMON with an" << endl
           << "    Electric force, you may also want to turn the Confinement Force to 0." << endl <<endl;
 }
@@ -277,32 +409,124 @@ void setParticleRows() {
 	else
 		numParticles = row_x_particles*row_y_particles;
 
+	const cloud_index requested = numParticles;
 	if (numParticles < 4) {
 		row_x_particles = 2;
 		row_y_particles = 2;
 		numParticles = row_x_particles * row_y_particles;
-		cout << "Warning: -n requires multiples of " << FLOAT_STRIDE << " numbers of particles. Incrementing number of particles to (" 
-		<< numParticles << ")." << endl;
 	}
-	else if(numParticles%FLOAT_STRIDE) {
-		while(numParticles%FLOAT_STRIDE) {
-			if(row_y_particles == 0) {
-				++row_x_particles;
-				numParticles = row_x_particles;
-			}
-			else if(row_y_particles < row_x_particles) {
-				++row_y_particles;
-				numParticles = row_x_particles * row_y_particles;
-			}
-			else {
-				++row_x_particles;
-				numParticles = row_x_particles * row_y_particles;
-			}
+	while(numParticles%FLOAT_STRIDE) {
+		if(row_y_particles == 0) {
+			++row_x_particles;
+			numParticles = row_x_particles;
+		}
+		else if(row_y_particles < row_x_particles) {
+			++row_y_particles;
+			numParticles = row_x_particles * row_y_particles;
+		}
+		else {
+			++row_x_particles;
+			numParticles = row_x_particles * row_y_particles;
 		}
+	}
 
+	if (numParticles != requested)
 		cout << "Warning: -n requires multiples of " << FLOAT_STRIDE << " numbers of particles. Incrementing number of particles to (" 
 		<< numParticles << ")." << endl;
-	}
+}
+
+
+/**
+* @brief Converts the name of a pair search method to a PairSearch.
+*
+* @param[in] name The name of the method (all, cell, verlet, tiled)
+*
+* @return The pair search method
+**/
+PairSearch pairSearchMethod(const char *name) {
+	if (!strcmp(name, "all"))
+		return AllPairsSearch;
+	if (!strcmp(name, "cell"))
+		return CellListSearch;
+	if (!strcmp(name, "verlet"))
+		return NeighborListSearch;
+	if (!strcmp(name, "tiled"))
+		return TiledSearch;
+
+	cout << "Error: Unknown pair search method " << name << endl;
+	help();
+	exit(1);
+}
+
+/**
+* @brief Converts the name of a force accumulation method to a ForceAccumulation.
+*
+* @param[in] name The name of the method (lock, private, gather)
+*
+* @return The force accumulation method
+**/
+ForceAccumulation accumulationMethod(const char *name) {
+	if (!strcmp(name, "lock"))
+		return LockAccumulation;
+	if (!strcmp(name, "private"))
+		return PrivateAccumulation;
+	if (!strcmp(name, "gather"))
+		return GatherAccumulation;
+
+	cout << "Error: Unknown force accumulation method " << name << endl;
+	help();
+	exit(1);
+}
+
+/**
+* @brief Converts option letters of forces into force flags
+*
+* @param[in] letters Option letters of the forces, c for either coulomb force,
+*                    C for the confinement forces and g for the drag forces
+*
+* @return The force flags
+**/
+force_flags slowForceFlags(const char *letters) {
+	force_flags flags = 0;
+	for (const char *c = letters; *c != '\0'; c++)
+		switch (*c) {
+			case 'b': flags |= TreeCoulombForceFlag; break;
+			case 'B': flags |= MagneticForceFlag; break;
+			case 'c': flags |= ShieldedCoulombForceFlag | TreeCoulombForceFlag; break;
+			case 'C': flags |= ConfinementForceFlag | ConfinementForceVoidFlag | RectConfinementForceFlag; break;
+			case 'D': flags |= TimeVaryingDragForceFlag; break;
+			case 'E': flags |= ElectricForceFlag; break;
+			case 'F': flags |= VertElectricForceFlag; break;
+			case 'g': flags |= DragForceFlag | TimeVaryingDragForceFlag; break;
+			case 'G': flags |= GravitationalForceFlag; break;
+			case 'L': flags |= ThermalForceLocalizedFlag; break;
+			case 'R': flags |= RectConfinementForceFlag; break;
+			case 'S': flags |= RotationalForceFlag; break;
+			case 'T': flags |= ThermalForceFlag; break;
+			case 'v': flags |= TimeVaryingThermalForceFlag; break;
+			case 'V': flags |= ConfinementForceVoidFlag; break;
+			case 'w': flags |= DrivingForceFlag; break;
+			default:
+				cout << "Error: Unknown slow force " << *c << endl;
+				help();
+				exit(1);
+		}
+	return flags;
+}
+
+/**
+* @brief Adds a force to the forces of the simulation, and to the slow forces of
+*        the Respa integrator if its flag is in slowForceMask
+*
+* @param[in,out] forces     Forces of the simulation
+* @param[in,out] slowForces Slow forces of the Respa integrator
+* @param[in]     flag       Flag of the force
+* @param[in]     F          The force
+**/
+void addForce(ForceArray &forces, ForceArray &slowForces, const force_flags flag, Force * const F) {
+	forces.push_back(F);
+	if (slowForceMask & flag)
+		slowForces.push_back(F);
 }
 
 
@@ -316,6 +540,66 @@ int main (int argc, char * const argv[]) {
 	steady_clock::time_point start = steady_clock::now();
 
 	parseCommandLineOptions(argc, argv);
+	if (coulombTable > YukawaTable::maxBits) {
+		cout << "Error: coulomb table resolution must be at most " << YukawaTable::maxBits << "." << endl;
+		help();
+		return 1;
+	}
+	if (!(openingAngle > 0.0 && openingAngle <= 1.0)) {
+		cout << "Error: the opening angle must be greater than 0 and at most 1." << endl;
+		help();
+		return 1;
+	}
+	if (fastSteps && splitRadius < 0.0) {
+		cout << "Error: the split radius must not be negative." << endl;
+		help();
+		return 1;
+	}
+	if (fastSteps && splitRadius > 0.0 && !(slowForceMask & (ShieldedCoulombForceFlag | TreeCoulombForceFlag))) {
+		cout << "Error: -u only splits the coulomb force if it is slow." << endl;
+		help();
+		return 1;
+	}
+	if (adaptive && !(relativeTolerance >= 0.0 && absoluteTolerance >= 0.0 && relativeTolerance + absoluteTolerance > 0.0)) {
+		cout << "Error: the tolerances must not be negative or both zero." << endl;
+		help();
+		return 1;
+	}
+	if (verletOrder && verletOrder != 2 && verletOrder != 4) {
+		cout << "Error: the velocity Verlet order must be 2 or 4." << endl;
+		help();
+		return 1;
+	}
+	if (subcycleRadius != 0.0 && !(verletOrder && subcycleRadius > 0.0)) {
+		cout << "Error: -y needs -l and a positive radius." << endl;
+		help();
+		return 1;
+	}
+	if (blockTimesteps && !(blockAccuracy > 0.0 && blockLevels <= 30)) {
+		cout << "Error: the block timestep accuracy must be positive and the deepest level at most 30." << endl;
+		help();
+		return 1;
+	}
+	if ((adaptive ? 1 : 0) + (fastSteps ? 1 : 0) + (verletOrder ? 1 : 0) + (lowStorage ? 1 : 0)
+	    + (exponential ? 1 : 0) + (blockTimesteps ? 1 : 0) > 1) {
+		cout << "Error: -a, -j, -l, -u, -W and -x select different integrators." << endl;
+		help();
+		return 1;
+	}
+	if (relax && (!(relaxTolerance > 0.0) || adaptive || fastSteps || verletOrder || lowStorage
+	                              || exponential || blockTimesteps || continueFileIndex || Mach
+	                              || (usedForces & (ThermalForceFlag | ThermalForceLocalizedFlag
+	                                                | TimeVaryingThermalForceFlag)))) {
+		cout << "Error: -z needs a positive tolerance and does not work with -a, -c, -j, -l, -L, -M, -T, -u," << endl
+		<< "       -v, -W or -x." << endl;
+		help();
+		return 1;
+	}
+	if (mixedPrecision && (pairSearch != AllPairsSearch || accumulation != LockAccumulation || coulombTable)) {
+		cout << "Error: -m only works with -N all -A lock and without -Y." << endl;
+		help();
+		return 1;
+	}
 
     // All simulations require the folling three forces if subsitutes are not 
     // used.
@@ -323,11 +607,13 @@ int main (int argc, char * const argv[]) {
 		usedForces |= DragForceFlag;
 	if (!(usedForces & RectConfinementForceFlag) && !(usedForces & ConfinementForceVoidFlag))
 		usedForces |= ConfinementForceFlag;
-	usedForces |= ShieldedCoulombForceFlag;
+	if (!(usedForces & TreeCoulombForceFlag))
+		usedForces |= ShieldedCoulombForceFlag;
 
 	fitsfile *file = NULL;
 	int error = 0;
 	Cloud *cloud;
+	const uint64_t seed = randomSeed ? randomSeed : RandomNumbers::clockSeed();
 
 	if (continueFileIndex) {
         // Create a cloud using a specified fits file. Subsequent time step data
@@ -340,7 +626,7 @@ int main (int argc, char * const argv[]) {
 		fits_read_key_lng(file, const_cast<char *> ("FORCES"), &usedForces, NULL, &error);
 		checkFitsError(error, __LINE__);
 
-		cloud = Cloud::initializeFromFile(file, error, &startTime);
+		cloud = Cloud::initializeFromFile(file, error, &startTime, seed);
 		checkFitsError(error, __LINE__);
 	} else if (finalsFileIndex) {
         // Create a cloud using the last time step of a specified fits file.
@@ -349,13 +635,23 @@ int main (int argc, char * const argv[]) {
 		fits_open_file(&file, argv[finalsFileIndex], READONLY, &error);
 		checkFitsError(error, __LINE__);
         
-		cloud = Cloud::initializeFromFile(file, error, NULL);
+		cloud = Cloud::initializeFromFile(file, error, NULL, seed);
 		checkFitsError(error, __LINE__);
 		
  		fits_close_file(file, &error);
 		checkFitsError(error, __LINE__);
 	} else
-		cloud = Cloud::initializeGrid(numParticles, row_x_particles, row_y_particles, rMean, rSigma, qMean, qSigma);
+		cloud = Cloud::initializeGrid(numParticles, row_x_particles, row_y_particles, rMean, rSigma, qMean, qSigma, seed);
+	if (mixedPrecision && cloud->n%FLOAT_STRIDE) {
+		cout << "Error: -m requires multiples of " << FLOAT_STRIDE << " numbers of particles." << endl;
+		help();
+		return 1;
+	}
+	if (adaptive && (usedForces & (ThermalForceFlag | ThermalForceLocalizedFlag | TimeVaryingThermalForceFlag))) {
+		cout << "Error: -a does not work with the thermal forces of -L, -T and -v." << endl;
+		help();
+		return 1;
+	}
 
 	// Create a new file if we aren't continuing an old one.
 	if (!continueFileIndex) {
@@ -369,37 +665,41 @@ int main (int argc, char * const argv[]) {
 	}
 	
     // Create all forces specified in used forces.
-    ForceArray forces;
+    ForceArray forces, slowForces;
 	if (usedForces & ConfinementForceFlag)
-		forces.push_back(new ConfinementForce(cloud, confinementConst));
+		addForce(forces, slowForces, ConfinementForceFlag, new ConfinementForce(cloud, confinementConst));
 	if (usedForces & ConfinementForceVoidFlag)
-		forces.push_back(new ConfinementForceVoid(cloud, confinementConst, voidDecay));
+		addForce(forces, slowForces, ConfinementForceVoidFlag, new ConfinementForceVoid(cloud, confinementConst, voidDecay));
 	if (usedForces & DragForceFlag) 
-		forces.push_back(new DragForce(cloud, dragGamma));
+		addForce(forces, slowForces, DragForceFlag, new DragForce(cloud, dragGamma));
 	if (usedForces & DrivingForceFlag)
-		forces.push_back(new DrivingForce(cloud, driveConst, waveAmplitude, waveShift));
+		addForce(forces, slowForces, DrivingForceFlag, new DrivingForce(cloud, driveConst, waveAmplitude, waveShift));
 	if (usedForces & MagneticForceFlag)
-		forces.push_back(new MagneticForce(cloud, magneticFieldStrength));
+		addForce(forces, slowForces, MagneticForceFlag, new MagneticForce(cloud, magneticFieldStrength));
 	if (usedForces & RectConfinementForceFlag)
-		forces.push_back(new RectConfinementForce(cloud, confinementConstX, confinementConstY));
+		addForce(forces, slowForces, RectConfinementForceFlag, new RectConfinementForce(cloud, confinementConstX, confinementConstY));
 	if (usedForces & RotationalForceFlag)
-		forces.push_back(new RotationalForce(cloud, rmin, rmax, rotConst));
+		addForce(forces, slowForces, RotationalForceFlag, new RotationalForce(cloud, rmin, rmax, rotConst));
 	if (usedForces & ShieldedCoulombForceFlag) 
-		forces.push_back(new ShieldedCoulombForce(cloud, shieldingConstant));
+		addForce(forces, slowForces, ShieldedCoulombForceFlag,
+		         new ShieldedCoulombForce(cloud, shieldingConstant, pairSearch, neighborSkin, accumulation,
+		                                  coulombTable, mixedPrecision ? MixedPrecision : DoublePrecision));
 	if (usedForces & ThermalForceFlag)
-		forces.push_back(new ThermalForce(cloud, thermRed));
+		addForce(forces, slowForces, ThermalForceFlag, new ThermalForce(cloud, thermRed));
 	if (usedForces & ThermalForceLocalizedFlag)
-		forces.push_back(new ThermalForceLocalized(cloud, thermRed, thermRed1, heatRadius));
+		addForce(forces, slowForces, ThermalForceLocalizedFlag, new ThermalForceLocalized(cloud, thermRed, thermRed1, heatRadius));
 	if (usedForces & TimeVaryingDragForceFlag)
-		forces.push_back(new TimeVaryingDragForce(cloud, dragScale, dragGamma));
+		addForce(forces, slowForces, TimeVaryingDragForceFlag, new TimeVaryingDragForce(cloud, dragScale, dragGamma));
 	if (usedForces & TimeVaryingThermalForceFlag)
-		forces.push_back(new TimeVaryingThermalForce(cloud, thermScale, thermOffset));
+		addForce(forces, slowForces, TimeVaryingThermalForceFlag, new TimeVaryingThermalForce(cloud, thermScale, thermOffset));
 	if (usedForces & ElectricForceFlag)
-		forces.push_back(new ElectricForce(cloud, electricFieldStrength, plasmaRadius));
+		addForce(forces, slowForces, ElectricForceFlag, new ElectricForce(cloud, electricFieldStrength, plasmaRadius));
 	if (usedForces & GravitationalForceFlag)
-		forces.push_back(new GravitationalForce(cloud, gravitationalFieldStrength));
+		addForce(forces, slowForces, GravitationalForceFlag, new GravitationalForce(cloud, gravitationalFieldStrength));
 	if (usedForces & VertElectricForceFlag)
-		forces.push_back(new VertElectricForce(cloud, vertElectricFieldStrength, verticalDecay));
+		addForce(forces, slowForces, VertElectricForceFlag, new VertElectricForce(cloud, vertElectricFieldStrength, verticalDecay));
+	if (usedForces & TreeCoulombForceFlag)
+		addForce(forces, slowForces, TreeCoulombForceFlag, new TreeCoulombForce(cloud, shieldingConstant, openingAngle));
 
 	
 	if (continueFileIndex) { // Initialize forces from old file.
@@ -433,25 +733,52 @@ int main (int argc, char * const argv[]) {
 		cloud->mass[0] *= massFactor;
 	}
     
-    // Create 2nd or 4th order Runge-Kutta integrator.
-    Integrator * const I = rk4 ? new Runge_Kutta4(cloud, forces, simTimeStep, startTime)
-                               : new Runge_Kutta2(cloud, forces, simTimeStep, startTime);
+    // Create 2nd or 4th order Runge-Kutta, low-storage, adaptive, symplectic,
+    // exponential, block or multiple timestep integrator, or the FIRE
+    // relaxation, which writes its relaxed cloud as a single time step.
+    if (relax)
+		endTime = startTime + dataTimeStep;
+    Integrator * const I = relax ? new Fire(cloud, forces, simTimeStep, startTime,
+                                             relaxTolerance, relaxIterations)
+                         : fastSteps ? new Respa(cloud, forces, slowForces, simTimeStep, startTime, fastSteps,
+                                                 splitRadius, shieldingConstant)
+                         : adaptive ? (Integrator *)new DormandPrince(cloud, forces, simTimeStep, startTime,
+                                                                      relativeTolerance, absoluteTolerance)
+                         : verletOrder ? (Integrator *)new VelocityVerlet(cloud, forces, simTimeStep, startTime,
+                                                                          verletOrder, subcycleRadius,
+                                                                          shieldingConstant)
+                         : blockTimesteps ? (Integrator *)new BlockTimestep(cloud, forces, simTimeStep, startTime,
+                                                                            blockAccuracy, blockLevels)
+                         : exponential ? (Integrator *)new ExponentialVerlet(cloud, forces, simTimeStep, startTime)
+                         : lowStorage ? (Integrator *)new CarpenterKennedy(cloud, forces, simTimeStep, startTime)
+                         : rk4 ? (Integrator *)new Runge_Kutta4(cloud, forces, simTimeStep, startTime)
+                               : (Integrator *)new Runge_Kutta2(cloud, forces, simTimeStep, startTime);
 
 	// Run the simulation. Add a blank line to provide space between warnings
     // the completion counter.
     cout << endl;
-	while (startTime < endTime) {
+	for (cloud_index step = 1; startTime < endTime; step++) {
 		cout << clear_line << "\rCurrent Time: " << I->currentTime << "s (" 
 		<< I->currentTime/endTime*100.0 << "% Complete)" << flush;
 		
 		// Advance simulation to next timestep.
 		I->moveParticles(startTime += dataTimeStep);
 		cloud->writeTimeStep(file, error, I->currentTime);
+
+		// Restore spatial locality of the particle arrays.
+		if (reorderInterval && step%reorderInterval == 0)
+			cloud->reorder();
 	}
 
 	// Close fits file.
 	fits_close_file(file, &error);
 
+	// Print performance statistics of the forces.
+	cout << clear_line << "\r";
+	for (Force * const F : forces)
+		F->printStatistics(cout);
+	I->printStatistics(cout);
+
 	// clean up objects:
 	for (Force * const F : forces)
 		delete F;
@@ -608,6 +935,30 @@ void checkOption(const int argc, char * const argv[], int &optionIndex, const ch
 					optionWarning<const char *> (option, name, defaultFileName);
 				break;
 			}
+			case S: { // string argument
+				const char **str = (const char **)val;
+				if (optionIndex < argc && !isOption(argv[optionIndex]) && !isDouble(argv[optionIndex]))
+					*str = argv[optionIndex++];
+				else
+					optionWarning<const char *> (option, name, *str);
+				break;
+			}
+			case U: { // unsigned argument
+				unsigned *u = (unsigned *)val;
+				if (optionIndex < argc && isUnsigned(argv[optionIndex]))
+					*u = (unsigned)strtoul(argv[optionIndex++], NULL, 10);
+				else
+					optionWarning<unsigned> (option, name, *u);
+				break;
+			}
+			case L: { // uint64_t argument
+				uint64_t *l = (uint64_t *)val;
+				if (optionIndex < argc && isUnsigned(argv[optionIndex]))
+					*l = (uint64_t)strtoull(argv[optionIndex++], NULL, 10);
+				else
+					optionWarning<uint64_t> (option, name, *l);
+				break;
+			}
 			default:
 				va_end(arglist);
 				assert(false && "Undefined Argument Type");
@@ -671,6 +1022,9 @@ void checkParams(const char* inputFile){
         if (varname == "shieldingConstant"){
             shieldingConstant = atof(value.c_str());
         }
+        if (varname == "openingAngle"){
+            openingAngle = atof(value.c_str());
+        }
         if (varname == "dragGamma"){
             dragGamma = atof(value.c_str());
         }
@@ -758,6 +1112,75 @@ void checkParams(const char* inputFile){
         if (varname == "velocityY"){
             Cloud::velY = atof(value.c_str());
         }
+        if (varname == "pairSearch"){
+            pairSearch = pairSearchMethod(value.c_str());
+        }
+        if (varname == "neighborSkin"){
+            neighborSkin = atof(value.c_str());
+        }
+        if (varname == "accumulation"){
+            accumulation = accumulationMethod(value.c_str());
+        }
+        if (varname == "coulombTable"){
+            coulombTable = (unsigned)strtoul(value.c_str(), NULL, 10);
+        }
+        if (varname == "mixedPrecision"){
+            mixedPrecision = atoi(value.c_str()) != 0;
+        }
+        if (varname == "reorderInterval"){
+            reorderInterval = (cloud_index)atoi(value.c_str());
+        }
+        if (varname == "fastSteps"){
+            fastSteps = (cloud_index)atoi(value.c_str());
+        }
+        if (varname == "slowForces"){
+            slowForceMask = slowForceFlags(value.c_str());
+        }
+        if (varname == "splitRadius"){
+            splitRadius = atof(value.c_str());
+        }
+        if (varname == "verletOrder"){
+            verletOrder = (cloud_index)atoi(value.c_str());
+        }
+        if (varname == "subcycleRadius"){
+            subcycleRadius = atof(value.c_str());
+        }
+        if (varname == "lowStorage"){
+            lowStorage = atoi(value.c_str()) != 0;
+        }
+        if (varname == "exponential"){
+            exponential = atoi(value.c_str()) != 0;
+        }
+        if (varname == "blockTimesteps"){
+            blockTimesteps = atoi(value.c_str()) != 0;
+        }
+        if (varname == "blockAccuracy"){
+            blockAccuracy = atof(value.c_str());
+        }
+        if (varname == "blockLevels"){
+            blockLevels = (unsigned)strtoul(value.c_str(), NULL, 10);
+        }
+        if (varname == "relax"){
+            relax = atoi(value.c_str()) != 0;
+        }
+        if (varname == "relaxTolerance"){
+            relaxTolerance = atof(value.c_str());
+        }
+        if (varname == "relaxIterations"){
+            relaxIterations = (cloud_index)atoi(value.c_str());
+        }
+        if (varname == "randomSeed"){
+            randomSeed = (uint64_t)strtoull(value.c_str(), NULL, 10);
+        }
+        if (varname == "adaptive"){
+            adaptive = atoi(value.c_str()) != 0;
+        }
+        if (varname == "relativeTolerance"){
+            relativeTolerance = atof(value.c_str());
+        }
+        if (varname == "absoluteTolerance"){
+            absoluteTolerance = atof(value.c_str());
+        }
         if (varname == "forceFlags"){
             // Now we need to flip the appropriate force flags
             vector<string> flags;
@@ -770,6 +1193,9 @@ void checkParams(const char* inputFile){
 
            // Now we need to figure out which forces to use
            for (int i = 0; i < flags.size(); i++){
+               if (flags[i] == "b"){
+                   checkForce(1, 'b', TreeCoulombForceFlag);
+               }
                if (flags[i] == "B"){
                    checkForce(1, 'B', MagneticForceFlag);
                }
@@ -871,10 +1297,54 @@ void parseCommandLineOptions(int argc, char * const argv[]){
 				setParticleRows();
 				break;
 
+	        case 'H': // reorder particles along a "H"ilbert curve:
+				checkOption(argc, argv, i, 'H', 1,
+	                        "reorder interval", CI, &reorderInterval);
+				break;
+
+	        case 'l': // use symp"l"ectic integrator:
+				checkOption(argc, argv, i, 'l', 1,
+	                        "velocity Verlet order", CI, &verletOrder);
+				break;
+
+	        case 'Y': // set Yukawa force table resolution:
+				checkOption(argc, argv, i, 'Y', 1,
+	                        "coulomb table resolution", U, &coulombTable);
+				break;
+
+	        case 'Q': // set random seed:
+				checkOption(argc, argv, i, 'Q', 1,
+	                        "random seed", L, &randomSeed);
+				break;
+
+	        // All S cases
+	        case 'A': // set force "A"ccumulation:
+				checkOption(argc, argv, i, 'A', 1,
+	                        "force accumulation", S, &accumulationName);
+				accumulation = accumulationMethod(accumulationName);
+				break;
+
+	        case 'N': // set "N"eighbor pair search:
+				checkOption(argc, argv, i, 'N', 1,
+	                        "pair search", S, &pairSearchName);
+				pairSearch = pairSearchMethod(pairSearchName);
+				break;
+
             // All D Cases. 
             // Note: if pflag = true, these are not going to be read.
             if (pflag == false) {
 			
+				case 'a': // use "a"daptive integrator:
+					adaptive = true;
+					checkOption(argc, argv, i, 'a', 2,
+	                            "relative tolerance", D, &relativeTolerance,
+	                            "absolute tolerance", D, &absoluteTolerance);
+					break;
+				case 'b': // use "b"arnes-Hut tree coulomb force:
+					checkForce(1, 'b', TreeCoulombForceFlag);
+					checkOption(argc, argv, i, 'b', 1, 
+	                            "opening angle", D, &openingAngle);
+					break;
 				case 'B': // set "B"-field:
 					checkForce(1, 'B', MagneticForceFlag);
 					checkOption(argc, argv, i, 'B', 1, 
@@ -901,9 +1371,19 @@ void parseCommandLineOptions(int argc, char * const argv[]){
 				case 'h': // display "h"elp:
 					help();
 					exit(0);
+				case 'j': // use "j"agged per-particle timesteps:
+					blockTimesteps = true;
+					checkOption(argc, argv, i, 'j', 2,
+	                            "accuracy", D,  &blockAccuracy,
+	                            "levels",   U,  &blockLevels);
+					break;
                 case 'I': // use 2nd order "i"ntegrator
                         rk4 = false;
                         i++;
+                        break;
+                case 'm': // use "m"ixed precision coulomb forces
+                        mixedPrecision = true;
+                        i++;
                         break;
 				case 'L': // perform "L"ocalized heating experiment:
 					checkForce(3, 
@@ -955,6 +1435,13 @@ void parseCommandLineOptions(int argc, char * const argv[]){
 				case 't': // set "t"imestep:
 					checkOption(argc, argv, i, 't', 1, "time step", D, &simTimeStep);
 					break;
+				case 'u': // use m"u"ltiple timestepping:
+					checkOption(argc, argv, i, 'u', 3,
+	                            "fast steps",   CI, &fastSteps,
+	                            "slow forces",  S,  &slowForceLetters,
+	                            "split radius", D,  &splitRadius);
+					slowForceMask = slowForceFlags(slowForceLetters);
+					break;
 				case 'T': // set "T"emperature reduction factor:
 					checkForce(3, 
 	                           'T', ThermalForceFlag,
@@ -984,6 +1471,24 @@ void parseCommandLineOptions(int argc, char * const argv[]){
 	                            "wave shift",       D, &waveShift, 
 	                            "driving constant", D, &driveConst);
 					break;
+				case 'W': // use lo"W" storage integrator:
+					lowStorage = true;
+					i++;
+					break;
+				case 'x': // use e"x"ponential integrator:
+					exponential = true;
+					i++;
+					break;
+				case 'y': // sub-c"y"cle close pairs:
+					checkOption(argc, argv, i, 'y', 1,
+	                            "sub-cycling radius", D, &subcycleRadius);
+					break;
+				case 'z': // relax to a "z"ero temperature ground state:
+					relax = true;
+					checkOption(argc, argv, i, 'z', 2,
+	                            "force tolerance", D,  &relaxTolerance,
+	                            "iterations",      CI, &relaxIterations);
+					break;
         		case 'E': // use "E"lectricForce:
         			checkForce(1, 'E', ElectricForceFlag);
         			checkOption(argc, argv, i, 'E', 2, 
@@ -1014,6 +1519,10 @@ void parseCommandLineOptions(int argc, char * const argv[]){
                 				"justify x", D, &Cloud::justX, 
                 				"justify y", D, &Cloud::justY);
                     break;
+                case 'K': // set neighbor list s"K"in:
+                    checkOption(argc, argv, i, 'K', 1,
+                                "neighbor skin", D, &neighborSkin);
+                    break;
                 case 'k': // velocity "kick" [x,y]:
                     checkOption(argc, argv, i, 'k', 2, 
                     			"velocity x", D, &Cloud::velX, 